@@ -265,12 +265,29 @@ cpu_tb_exec(CPUState *cpu, TranslationBlock *itb, int *tb_exit)
         TranslationBlock * tb_fail = (TranslationBlock *)env->checksum_fail_tb;
         lsassert(tb_fail->checksum && tb_fail->pc == env->eip);
         mmap_lock();
+#ifdef CONFIG_LATX_DECODE_CACHE
+        /* the code changed without a write fault, drop its kept IR1 */
+        tr_decode_cache_invalidate(tb_fail->pc, tb_fail->pc + tb_fail->size);
+#endif
         tb_phys_invalidate(tb_fail, tb_page_addr0(tb_fail));
         mmap_unlock();
         env->checksum_fail_tb = NULL;
         /*qemu_log("latx checksum fail, retranslate pc=%lx\n", tb_fail->pc);*/
     }
 
+#ifdef CONFIG_LATX_HOT_TRACE
+    if (env->hot_tb) {
+        TranslationBlock *tb_hot = (TranslationBlock *)env->hot_tb;
+        lsassert(tb_hot->pc == env->eip);
+        mmap_lock();
+        tb_phys_invalidate(tb_hot, tb_page_addr0(tb_hot));
+        mmap_unlock();
+        env->hot_tb = NULL;
+        /* the next tb_gen_code() of this pc builds the hot trace */
+        env->hot_pc = tb_hot->pc;
+    }
+#endif
+
     if (env->insn_save[0]) {
         link_indirect_jmp(env);
     }
@@ -296,6 +313,12 @@ cpu_tb_exec(CPUState *cpu, TranslationBlock *itb, int *tb_exit)
         last_tb = tcg_splitwx_to_rw((void *)(ret & ~TB_EXIT_MASK));
     }
     *tb_exit = ret & TB_EXIT_MASK;
+#ifdef CONFIG_LATX_PERF
+    /* the ret 0 epilogue: indirect jump lookup misses and unchained exits */
+    if (!last_tb) {
+        latx_timer_count(TIMER_INDIRECT_MISS);
+    }
+#endif
 
     trace_exec_tb_exit(last_tb, *tb_exit);
     if (last_tb) {
@@ -669,6 +692,9 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
 #ifdef CONFIG_LATX
 #include "opt-jmp.h"
 #endif
+#ifdef CONFIG_LATX_TS_WORKER
+#include "ts.h"
+#endif
 
 static inline TranslationBlock *tb_find(CPUState *cpu,
                                         TranslationBlock *last_tb,
@@ -682,6 +708,16 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
     cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
 
     tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
+#ifdef CONFIG_LATX_PERF
+    if (tb == NULL) {
+        latx_timer_count(TIMER_TB_MISS);
+    }
+#endif
+#ifdef CONFIG_LATX
+    if (tb && option_code_regions > 1) {
+        tcg_region_heat(tb->tc.ptr);
+    }
+#endif
 #ifdef CONFIG_LATX_AOT
     if (tb == NULL && option_aot) {
         mmap_lock();
@@ -698,6 +734,12 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
             fprintf(stderr, "NOTE! Translating No.%lld basic block 0x"
                     TARGET_FMT_lx "\n", ++cnt, pc);
         }
+#endif
+#ifdef CONFIG_LATX_PREDECODE
+        /* other threads may translate meanwhile, decode without the lock */
+        if (option_predecode && (cflags & CF_PARALLEL)) {
+            tr_predecode(cpu, pc, cflags);
+        }
 #endif
         mmap_lock();
 
@@ -707,11 +749,21 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
 
 #ifdef CONFIG_LATX_TU
         tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+ #ifdef CONFIG_LATX_TS_WORKER
+        if (tb && option_ts_workers) {
+            ts_work_queue_succ(cpu, tb);
+        }
+ #endif
         jrra_pre_translate((void **)&tb, 1, cpu, cs_base, flags, cflags);
         /* jrra_pre_translate((void **)tu_data->tb_list, tu_data->tb_num, */
         /*                     cpu, cs_base, flags, cflags); */
 #else
         tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+ #ifdef CONFIG_LATX_TS_WORKER
+        if (tb && option_ts_workers) {
+            ts_work_queue_succ(cpu, tb);
+        }
+ #endif
  #ifdef CONFIG_LATX
         jrra_pre_translate((void **)&tb, 1, cpu, cs_base, flags, cflags);
  #endif
@@ -728,8 +780,9 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
         int hash_value = tb_jmp_cache_hash_func(pc);
         qatomic_set(&cpu->tb_jmp_cache[hash_value], tb);
 #ifdef CONFIG_LATX
-        if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
-            latx_fast_jmp_cache_add(hash_value, tb);
+        if (latx_fast_jmp_cache_enabled(cpu->tcg_cflags) &&
+            cflags == curr_cflags(cpu)) {
+            latx_fast_jmp_cache_add(cpu, tb);
         }
 #endif
         mmap_unlock();
@@ -14,6 +14,10 @@
 TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
                               target_ulong cs_base, uint32_t flags,
                               int cflags);
+#ifdef CONFIG_LATX_TS_WORKER
+/* tb_gen_code() of this thread returns NULL instead of leaving to cpu_loop */
+extern __thread bool tb_gen_fail_soft;
+#endif
 
 void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 
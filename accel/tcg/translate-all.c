@@ -78,6 +78,7 @@
 #include "aot_page.h"
 #include "accel/tcg/internal.h"
 #include "ts.h"
+#include "latx-config.h"
 #endif
 #ifdef CONFIG_LATX_TU
 void tu_reset_tb(TranslationBlock *tb);
@@ -240,6 +241,9 @@ void *l1_map[V_L1_MAX_SIZE];
 TCGContext tcg_init_ctx;
 __thread TCGContext *tcg_ctx;
 TBContext tb_ctx;
+#ifdef CONFIG_LATX_TS_WORKER
+__thread bool tb_gen_fail_soft;
+#endif
 
 static void page_table_config_init(void)
 {
@@ -1610,12 +1614,12 @@ void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     CPU_FOREACH(cpu) {
         cpu_tb_jmp_cache_clear(cpu);
 #ifdef CONFIG_LATX
-        if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL) &&
-            cpu->cpu_index == 0) {
-            latx_fast_jmp_cache_clear_all();
-        }
+        latx_fast_jmp_cache_clear_all(cpu);
 #endif
     }
+#ifdef CONFIG_LATX
+    latx_indirect_ic_reset();
+#endif
 
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
     tb_remove_all();
@@ -1664,6 +1668,220 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+#if defined(CONFIG_USER_ONLY) && defined(CONFIG_LATX)
+/*
+ * With -latx-code-regions the code cache is split into regions, and a full
+ * cache evicts the translations of one region instead of all of them.
+ * AOT has to save everything before a flush and kzt keeps bridge TBs in
+ * the cache, so both still get the full flush.
+ */
+static bool tb_evict_enabled(void)
+{
+    if (tcg_region_count() == 1) {
+        return false;
+    }
+#ifdef CONFIG_LATX_AOT
+    if (option_aot) {
+        return false;
+    }
+#endif
+#ifdef CONFIG_LATX_KZT
+    if (option_kzt) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+struct tb_evict_data {
+    const void *start;
+    const void *end;
+    GPtrArray *tbs;
+};
+
+static void tb_evict_collect(void *p, uint32_t hash, void *userp)
+{
+    TranslationBlock *tb = p;
+    struct tb_evict_data *data = userp;
+
+    if (tb->tc.ptr >= data->start && tb->tc.ptr < data->end) {
+        g_ptr_array_add(data->tbs, tb);
+    }
+}
+
+/* pass the heat of each region on to the regions it jumps into */
+static void tb_evict_heat_links(void *p, uint32_t hash, void *userp)
+{
+    TranslationBlock *tb = p;
+    int n;
+
+    for (n = 0; n < 2; n++) {
+        TranslationBlock *dest =
+            (TranslationBlock *)(qatomic_read(&tb->jmp_dest[n]) & ~1);
+
+        if (dest) {
+            tcg_region_heat_link(tb->tc.ptr, dest->tc.ptr);
+        }
+    }
+}
+
+/*
+ * Has its own count, so that neither a pending tb_flush nor a pending
+ * eviction is dropped because the other one ran first.
+ */
+static void do_tb_evict(CPUState *cpu, run_on_cpu_data tb_evict_count)
+{
+    struct tb_evict_data data;
+    size_t victim;
+    bool flush = false;
+    guint i;
+
+    mmap_lock();
+    /* already evicted on request of another CPU */
+    if (tb_ctx.tb_evict_count != tb_evict_count.host_int) {
+        goto done;
+    }
+    /* flushed since the request, the next TB goes to a fresh region */
+    if (tcg_region_has_fresh()) {
+        goto done;
+    }
+
+    qht_iter(&tb_ctx.htable, tb_evict_heat_links, NULL);
+    if (!tcg_region_victim(tcg_ctx, &victim)) {
+        /* all other regions hold JRRA return targets */
+        flush = true;
+        goto done;
+    }
+    tcg_region_bounds_rx(victim, &data.start, &data.end);
+    data.tbs = g_ptr_array_new();
+    qht_iter(&tb_ctx.htable, tb_evict_collect, &data);
+    qemu_log_mask(LAT_LOG_AOT, "evict code region %zu, %u tbs\n",
+                  victim, data.tbs->len);
+
+    /* unlink incoming jumps and drop them from every lookup structure */
+    for (i = 0; i < data.tbs->len; i++) {
+        TranslationBlock *tb = g_ptr_array_index(data.tbs, i);
+
+        tb_phys_invalidate(tb, -1);
+        tcg_tb_remove(tb);
+    }
+    g_ptr_array_free(data.tbs, true);
+    tcg_region_reuse(tcg_ctx, victim);
+    qatomic_mb_set(&tb_ctx.tb_evict_count, tb_ctx.tb_evict_count + 1);
+
+done:
+    mmap_unlock();
+    if (flush) {
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(
+                        qatomic_mb_read(&tb_ctx.tb_flush_count)));
+    }
+}
+
+/* Make room in a full code cache, see tb_evict_enabled() */
+void tb_evict(CPUState *cpu)
+{
+    unsigned tb_evict_count;
+
+    if (!tb_evict_enabled()) {
+        tb_flush(cpu);
+        return;
+    }
+    tb_evict_count = qatomic_mb_read(&tb_ctx.tb_evict_count);
+    if (cpu_in_exclusive_context(cpu)) {
+        do_tb_evict(cpu, RUN_ON_CPU_HOST_INT(tb_evict_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_evict,
+                              RUN_ON_CPU_HOST_INT(tb_evict_count));
+    }
+}
+
+static void tb_collect_serial(void *p, uint32_t hash, void *userp)
+{
+    TranslationBlock *tb = p;
+
+    if (!(tb_cflags(tb) & CF_PARALLEL)) {
+        g_ptr_array_add(userp, tb);
+    }
+}
+
+/*
+ * Code of a TB that never read CF_PARALLEL while translating is the same
+ * in both modes. Direct branches inside a TU are not on the jump lists,
+ * so TBs linked that way follow the rest of their TU out.
+ */
+static bool tb_parallel_reusable(TranslationBlock *tb)
+{
+    if (!tb->icount ||
+        (tb->bool_flags & (IS_PARALLEL_DEP | IS_AOT_TB | IS_TUNNEL_LIB))) {
+        return false;
+    }
+#ifdef CONFIG_LATX_TU
+    if (tb->tu_jmp[TU_TB_INDEX_NEXT] != TB_JMP_RESET_OFFSET_INVALID ||
+        tb->tu_jmp[TU_TB_INDEX_TARGET] != TB_JMP_RESET_OFFSET_INVALID) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void do_tb_enter_parallel(CPUState *cpu, run_on_cpu_data unused)
+{
+    GPtrArray *tbs = g_ptr_array_new();
+    guint i, kept = 0;
+
+    mmap_lock();
+    qht_iter(&tb_ctx.htable, tb_collect_serial, tbs);
+    for (i = 0; i < tbs->len; i++) {
+        TranslationBlock *tb = g_ptr_array_index(tbs, i);
+        tb_page_addr_t phys_pc = tb_page_addr0(tb);
+        uint32_t cflags = tb_cflags(tb);
+        uint32_t h = tb_hash_func(phys_pc, tb->pc, tb->flags, cflags,
+                                  tb->trace_vcpu_dstate);
+
+        if (tb_parallel_reusable(tb)) {
+            uint32_t ph = tb_hash_func(phys_pc, tb->pc, tb->flags,
+                                       cflags | CF_PARALLEL,
+                                       tb->trace_vcpu_dstate);
+            void *existing;
+
+            /* rehash under the parallel cflags, links to kept TBs stay */
+            qht_remove(&tb_ctx.htable, tb, h);
+            qatomic_set(&tb->cflags, cflags | CF_PARALLEL);
+            if (qht_insert(&tb_ctx.htable, tb, ph, &existing)) {
+                kept++;
+                continue;
+            }
+            qatomic_set(&tb->cflags, cflags);
+            qht_insert(&tb_ctx.htable, tb, h, NULL);
+        }
+        /* retranslated on its next lookup */
+        tb_phys_invalidate(tb, -1);
+    }
+    qemu_log_mask(LAT_LOG_AOT, "enter parallel: kept %u of %u tbs\n",
+                  kept, tbs->len);
+    g_ptr_array_free(tbs, true);
+    mmap_unlock();
+}
+
+/*
+ * The guest starts its first thread and cpu->tcg_cflags just gained
+ * CF_PARALLEL. Instead of flushing everything, keep the serial TBs whose
+ * code does not depend on it and invalidate the others.
+ */
+void tb_enter_parallel(CPUState *cpu)
+{
+    if (!option_lazy_parallel) {
+        tb_flush(cpu);
+        return;
+    }
+    if (cpu_in_exclusive_context(cpu)) {
+        do_tb_enter_parallel(cpu, RUN_ON_CPU_NULL);
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_enter_parallel, RUN_ON_CPU_NULL);
+    }
+}
+#endif
+
 /*
  * Formerly ifdef DEBUG_TB_CHECK. These debug functions are user-mode-only,
  * so in order to prevent bit rot we compile them unconditionally in user-mode,
@@ -1823,13 +2041,15 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     CPU_FOREACH(cpu) {
         if (qatomic_read(&cpu->tb_jmp_cache[h]) == tb) {
             qatomic_set(&cpu->tb_jmp_cache[h], NULL);
+        }
 #ifdef CONFIG_LATX
-            if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
-                latx_fast_jmp_cache_clear(h);
-            }
+        latx_fast_jmp_cache_clear(cpu, tb);
 #endif
-        }
     }
+#ifdef CONFIG_LATX
+    latx_indirect_ic_invalidate(tb->pc);
+    latx_indirect_ic_free(tb);
+#endif
 
     /* suppress this TB from the two jump lists */
     tb_remove_from_jmp_list(tb, 0);
@@ -1846,6 +2066,11 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
         qatomic_set((uint32_t *)tb->tc.ptr, SMC_ILL_INST);
         flush_idcache_range((uintptr_t)tb->tc.ptr, (uintptr_t)tb->tc.ptr, 4);
     }
+    /* the patched site goes with tb, so may the code it returns into */
+    if (tb->jrra_pin) {
+        tcg_region_unpin(tb->jrra_pin);
+        tb->jrra_pin = NULL;
+    }
 #endif
 }
 
@@ -2016,8 +2241,18 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
+#ifdef CONFIG_LATX_TS_WORKER
+        /* not a vCPU thread, leave the eviction to the vCPU */
+        if (tb_gen_fail_soft) {
+            return NULL;
+        }
+#endif
         /* flush must be done */
+#ifdef CONFIG_LATX
+        tb_evict(cpu);
+#else
         tb_flush(cpu);
+#endif
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -2038,6 +2273,13 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
  tb_overflow:
 #else
     tb->bool_flags = OPT_BCC;
+#ifdef CONFIG_LATX_HOT_TRACE
+    tb->hot_count = option_hot_trace;
+    /* hot_pc stays set, a retranslation after SMC is a hot trace again */
+    if (option_hot_trace && env->hot_pc == pc) {
+        tb->bool_flags |= IS_HOT_TRACE;
+    }
+#endif
     tb->s_data->_top_out = -1;
     tb->s_data->_top_in = -1;
 #ifdef CONFIG_LATX_AOT
@@ -2049,6 +2291,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 #endif
     tb->next_86_pc = 0;
     tb->return_target_ptr = NULL;
+    tb->jrra_pin = NULL;
+    tb->indirect_ic = NULL;
 #endif
 
 #ifndef CONFIG_LATX
@@ -2080,6 +2324,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->jmp_stub_reset_offset[0] = TB_JMP_RESET_OFFSET_INVALID;
     tb->jmp_stub_reset_offset[1] = TB_JMP_RESET_OFFSET_INVALID;
     tb->jmp_indirect = TB_JMP_RESET_OFFSET_INVALID;
+    tb->jmp_indirect_jirl = TB_JMP_RESET_OFFSET_INVALID;
 #ifdef CONFIG_LATX_INSTS_PATTERN
     tb->eflags_target_arg[0] = TB_JMP_RESET_OFFSET_INVALID;
     tb->eflags_target_arg[1] = TB_JMP_RESET_OFFSET_INVALID;
@@ -2259,10 +2504,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
          * flush the TBs, allocate a new TB, re-initialize it per
          * above, and re-do the actual code generation.
          */
+        latx_indirect_ic_free(tb);
         goto buffer_overflow;
     }
 
     if (gen_code_size == 0) {
+        latx_indirect_ic_free(tb);
         return NULL;
     }
 
@@ -2273,6 +2520,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     search_size = encode_search(tb, (void *)gen_code_buf + gen_code_size);
     if (unlikely(search_size < 0)) {
         qatomic_set(&tcg_ctx->code_gen_ptr, tcg_ctx->code_gen_highwater + 1);
+        latx_indirect_ic_free(tb);
         goto buffer_overflow;
     }
     /*
@@ -2433,6 +2681,9 @@ void tb_invalidate_phys_range(tb_page_addr_t start, tb_page_addr_t end)
 
     assert_memory_lock();
 
+#ifdef CONFIG_LATX_DECODE_CACHE
+    tr_decode_cache_invalidate(start, end);
+#endif
     PAGE_FOR_EACH_TB(start, end, unused, tb, n) {
         tb_phys_invalidate__locked(tb);
     }
@@ -2477,6 +2728,9 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc)
         uint32_t inst = 0;
 
         addr &= TARGET_PAGE_MASK;
+#ifdef CONFIG_LATX_DECODE_CACHE
+        tr_decode_cache_invalidate(addr, addr + TARGET_PAGE_SIZE);
+#endif
 
 #ifdef CONFIG_LATX_AOT
         if (option_aot) {
@@ -3467,7 +3721,57 @@ bool pageflags_set_clear(target_ulong start, target_ulong last,
 }
 
 #ifdef CONFIG_LATX_AOT
-static seg_info *p_info;
+/*
+ * Pages of [start, last] that turn writable while holding translated
+ * code become PAGE_SMC. Walk the read-only pageflags nodes once, and
+ * inside each one the TB tree once, marking whole runs of pages instead
+ * of looking every page up in both trees.
+ */
+static void page_classify_smc(target_ulong start, target_ulong last,
+                              seg_info *seg)
+{
+    aot_segment *p_segment = seg ? (aot_segment *)seg->p_segment : NULL;
+    bool seg_smc = seg && (seg->is_running || (p_segment && !p_segment->is_pe));
+    IntervalTreeNode *n, *t;
+
+    for (n = interval_tree_iter_first(&pageflags_root, start, last); n;
+         n = interval_tree_iter_next(n, start, last)) {
+        PageFlagsNode *p = container_of(n, PageFlagsNode, itree);
+        target_ulong n_start = MAX(n->start, start);
+        target_ulong n_last = MIN(n->last, last);
+        target_ulong run_start = 0, run_last = 0;
+        bool in_run = false;
+
+        if (p->flags & PAGE_WRITE) {
+            continue;
+        }
+        if ((p->flags & PAGE_EXEC) && seg_smc) {
+            page_set_page_state_range(n_start, n_last + 1, PAGE_SMC);
+            continue;
+        }
+
+        /* TBs come in order of start address, merge their page spans. */
+        for (t = interval_tree_iter_first(&tb_root, n_start, n_last); t;
+             t = interval_tree_iter_next(t, n_start, n_last)) {
+            target_ulong tb_start = MAX(t->start, n_start) & TARGET_PAGE_MASK;
+            target_ulong tb_last = MIN(t->last, n_last) | ~TARGET_PAGE_MASK;
+
+            if (in_run && tb_start <= run_last + 1) {
+                run_last = MAX(run_last, tb_last);
+                continue;
+            }
+            if (in_run) {
+                page_set_page_state_range(run_start, run_last + 1, PAGE_SMC);
+            }
+            run_start = tb_start;
+            run_last = tb_last;
+            in_run = true;
+        }
+        if (in_run) {
+            page_set_page_state_range(run_start, run_last + 1, PAGE_SMC);
+        }
+    }
+}
 #endif
 /* Modify the flags of a page and invalidate the code if necessary.
    The flag PAGE_WRITE_ORG is positioned automatically depending
@@ -3477,7 +3781,6 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
 #ifdef CONFIG_LATX_PERF
     latx_timer_start(TIMER_PAGE_FLAGS);
 #endif
-    target_ulong addr, len;
     target_ulong last;
     bool reset = false;
     bool inval_tb = false;
@@ -3521,29 +3824,10 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
 
 #ifdef CONFIG_LATX_AOT
     if (option_aot && (flags & PAGE_WRITE)) {
-        p_info = segment_tree_lookup2(start, end);
-
+        page_classify_smc(start, last, segment_tree_lookup2(start, end));
     }
 #endif
 
-    for (addr = start, len = end - start;
-         len != 0;
-         len -= TARGET_PAGE_SIZE, addr += TARGET_PAGE_SIZE) {
-        PageFlagsNode *p = pageflags_find(addr, addr);
-#ifdef CONFIG_LATX_AOT
-        if (option_aot && (flags & PAGE_WRITE) && p && !(p->flags & PAGE_WRITE)) {
-            if (foreach_tb_first(addr, addr + TARGET_PAGE_SIZE)) {
-                page_set_page_state(addr, PAGE_SMC);
-            } else if ((p->flags & PAGE_EXEC) && p_info) {
-                aot_segment *p_segment = (aot_segment *)(p_info->p_segment);
-                if ((p_info->is_running || (p_segment && !(p_segment->is_pe)))) {
-                    page_set_page_state(addr, PAGE_SMC);
-                }
-            }
-        }
-#endif
-    }
-
     if (flags) {
         inval_tb |= pageflags_set_clear(start, last, flags,
             ~(reset ? 0 : PAGE_ANON | PAGE_OVERFLOW | PAGE_MEMSHARE));
@@ -3853,6 +4137,9 @@ int page_unprotect(target_ulong address, uintptr_t pc)
         }
 #endif
     } else {
+#ifdef CONFIG_LATX_PERF
+        latx_timer_count(TIMER_SMC_INVAL);
+#endif
 #ifdef CONFIG_LATX_AOT
         if (option_aot) {
             target_ulong host_start, host_end;
@@ -617,9 +617,23 @@ struct TranslationBlock {
 #define IS_ENABLE_JRRA 0x04
 #define IS_AOT_TB 0x08
 #define IS_TUNNEL_LIB 0x10
+/* translation read CF_PARALLEL, see tr_cflags() */
+#define IS_PARALLEL_DEP 0x20
+/* IR2 list scheduled, see ir2_schedule() */
+#define IS_IR2_SCHED 0x40
+/* translated as a hot trace, see get_ir1_list() */
+#define IS_HOT_TRACE 0x80
     uint8_t bool_flags;
+#ifdef CONFIG_LATX_HOT_TRACE
+    /* executions left before the TB is retranslated as a hot trace */
+    int32_t hot_count;
+#endif
     uint8_t  eflag_use;
     uintptr_t jmp_indirect;
+    /* the hit jirl of the inlined indirect goto, nop-ed on unlink */
+    uintptr_t jmp_indirect_jirl;
+    /* inline caches of the indirect gotos, freed with the TB */
+    struct IndirectIC *indirect_ic;
 #ifdef CONFIG_LATX_INSTS_PATTERN
     /*
      * [0] : not taken
@@ -639,6 +653,8 @@ struct TranslationBlock {
     /* remember to free these memory when QEMU recycle one TB */
     unsigned long *return_target_ptr;
     unsigned long next_86_pc;
+    /* the TB return_target_ptr is patched to, pinned in its code region */
+    const void *jrra_pin;
 #if defined(CONFIG_LATX_TU) || defined(CONFIG_LATX_AOT)
     union {
         target_ulong target_pc;
@@ -756,6 +772,10 @@ bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc);
 void tb_invalidate_phys_addr(AddressSpace *as, hwaddr addr, MemTxAttrs attrs);
 #endif
 void tb_flush(CPUState *cpu);
+#if defined(CONFIG_USER_ONLY) && defined(CONFIG_LATX)
+void tb_evict(CPUState *cpu);
+void tb_enter_parallel(CPUState *cpu);
+#endif
 
 void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count);
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr);
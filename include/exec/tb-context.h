@@ -34,6 +34,10 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+#ifdef CONFIG_LATX
+    /* region evictions, see tb_evict() */
+    unsigned tb_evict_count;
+#endif
 };
 
 extern TBContext tb_ctx;
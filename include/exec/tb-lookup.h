@@ -15,7 +15,7 @@
 
 #include "exec/exec-all.h"
 #include "exec/tb-hash.h"
-#include "latx-options.h"
+#include "latx-config.h"
 
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
@@ -57,8 +57,9 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
     }
     qatomic_set(&cpu->tb_jmp_cache[hash], tb);
 #ifdef CONFIG_LATX
-    if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
-        latx_fast_jmp_cache_add(hash, tb);
+    if (latx_fast_jmp_cache_enabled(cpu->tcg_cflags) &&
+        cflags == curr_cflags(cpu)) {
+        latx_fast_jmp_cache_add(cpu, tb);
     }
 #endif
     mmap_unlock();
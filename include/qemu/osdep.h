@@ -442,6 +442,16 @@ void qemu_anon_ram_free(void *ptr, size_t size);
 #else
 #define QEMU_MADV_REMOVE QEMU_MADV_INVALID
 #endif
+#ifdef MADV_WIPEONFORK
+#define QEMU_MADV_WIPEONFORK MADV_WIPEONFORK
+#else
+#define QEMU_MADV_WIPEONFORK QEMU_MADV_INVALID
+#endif
+#ifdef MADV_KEEPONFORK
+#define QEMU_MADV_KEEPONFORK MADV_KEEPONFORK
+#else
+#define QEMU_MADV_KEEPONFORK QEMU_MADV_INVALID
+#endif
 
 #elif defined(CONFIG_POSIX_MADVISE)
 
@@ -455,6 +465,8 @@ void qemu_anon_ram_free(void *ptr, size_t size);
 #define QEMU_MADV_HUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_NOHUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_REMOVE QEMU_MADV_INVALID
+#define QEMU_MADV_WIPEONFORK QEMU_MADV_INVALID
+#define QEMU_MADV_KEEPONFORK QEMU_MADV_INVALID
 
 #else /* no-op */
 
@@ -468,6 +480,8 @@ void qemu_anon_ram_free(void *ptr, size_t size);
 #define QEMU_MADV_HUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_NOHUGEPAGE  QEMU_MADV_INVALID
 #define QEMU_MADV_REMOVE QEMU_MADV_INVALID
+#define QEMU_MADV_WIPEONFORK QEMU_MADV_INVALID
+#define QEMU_MADV_KEEPONFORK QEMU_MADV_INVALID
 
 #endif
 
@@ -907,6 +907,17 @@ TranslationBlock *tcg_tb_alloc_full(TCGContext *s);
 void tcg_region_init(void);
 void tb_destroy(TranslationBlock *tb);
 void tcg_region_reset_all(void);
+#ifdef CONFIG_USER_ONLY
+size_t tcg_region_count(void);
+void tcg_region_heat(const void *p);
+void tcg_region_heat_link(const void *from, const void *to);
+void tcg_region_pin(const void *p);
+void tcg_region_unpin(const void *p);
+void tcg_region_bounds_rx(size_t idx, const void **pstart, const void **pend);
+bool tcg_region_has_fresh(void);
+bool tcg_region_victim(TCGContext *s, size_t *pvictim);
+void tcg_region_reuse(TCGContext *s, size_t idx);
+#endif
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
@@ -35,6 +35,9 @@ extern void __gcov_dump(void);
 #ifdef CONFIG_LATX_PERF
 #include "latx-perf.h"
 #endif
+#ifdef CONFIG_LATX_PROFILER
+#include "latx-config.h"
+#endif
 
 void preexit_cleanup(CPUArchState *env, int code)
 {
@@ -52,8 +55,11 @@ void preexit_cleanup(CPUArchState *env, int code)
         __gcov_dump();
 #endif
 #ifdef CONFIG_LATX_PROFILER
-        if (qemu_loglevel_mask(LAT_LOG_PROFILE))
+        if (qemu_loglevel_mask(LAT_LOG_PROFILE)) {
             dump_exec_info();
+            latx_fast_jmp_cache_dump();
+            latx_lat_lock_dump();
+        }
 #endif
         gdb_exit(code);
         qemu_plugin_atexit_cb();
@@ -212,12 +212,18 @@ void fork_start(void)
 {
     start_exclusive();
     mmap_fork_start();
+#ifdef CONFIG_LATX_TS_WORKER
+    ts_work_fork_start();
+#endif
     sigact_fork_start();
     cpu_list_lock();
 }
 
 void fork_end(int child)
 {
+#ifdef CONFIG_LATX_TS_WORKER
+    ts_work_fork_end(child);
+#endif
     mmap_fork_end(child);
     sigact_fork_end(child);
     if (child) {
@@ -321,6 +327,10 @@ CPUArchState *cpu_copy(CPUArchState *env)
 
 #ifdef CONFIG_LATX
     new_env->tb_jmp_cache_ptr = new_cpu->tb_jmp_cache;
+    new_env->fast_jmp_cache = NULL;
+    if (latx_fast_jmp_cache_enabled(new_cpu->tcg_cflags)) {
+        latx_fast_jmp_cache_init(new_env);
+    }
 #endif
     return new_env;
 }
@@ -619,6 +629,148 @@ static void handle_arg_latx_parallel(const char *arg)
     close_latx_parallel = strtol(arg, NULL, 0);
 }
 
+static void handle_arg_latx_parallel_fast_jmp(const char *arg)
+{
+    option_parallel_fast_jmp = strtol(arg, NULL, 0);
+}
+
+static void handle_arg_latx_fast_jmp_ways(const char *arg)
+{
+    option_fast_jmp_ways = strtol(arg, NULL, 0);
+    if (option_fast_jmp_ways != 1 && option_fast_jmp_ways != 2 &&
+        option_fast_jmp_ways != 4) {
+        lsassertm(0, "fast jmp cache ways must be 1, 2 or 4.");
+    }
+}
+
+static void handle_arg_latx_indirect_ic(const char *arg)
+{
+    option_indirect_ic = strtol(arg, NULL, 0);
+    if (option_indirect_ic) {
+        option_aot = 0;
+    }
+}
+
+static void handle_arg_latx_lock_stripes(const char *arg)
+{
+    option_lock_stripes = strtol(arg, NULL, 0);
+    if (option_lock_stripes <= 0 ||
+        option_lock_stripes > LAT_LOCK_MAX_STRIPES ||
+        (option_lock_stripes & (option_lock_stripes - 1))) {
+        lsassertm(0, "lock stripes must be a power of 2 no more than %d.",
+                  LAT_LOCK_MAX_STRIPES);
+    }
+    /* the stripe hash is baked into the translated code */
+    option_aot = 0;
+}
+
+static void handle_arg_latx_code_regions(const char *arg)
+{
+    option_code_regions = strtol(arg, NULL, 0);
+    if (option_code_regions < 1 || option_code_regions > 64) {
+        lsassertm(0, "code regions must be in [1, 64].");
+    }
+}
+
+static void handle_arg_latx_lazy_parallel(const char *arg)
+{
+    option_lazy_parallel = strtol(arg, NULL, 0);
+}
+
+static void handle_arg_latx_rep_bulk(const char *arg)
+{
+    option_rep_bulk = strtol(arg, NULL, 0);
+}
+
+static void handle_arg_latx_fence(const char *arg)
+{
+    option_fence = strtol(arg, NULL, 0);
+    if (option_fence < FENCE_FULL || option_fence > FENCE_TSO) {
+        lsassertm(0, "fence mode must be 0, 1 or 2.");
+    }
+}
+
+static void handle_arg_latx_prefetch(const char *arg)
+{
+    option_prefetch = strtol(arg, NULL, 0);
+}
+
+#ifdef CONFIG_LATX_IR2_SCHED
+static void handle_arg_latx_ir2_sched(const char *arg)
+{
+    option_ir2_sched = strtol(arg, NULL, 0);
+}
+#endif
+
+#ifdef CONFIG_LATX_HOT_TRACE
+static void handle_arg_latx_hot_trace(const char *arg)
+{
+    option_hot_trace = strtol(arg, NULL, 0);
+    if (option_hot_trace < 0) {
+        lsassertm(0, "hot trace threshold must not be negative.");
+    }
+}
+#endif
+
+#ifdef CONFIG_LATX_DECODE_CACHE
+static void handle_arg_latx_decode_cache(const char *arg)
+{
+    option_decode_cache = strtol(arg, NULL, 0);
+    if (option_decode_cache < 0) {
+        lsassertm(0, "decode cache size must not be negative.");
+    }
+}
+#endif
+
+#ifdef CONFIG_LATX_AVX
+static void handle_arg_latx_avx(const char *arg)
+{
+    option_avx = strtol(arg, NULL, 0);
+}
+#endif
+
+#ifdef CONFIG_LATX_PREDECODE
+static void handle_arg_latx_predecode(const char *arg)
+{
+    option_predecode = strtol(arg, NULL, 0);
+}
+#endif
+
+#ifdef CONFIG_LATX_TS_WORKER
+static void handle_arg_latx_ts_workers(const char *arg)
+{
+    option_ts_workers = strtol(arg, NULL, 0);
+    if (option_ts_workers < 0 || option_ts_workers > TS_WORKER_MAX) {
+        lsassertm(0, "ts workers must be in [0, %d].", TS_WORKER_MAX);
+    }
+}
+#endif
+
+#ifdef CONFIG_LATX_FLAG_REDUCTION
+static void handle_arg_latx_flag_depth(const char *arg)
+{
+    option_flag_depth = strtol(arg, NULL, 0);
+    if (option_flag_depth < 0 || option_flag_depth > 5) {
+        lsassertm(0, "flag depth must be in [0, 5].");
+    }
+}
+#endif
+
+#ifdef CONFIG_LATX_PERF
+static void handle_arg_latx_perf_file(const char *arg)
+{
+    latx_perf_file = arg;
+}
+
+static void handle_arg_latx_perf_interval(const char *arg)
+{
+    latx_perf_interval = strtol(arg, NULL, 0);
+    if (latx_perf_interval < 0) {
+        lsassertm(0, "perf interval must not be negative.");
+    }
+}
+#endif
+
 static void handle_arg_latx_softfpu(const char *arg)
 {
     option_softfpu = strtol(arg, NULL, 0);
@@ -778,6 +930,58 @@ static const struct qemu_argument arg_table[] = {
     "",           "specify enabled optimize type"},
     {"latx-close-parallel",    "LATX_CLOSE_PARALLEL",     true,  handle_arg_latx_parallel,
     "",           "disable latx parallel"},
+    {"latx-parallel-fast-jmp",    "LATX_PARALLEL_FAST_JMP",     true,  handle_arg_latx_parallel_fast_jmp,
+    "",           "use the per-vCPU fast jmp cache in parallel mode"},
+    {"latx-fast-jmp-ways",    "LATX_FAST_JMP_WAYS",     true,  handle_arg_latx_fast_jmp_ways,
+    "",           "ways per set of the fast jmp cache: 1, 2 or 4"},
+    {"latx-indirect-ic",    "LATX_INDIRECT_IC",     true,  handle_arg_latx_indirect_ic,
+    "",           "predict indirect jmp/call by the last two targets of the site"},
+    {"latx-lock-stripes",    "LATX_LOCK_STRIPES",     true,  handle_arg_latx_lock_stripes,
+    "",           "number of stripes for lock emulation, a power of 2"},
+    {"latx-code-regions",    "LATX_CODE_REGIONS",     true,  handle_arg_latx_code_regions,
+    "",           "split the code cache, evict the coldest region when full"},
+    {"latx-lazy-parallel",    "LATX_LAZY_PARALLEL",     true,  handle_arg_latx_lazy_parallel,
+    "",           "keep TBs that do not depend on CF_PARALLEL at the first thread, 0: flush all"},
+    {"latx-rep-bulk",    "LATX_REP_BULK",     true,  handle_arg_latx_rep_bulk,
+    "",           "copy, fill and scan REP string insns by LSX chunks when DF is clear"},
+    {"latx-fence",    "LATX_FENCE",     true,  handle_arg_latx_fence,
+    "",           "0: dbar 0 for fences, 1: weakest dbar hint, 2: also order every access (TSO) when parallel"},
+    {"latx-prefetch",    "LATX_PREFETCH",     true,  handle_arg_latx_prefetch,
+    "",           "translate x86 prefetch insns to preld, 0: drop them"},
+#ifdef CONFIG_LATX_FLAG_REDUCTION
+    {"latx-flag-depth",    "LATX_FLAG_DEPTH",     true,  handle_arg_latx_flag_depth,
+    "",           "successor depth searched for eflags liveness across TBs, 0: off"},
+#endif
+#ifdef CONFIG_LATX_IR2_SCHED
+    {"latx-ir2-sched",    "LATX_IR2_SCHED",     true,  handle_arg_latx_ir2_sched,
+    "",           "list schedule the IR2 of each TB to hide load latency"},
+#endif
+#ifdef CONFIG_LATX_HOT_TRACE
+    {"latx-hot-trace",    "LATX_HOT_TRACE",     true,  handle_arg_latx_hot_trace,
+    "",           "executions before a TB is retranslated as a hot trace, 0: off"},
+#endif
+#ifdef CONFIG_LATX_DECODE_CACHE
+    {"latx-decode-cache",    "LATX_DECODE_CACHE",     true,  handle_arg_latx_decode_cache,
+    "",           "TBs whose IR1 is kept for retranslation, 0: off"},
+#endif
+#ifdef CONFIG_LATX_AVX
+    {"latx-avx",    "LATX_AVX",     true,  handle_arg_latx_avx,
+    "",           "translate VEX insns on LASX, not advertised in CPUID, 1: on"},
+#endif
+#ifdef CONFIG_LATX_PREDECODE
+    {"latx-predecode",    "LATX_PREDECODE",     true,  handle_arg_latx_predecode,
+    "",           "decode a missing TB before mmap_lock when parallel, 0: off"},
+#endif
+#ifdef CONFIG_LATX_TS_WORKER
+    {"latx-ts-workers",    "LATX_TS_WORKERS",     true,  handle_arg_latx_ts_workers,
+    "",           "threads pre-translating the successors of new TBs, 0: off"},
+#endif
+#ifdef CONFIG_LATX_PERF
+    {"latx-perf-file",    "LATX_PERF_FILE",     true,  handle_arg_latx_perf_file,
+    "path",       "dump perf timers to this file at exit, as name,calls,ticks,seconds"},
+    {"latx-perf-interval",    "LATX_PERF_INTERVAL",     true,  handle_arg_latx_perf_interval,
+    "seconds",    "also rewrite the perf file every this many seconds"},
+#endif
     {"latx-softfpu",    "LATX_SOFTFPU",     true,  handle_arg_latx_softfpu,
     "",           "enable softfpu"},
     {"latx-softfpu-fast",    "LATX_SOFTFPU_FAST",     true,  handle_arg_latx_softfpu_fast,
@@ -1122,6 +1326,9 @@ int main(int argc, char **argv, char **envp)
     qemu_plugin_add_opts();
 
     optind = parse_args(argc, argv);
+#ifdef CONFIG_LATX_PERF
+    latx_perf_init();
+#endif
 
     if (argc >= 5 && !strcmp(argv[1], argv[2])) {
         long long hash = 0;
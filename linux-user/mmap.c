@@ -675,7 +675,7 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
 
     /*
      * If we're mapping shared memory, ensure we generate code for parallel
-     * execution and flush old translations.  This will work up to the level
+     * execution and drop old translations.  This will work up to the level
      * supported by the host -- anything that requires EXCP_ATOMIC will not
      * be atomic with respect to an external process.
      */
@@ -686,9 +686,13 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
         CPUState *cpu = thread_cpu;
         if (!(cpu->tcg_cflags & CF_PARALLEL)) {
             cpu->tcg_cflags |= CF_PARALLEL;
+#ifdef CONFIG_LATX
+            tb_enter_parallel(cpu);
+#else
             tb_flush(cpu);
+#endif
 #ifdef CONFIG_LATX
-            if (!close_latx_parallel) {
+            if (!latx_fast_jmp_cache_enabled(cpu->tcg_cflags)) {
                 CPUArchState* env = cpu->env_ptr;
                 latx_fast_jmp_cache_free(env);
             }
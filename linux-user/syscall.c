@@ -155,6 +155,7 @@
 #include <tunnel_lib.h>
 #include "aot.h"
 #include "latx-options.h"
+#include "latx-config.h"
 #endif
 
 #include <linux/perf_event.h>
@@ -5229,9 +5230,13 @@ static inline abi_ulong do_shmat(CPUArchState *cpu_env,
      */
     if (!(cpu->tcg_cflags & CF_PARALLEL)) {
         cpu->tcg_cflags |= CF_PARALLEL;
+#ifdef CONFIG_LATX
+        tb_enter_parallel(cpu);
+#else
         tb_flush(cpu);
+#endif
 #ifdef CONFIG_LATX
-        if (!close_latx_parallel) {
+        if (!latx_fast_jmp_cache_enabled(cpu->tcg_cflags)) {
             latx_fast_jmp_cache_free(cpu_env);
         }
 #endif
@@ -8895,9 +8900,13 @@ static int do_fork(CPUArchState *env, unsigned int flags, abi_ulong newsp,
          */
         if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
             cpu->tcg_cflags |= CF_PARALLEL;
+#ifdef CONFIG_LATX
+            tb_enter_parallel(cpu);
+#else
             tb_flush(cpu);
+#endif
 #ifdef CONFIG_LATX
-            if (!close_latx_parallel) {
+            if (!latx_fast_jmp_cache_enabled(cpu->tcg_cflags)) {
                 latx_fast_jmp_cache_free(env);
             }
 #endif
@@ -11413,6 +11422,12 @@ static abi_long do_syscall1(void *cpu_env, int num, abi_long arg1,
         if (CPU_NEXT(first_cpu)) {
             TaskState *ts = cpu->opaque;
 
+#ifdef CONFIG_LATX
+            /* other vCPUs clear our fast jmp cache under mmap_lock */
+            mmap_lock();
+            latx_fast_jmp_cache_free(cpu_env);
+            mmap_unlock();
+#endif
             object_property_set_bool(OBJECT(cpu), "realized", false, NULL);
             object_unparent(OBJECT(cpu));
             object_unref(OBJECT(cpu));
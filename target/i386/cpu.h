@@ -1413,6 +1413,13 @@ typedef struct CPUX86State {
     /* TODO: why? in new qemu has no next_eip member */
     target_ulong exception_next_eip;
     void *tb_jmp_cache_ptr; /* struct TranslationBlock ** */
+    void *fast_jmp_cache; /* per-vCPU struct FastTB[TB_JMP_CACHE_SIZE] */
+    void *hot_tb; /* struct TranslationBlock *, hot_count ran out */
+    target_ulong hot_pc; /* retranslate the TB at hot_pc as a hot trace */
+ #ifdef CONFIG_LATX_PROFILER
+    uint64_t fast_jmp_hit;
+    uint64_t fast_jmp_miss;
+ #endif
  #ifdef CONFIG_LATX_DEBUG
     uint64_t last_store_insn;
     uint64_t tb_exec_count;
@@ -24,21 +24,34 @@ extern  const char *aot_left_file_minsize_optarg;
  * +--------------+
  * |  AOT Segments|
  * +--------------+
+ * |  Page tables |
+ * +--------------+
  * |  X86 lib name|
  * +--------------+
+ * | Segment index|
+ * +--------------+
  * | AOT TB tables|
  * +--------------+
  * |  Rel tables  |
  * +--------------+
  * |  code caches |
  * +--------------+
+ * |  AOT_VERSION |
+ * +--------------+
  */
 #ifdef CONFIG_LATX_DEBUG
 #define AOT_VERSION "Version: "LATX_VERSION"-debug"
 #else
 #define AOT_VERSION "Version: "LATX_VERSION"-release"
 #endif
+/* "LAT2", first word of every v2 aot file. */
+#define AOT_MAGIC 0x3254414c
 typedef struct aot_header {
+    /* @magic, @version_hash and @file_size are checked against the mapped
+     * file before any other field is trusted. */
+    uint32_t magic;
+    uint32_t version_hash;
+    uint64_t file_size;
     uint32_t lib_size;
     struct timespec last_modify_time;
     uint32_t segment_table_offset;
@@ -47,6 +60,10 @@ typedef struct aot_header {
     uint32_t rel_entry_num; /* relocation entries num. */
     uint32_t parallel_tb_num;
     uint32_t unparallel_tb_num;
+    /* Open addressing table of (lib name, file offset) -> segment id + 1,
+     * @seg_index_size is a power of 2, or 0 if the file has no index. */
+    uint32_t seg_index_offset;
+    uint32_t seg_index_size;
     uint8_t is_pe;
 } aot_header;
 
@@ -107,6 +124,7 @@ typedef struct aot_tb {
     /* int tb_num; */
     uint16_t icount;
     uintptr_t jmp_indirect;
+    uintptr_t jmp_indirect_jirl;
     /* qemu TranslationBlock fields which should be recorded. */
     uint32_t size;
     uint32_t flags;
@@ -240,6 +258,11 @@ void recover_aot_tb(char *lib_name, uint64_t aot_offset,
 
 void do_generate_aot(int first_seg_in_lib, int end_seg_in_lib);
 struct aot_segment *aot_find_segment(char *path, int offset);
+uint32_t aot_seg_index_size(int seg_num);
+uintptr_t aot_build_seg_index(aot_header *p_header, aot_segment *p_segments,
+        uintptr_t table_end);
+void aot_seal_header(aot_header *p_header, size_t file_size);
+bool aot_header_valid(const void *buffer, size_t file_sz);
 
 void recover_tb(char *buf, uint64_t aot_offset, abi_long start,
         abi_long len);
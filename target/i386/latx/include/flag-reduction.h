@@ -4,7 +4,6 @@
 #include "latx-types.h"
 #include "lsenv.h"
 
-#define MAX_DEPTH 5 
 #define FLAG_DEFINE(opcode, _use, _def, _undef) \
 [dt_X86_INS_##opcode] = (IR1_EFLAG_USEDEF) \
 {.use = _use, .def = _def, .undef = _undef}
@@ -5,6 +5,7 @@
 #include "optimize-config.h"
 #include "exec/exec-all.h"
 #include "latx-disassemble-trace.h"
+#include "latx-options.h"
 
 extern void *interpret_glue;
 extern ADDR context_switch_bt_to_native;
@@ -29,12 +30,62 @@ void latx_guest_stack_init(CPUArchState *env);
 
 void latx_init_fpu_regs(CPUArchState *env);
 void latx_lsenv_init(CPUArchState *env);
+#ifdef CONFIG_LATX_TS_WORKER
+void latx_lsenv_worker_init(void);
+void ts_work_fork_start(void);
+void ts_work_fork_end(int child);
+#endif
 void latx_dt_init(void);
 void latx_fast_jmp_cache_free(CPUX86State *env);
 void latx_fast_jmp_cache_init(CPUX86State *env);
-void latx_fast_jmp_cache_add(int hash, struct TranslationBlock *tb);
-void latx_fast_jmp_cache_clear(int hash);
-void latx_fast_jmp_cache_clear_all(void);
+void latx_fast_jmp_cache_add(CPUState *cpu, struct TranslationBlock *tb);
+void latx_fast_jmp_cache_clear(CPUState *cpu, struct TranslationBlock *tb);
+void latx_fast_jmp_cache_clear_all(CPUState *cpu);
+#ifdef CONFIG_LATX_DECODE_CACHE
+void tr_decode_cache_invalidate(target_ulong start, target_ulong end);
+#endif
+#ifdef CONFIG_LATX_PREDECODE
+bool tr_predecode(CPUState *cpu, target_ulong pc, uint32_t cflags);
+#endif
+#ifdef CONFIG_LATX_PROFILER
+void latx_fast_jmp_cache_dump(void);
+void latx_lat_lock_dump(void);
+#endif
+
+/* last two targets of an indirect jmp/call site */
+typedef struct IndirectIC {
+    /* g_free_rcu needs it first */
+    struct rcu_head rcu;
+    uint64_t pc[2];
+    uintptr_t ptr[2];
+    /* way i is valid only if gen[i] is the gen of the bucket of pc[i] */
+    uint64_t gen[2];
+    uint64_t miss;
+    target_ulong site_pc;
+    QLIST_ENTRY(IndirectIC) node;
+    /* the other ICs of the same TB */
+    struct IndirectIC *tb_next;
+} IndirectIC;
+
+/* by tb_jmp_cache_hash_func of the predicted pc */
+extern uint64_t latx_indirect_ic_gen[TB_JMP_CACHE_SIZE];
+IndirectIC *latx_indirect_ic_alloc(struct TranslationBlock *tb,
+                                   target_ulong site_pc);
+void latx_indirect_ic_free(struct TranslationBlock *tb);
+void latx_indirect_ic_invalidate(target_ulong pc);
+void latx_indirect_ic_reset(void);
+
+/*
+ * Whether the code generated with @cflags looks up the per-vCPU flat
+ * {pc, host ptr} cache on indirect jumps.
+ */
+static inline bool latx_fast_jmp_cache_enabled(uint32_t cflags)
+{
+    if (close_latx_parallel) {
+        return false;
+    }
+    return !(cflags & CF_PARALLEL) || option_parallel_fast_jmp;
+}
 void ht_pc_thunk_insert(uint32_t thunk_addr, int reg_index);
 int ht_pc_thunk_lookup(uint32_t thunk_addr);
 void ht_pc_thunk_invalidate(uint32_t start, uint32_t end);
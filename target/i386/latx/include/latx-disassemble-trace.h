@@ -184,6 +184,10 @@ extern int (*la_disa_v1)(const uint8_t *code, size_t code_size,
         uint64_t address,
         size_t count, struct la_dt_insn **insn,
         int ir1_num, void *pir1_base);
+extern int (*la_disa_v2)(const uint8_t *code, size_t code_size,
+        uint64_t address,
+        size_t count, struct la_dt_insn **insn,
+        int ir1_num, void *pir1_base);
 extern void (*disassemble_trace_cmp)(const uint8_t *code, size_t code_size,
         uint64_t address,
         size_t count,
@@ -12,11 +12,45 @@ extern int option_insts_pattern;
 #endif
 #ifdef CONFIG_LATX_FLAG_REDUCTION
 extern int option_flag_reduction;
+extern int option_flag_depth;
 #endif
 #ifdef CONFIG_LATX_TU
 extern int option_tu_link;
 #endif
+#ifdef CONFIG_LATX_IR2_SCHED
+extern int option_ir2_sched;
+#endif
+#ifdef CONFIG_LATX_HOT_TRACE
+extern int option_hot_trace;
+#endif
+#ifdef CONFIG_LATX_DECODE_CACHE
+extern int option_decode_cache;
+#endif
+#ifdef CONFIG_LATX_AVX
+extern int option_avx;
+#endif
+#ifdef CONFIG_LATX_PREDECODE
+extern int option_predecode;
+#endif
+#ifdef CONFIG_LATX_TS_WORKER
+#define TS_WORKER_MAX 8
+extern int option_ts_workers;
+#endif
 extern int close_latx_parallel;
+extern int option_parallel_fast_jmp;
+extern int option_fast_jmp_ways;
+extern int option_indirect_ic;
+extern int option_lock_stripes;
+#define LAT_LOCK_MAX_STRIPES 4096
+extern int option_code_regions;
+extern int option_lazy_parallel;
+extern int option_rep_bulk;
+/* -latx-fence: dbar 0 for every fence, weakest dbar hint, or TSO */
+#define FENCE_FULL  0
+#define FENCE_WEAK  1
+#define FENCE_TSO   2
+extern int option_fence;
+extern int option_prefetch;
 extern int option_dump;
 extern int option_dump_host;
 extern int option_dump_ir1;
@@ -6,16 +6,30 @@
 #ifndef _LATX_PERF_H_
 #define _LATX_PERF_H_
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
 
 #define GENERATE_ENUM(ENUM)         ENUM,
 #define GENERATE_STRING(STRING)     #STRING,
+/*
+ * The last three are event counters, bumped with latx_timer_count() and
+ * reported with zero ticks.
+ */
 #define FOREACH_TIMER(TIMER)    \
         TIMER(TIMER_PROCESS)    \
         TIMER(TIMER_MMAP)       \
         TIMER(TIMER_MMAP_LOCK)  \
         TIMER(TIMER_PAGE_FLAGS) \
         TIMER(TIMER_TS)         \
+        TIMER(TIMER_DISASM)     \
+        TIMER(TIMER_IR1_OPT)    \
+        TIMER(TIMER_IR2_GEN)    \
+        TIMER(TIMER_ASSEMBLE)   \
+        TIMER(TIMER_AOT_LOAD)   \
+        TIMER(TIMER_TB_MISS)    \
+        TIMER(TIMER_INDIRECT_MISS) \
+        TIMER(TIMER_SMC_INVAL)  \
 
 
 typedef enum {
@@ -23,14 +37,80 @@ typedef enum {
     TIMER_COUNT
 } TimerCategory;
 
-typedef struct {
-    double total_time[TIMER_COUNT];
-    struct timespec last_start[TIMER_COUNT];
-    unsigned long call_times[TIMER_COUNT];
+/*
+ * One per thread, on exit its counts are folded into the retired ones
+ * and it is freed.
+ */
+typedef struct Timer {
+    uint64_t total_ticks[TIMER_COUNT];
+    uint64_t last_start[TIMER_COUNT];
+    uint64_t call_times[TIMER_COUNT];
+    struct Timer *next;
 } Timer;
 
-void latx_timer_start(TimerCategory category);
-void latx_timer_stop(TimerCategory category);
+extern __thread Timer *latx_timer;
+extern bool timer_switch[TIMER_COUNT];
+extern const char *latx_perf_file;
+extern int latx_perf_interval;
+
+Timer *latx_timer_register(void);
+
+/* Stable counter, a single rdtime.d on LoongArch. */
+static inline uint64_t latx_timer_now(void)
+{
+#ifdef __loongarch__
+    uint64_t val;
+    asm volatile("rdtime.d %0, $zero" : "=r"(val));
+    return val;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline Timer *latx_timer_get(void)
+{
+    Timer *t = latx_timer;
+    if (__builtin_expect(!t, 0)) {
+        t = latx_timer_register();
+    }
+    return t;
+}
+
+static inline void latx_timer_start(TimerCategory category)
+{
+    if (!timer_switch[category]) {
+        return;
+    }
+    latx_timer_get()->last_start[category] = latx_timer_now();
+}
+
+static inline void latx_timer_stop(TimerCategory category)
+{
+    if (!timer_switch[category]) {
+        return;
+    }
+    Timer *t = latx_timer_get();
+    /* started on another thread, e.g. TIMER_PROCESS ended by exit_group */
+    if (!t->last_start[category]) {
+        return;
+    }
+    t->total_ticks[category] += latx_timer_now() - t->last_start[category];
+    t->last_start[category] = 0;
+    t->call_times[category]++;
+}
+
+static inline void latx_timer_count(TimerCategory category)
+{
+    if (!timer_switch[category]) {
+        return;
+    }
+    latx_timer_get()->call_times[category]++;
+}
+
+void latx_perf_init(void);
+void latx_perf_dump(FILE *f);
 void latx_print_timer(TimerCategory category);
 void latx_print_all_timers(void);
 #endif
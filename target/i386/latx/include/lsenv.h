@@ -5,7 +5,6 @@
 #include "qemu-def.h"
 
 extern __thread ENV *lsenv;
-extern FastTB *fast_jmp_cache;
 
 /* func to access ENV's attributes */
 static inline int lsenv_offset_of_mips_regs(ENV *lsenv, int i)
@@ -50,6 +49,20 @@ static inline int lsenv_offset_of_tb_jmp_cache_ptr(ENV *lsenv)
     return (int)((ADDR)(&cpu->tb_jmp_cache_ptr) - (ADDR)lsenv->cpu_state);
 }
 
+#ifdef CONFIG_LATX_PROFILER
+static inline int lsenv_offset_of_fast_jmp_hit(ENV *lsenv)
+{
+    CPUX86State *cpu = (CPUX86State *)lsenv->cpu_state;
+    return (int)((ADDR)(&cpu->fast_jmp_hit) - (ADDR)lsenv->cpu_state);
+}
+
+static inline int lsenv_offset_of_fast_jmp_miss(ENV *lsenv)
+{
+    CPUX86State *cpu = (CPUX86State *)lsenv->cpu_state;
+    return (int)((ADDR)(&cpu->fast_jmp_miss) - (ADDR)lsenv->cpu_state);
+}
+#endif
+
 static inline int lsenv_offset_of_eip(ENV *lsenv)
 {
     CPUX86State *cpu = (CPUX86State *)lsenv->cpu_state;
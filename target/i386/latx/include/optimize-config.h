@@ -79,6 +79,20 @@
 #define CONFIG_LATX_SPLIT_TB
 #undef CONFIG_LATX_XCOMISX_OPT
 #define CONFIG_LATX_XCOMISX_OPT
+#undef CONFIG_LATX_IR2_SCHED
+#define CONFIG_LATX_IR2_SCHED       /* ir2 list scheduling */
+#undef CONFIG_LATX_HOT_TRACE
+#define CONFIG_LATX_HOT_TRACE       /* hot trace superblocks */
+#undef CONFIG_LATX_DECODE_CACHE
+#define CONFIG_LATX_DECODE_CACHE    /* reuse IR1 of unchanged code */
+#undef CONFIG_LATX_AVX
+#define CONFIG_LATX_AVX             /* VEX insns on LASX */
+#ifdef CONFIG_LATX_CAPSTONE_GIT
+#undef CONFIG_LATX_PREDECODE
+#define CONFIG_LATX_PREDECODE       /* decode before mmap_lock */
+#undef CONFIG_LATX_TS_WORKER
+#define CONFIG_LATX_TS_WORKER       /* background pre-translation */
+#endif
 
 #undef CONFIG_LATX_TU
 #define CONFIG_LATX_TU              /* tu, */
@@ -10,6 +10,7 @@
 #include "macro-inst.h"
 
 #include "aot.h"
+#include "latx-options.h"
 
 //#define LATX_DEBUG_SOFTFPU
 
@@ -738,12 +739,259 @@ TRANS_FUNC_DEF(crc32);
 TRANS_FUNC_DEF(salc);
 TRANS_FUNC_DEF(pclmulqdq);
 
+#ifdef CONFIG_LATX_AVX
+/* avx */
+TRANS_FUNC_DEF(vaddps);
+TRANS_FUNC_DEF(vaddpd);
+TRANS_FUNC_DEF(vsubps);
+TRANS_FUNC_DEF(vsubpd);
+TRANS_FUNC_DEF(vmulps);
+TRANS_FUNC_DEF(vmulpd);
+TRANS_FUNC_DEF(vdivps);
+TRANS_FUNC_DEF(vdivpd);
+TRANS_FUNC_DEF(vandps);
+TRANS_FUNC_DEF(vandpd);
+TRANS_FUNC_DEF(vandnps);
+TRANS_FUNC_DEF(vandnpd);
+TRANS_FUNC_DEF(vorps);
+TRANS_FUNC_DEF(vorpd);
+TRANS_FUNC_DEF(vxorps);
+TRANS_FUNC_DEF(vxorpd);
+TRANS_FUNC_DEF(vunpcklps);
+TRANS_FUNC_DEF(vunpcklpd);
+TRANS_FUNC_DEF(vunpckhps);
+TRANS_FUNC_DEF(vunpckhpd);
+TRANS_FUNC_DEF(vpaddb);
+TRANS_FUNC_DEF(vpaddw);
+TRANS_FUNC_DEF(vpaddd);
+TRANS_FUNC_DEF(vpaddq);
+TRANS_FUNC_DEF(vpsubb);
+TRANS_FUNC_DEF(vpsubw);
+TRANS_FUNC_DEF(vpsubd);
+TRANS_FUNC_DEF(vpsubq);
+TRANS_FUNC_DEF(vpaddsb);
+TRANS_FUNC_DEF(vpaddsw);
+TRANS_FUNC_DEF(vpaddusb);
+TRANS_FUNC_DEF(vpaddusw);
+TRANS_FUNC_DEF(vpsubsb);
+TRANS_FUNC_DEF(vpsubsw);
+TRANS_FUNC_DEF(vpsubusb);
+TRANS_FUNC_DEF(vpsubusw);
+TRANS_FUNC_DEF(vpand);
+TRANS_FUNC_DEF(vpandn);
+TRANS_FUNC_DEF(vpor);
+TRANS_FUNC_DEF(vpxor);
+TRANS_FUNC_DEF(vpcmpeqb);
+TRANS_FUNC_DEF(vpcmpeqw);
+TRANS_FUNC_DEF(vpcmpeqd);
+TRANS_FUNC_DEF(vpcmpeqq);
+TRANS_FUNC_DEF(vpcmpgtb);
+TRANS_FUNC_DEF(vpcmpgtw);
+TRANS_FUNC_DEF(vpcmpgtd);
+TRANS_FUNC_DEF(vpcmpgtq);
+TRANS_FUNC_DEF(vpmaxsb);
+TRANS_FUNC_DEF(vpmaxsw);
+TRANS_FUNC_DEF(vpmaxsd);
+TRANS_FUNC_DEF(vpmaxub);
+TRANS_FUNC_DEF(vpmaxuw);
+TRANS_FUNC_DEF(vpmaxud);
+TRANS_FUNC_DEF(vpminsb);
+TRANS_FUNC_DEF(vpminsw);
+TRANS_FUNC_DEF(vpminsd);
+TRANS_FUNC_DEF(vpminub);
+TRANS_FUNC_DEF(vpminuw);
+TRANS_FUNC_DEF(vpminud);
+TRANS_FUNC_DEF(vpavgb);
+TRANS_FUNC_DEF(vpavgw);
+TRANS_FUNC_DEF(vpmullw);
+TRANS_FUNC_DEF(vpmulld);
+TRANS_FUNC_DEF(vpmulhw);
+TRANS_FUNC_DEF(vpmulhuw);
+TRANS_FUNC_DEF(vpmuldq);
+TRANS_FUNC_DEF(vpmuludq);
+TRANS_FUNC_DEF(vpunpcklbw);
+TRANS_FUNC_DEF(vpunpcklwd);
+TRANS_FUNC_DEF(vpunpckldq);
+TRANS_FUNC_DEF(vpunpcklqdq);
+TRANS_FUNC_DEF(vpunpckhbw);
+TRANS_FUNC_DEF(vpunpckhwd);
+TRANS_FUNC_DEF(vpunpckhdq);
+TRANS_FUNC_DEF(vpunpckhqdq);
+TRANS_FUNC_DEF(vmaxps);
+TRANS_FUNC_DEF(vmaxpd);
+TRANS_FUNC_DEF(vminps);
+TRANS_FUNC_DEF(vminpd);
+TRANS_FUNC_DEF(vsqrtps);
+TRANS_FUNC_DEF(vsqrtpd);
+TRANS_FUNC_DEF(vcvtdq2ps);
+TRANS_FUNC_DEF(vaddss);
+TRANS_FUNC_DEF(vaddsd);
+TRANS_FUNC_DEF(vsubss);
+TRANS_FUNC_DEF(vsubsd);
+TRANS_FUNC_DEF(vmulss);
+TRANS_FUNC_DEF(vmulsd);
+TRANS_FUNC_DEF(vdivss);
+TRANS_FUNC_DEF(vdivsd);
+TRANS_FUNC_DEF(vsqrtss);
+TRANS_FUNC_DEF(vsqrtsd);
+TRANS_FUNC_DEF(vpsllw);
+TRANS_FUNC_DEF(vpslld);
+TRANS_FUNC_DEF(vpsllq);
+TRANS_FUNC_DEF(vpsrlw);
+TRANS_FUNC_DEF(vpsrld);
+TRANS_FUNC_DEF(vpsrlq);
+TRANS_FUNC_DEF(vpsraw);
+TRANS_FUNC_DEF(vpsrad);
+TRANS_FUNC_DEF(vpsllvd);
+TRANS_FUNC_DEF(vpsllvq);
+TRANS_FUNC_DEF(vpsrlvd);
+TRANS_FUNC_DEF(vpsrlvq);
+TRANS_FUNC_DEF(vpsravd);
+TRANS_FUNC_DEF(vpslldq);
+TRANS_FUNC_DEF(vpsrldq);
+TRANS_FUNC_DEF(vmovaps);
+TRANS_FUNC_DEF(vmovapd);
+TRANS_FUNC_DEF(vmovups);
+TRANS_FUNC_DEF(vmovupd);
+TRANS_FUNC_DEF(vmovdqa);
+TRANS_FUNC_DEF(vmovdqu);
+TRANS_FUNC_DEF(vlddqu);
+TRANS_FUNC_DEF(vmovntdqa);
+TRANS_FUNC_DEF(vmovntdq);
+TRANS_FUNC_DEF(vmovntps);
+TRANS_FUNC_DEF(vmovntpd);
+TRANS_FUNC_DEF(vmovd);
+TRANS_FUNC_DEF(vmovq);
+TRANS_FUNC_DEF(vmovss);
+TRANS_FUNC_DEF(vmovsd);
+TRANS_FUNC_DEF(vpbroadcastb);
+TRANS_FUNC_DEF(vpbroadcastw);
+TRANS_FUNC_DEF(vpbroadcastd);
+TRANS_FUNC_DEF(vpbroadcastq);
+TRANS_FUNC_DEF(vbroadcastss);
+TRANS_FUNC_DEF(vbroadcastsd);
+TRANS_FUNC_DEF(vbroadcastf128);
+TRANS_FUNC_DEF(vbroadcasti128);
+TRANS_FUNC_DEF(vinsertf128);
+TRANS_FUNC_DEF(vinserti128);
+TRANS_FUNC_DEF(vextractf128);
+TRANS_FUNC_DEF(vextracti128);
+TRANS_FUNC_DEF(vperm2f128);
+TRANS_FUNC_DEF(vperm2i128);
+TRANS_FUNC_DEF(vpermq);
+TRANS_FUNC_DEF(vpermpd);
+TRANS_FUNC_DEF(vpermd);
+TRANS_FUNC_DEF(vpermps);
+TRANS_FUNC_DEF(vpshufd);
+TRANS_FUNC_DEF(vpshuflw);
+TRANS_FUNC_DEF(vpshufhw);
+TRANS_FUNC_DEF(vshufps);
+TRANS_FUNC_DEF(vpshufb);
+TRANS_FUNC_DEF(vpabsb);
+TRANS_FUNC_DEF(vpabsw);
+TRANS_FUNC_DEF(vpabsd);
+TRANS_FUNC_DEF(vpblendvb);
+TRANS_FUNC_DEF(vblendvps);
+TRANS_FUNC_DEF(vblendvpd);
+TRANS_FUNC_DEF(vpmovmskb);
+TRANS_FUNC_DEF(vmovmskps);
+TRANS_FUNC_DEF(vmovmskpd);
+TRANS_FUNC_DEF(vptest);
+TRANS_FUNC_DEF(vzeroupper);
+TRANS_FUNC_DEF(vzeroall);
+TRANS_FUNC_DEF(vucomiss);
+TRANS_FUNC_DEF(vucomisd);
+TRANS_FUNC_DEF(vcomiss);
+TRANS_FUNC_DEF(vcomisd);
+TRANS_FUNC_DEF(vpextrb);
+TRANS_FUNC_DEF(vpextrw);
+TRANS_FUNC_DEF(vpextrd);
+TRANS_FUNC_DEF(vpextrq);
+TRANS_FUNC_DEF(vcvtps2dq);
+TRANS_FUNC_DEF(vmovshdup);
+TRANS_FUNC_DEF(vmovsldup);
+TRANS_FUNC_DEF(vmovddup);
+TRANS_FUNC_DEF(vpmovzxbw);
+TRANS_FUNC_DEF(vpmovzxbd);
+TRANS_FUNC_DEF(vpmovzxbq);
+TRANS_FUNC_DEF(vpmovzxwd);
+TRANS_FUNC_DEF(vpmovzxwq);
+TRANS_FUNC_DEF(vpmovzxdq);
+TRANS_FUNC_DEF(vpmovsxbw);
+TRANS_FUNC_DEF(vpmovsxbd);
+TRANS_FUNC_DEF(vpmovsxbq);
+TRANS_FUNC_DEF(vpmovsxwd);
+TRANS_FUNC_DEF(vpmovsxwq);
+TRANS_FUNC_DEF(vpmovsxdq);
+TRANS_FUNC_DEF(vfmadd132ps);
+TRANS_FUNC_DEF(vfmadd132pd);
+TRANS_FUNC_DEF(vfmadd132ss);
+TRANS_FUNC_DEF(vfmadd132sd);
+TRANS_FUNC_DEF(vfmadd213ps);
+TRANS_FUNC_DEF(vfmadd213pd);
+TRANS_FUNC_DEF(vfmadd213ss);
+TRANS_FUNC_DEF(vfmadd213sd);
+TRANS_FUNC_DEF(vfmadd231ps);
+TRANS_FUNC_DEF(vfmadd231pd);
+TRANS_FUNC_DEF(vfmadd231ss);
+TRANS_FUNC_DEF(vfmadd231sd);
+TRANS_FUNC_DEF(vfmsub132ps);
+TRANS_FUNC_DEF(vfmsub132pd);
+TRANS_FUNC_DEF(vfmsub132ss);
+TRANS_FUNC_DEF(vfmsub132sd);
+TRANS_FUNC_DEF(vfmsub213ps);
+TRANS_FUNC_DEF(vfmsub213pd);
+TRANS_FUNC_DEF(vfmsub213ss);
+TRANS_FUNC_DEF(vfmsub213sd);
+TRANS_FUNC_DEF(vfmsub231ps);
+TRANS_FUNC_DEF(vfmsub231pd);
+TRANS_FUNC_DEF(vfmsub231ss);
+TRANS_FUNC_DEF(vfmsub231sd);
+TRANS_FUNC_DEF(vfnmadd132ps);
+TRANS_FUNC_DEF(vfnmadd132pd);
+TRANS_FUNC_DEF(vfnmadd132ss);
+TRANS_FUNC_DEF(vfnmadd132sd);
+TRANS_FUNC_DEF(vfnmadd213ps);
+TRANS_FUNC_DEF(vfnmadd213pd);
+TRANS_FUNC_DEF(vfnmadd213ss);
+TRANS_FUNC_DEF(vfnmadd213sd);
+TRANS_FUNC_DEF(vfnmadd231ps);
+TRANS_FUNC_DEF(vfnmadd231pd);
+TRANS_FUNC_DEF(vfnmadd231ss);
+TRANS_FUNC_DEF(vfnmadd231sd);
+TRANS_FUNC_DEF(vfnmsub132ps);
+TRANS_FUNC_DEF(vfnmsub132pd);
+TRANS_FUNC_DEF(vfnmsub132ss);
+TRANS_FUNC_DEF(vfnmsub132sd);
+TRANS_FUNC_DEF(vfnmsub213ps);
+TRANS_FUNC_DEF(vfnmsub213pd);
+TRANS_FUNC_DEF(vfnmsub213ss);
+TRANS_FUNC_DEF(vfnmsub213sd);
+TRANS_FUNC_DEF(vfnmsub231ps);
+TRANS_FUNC_DEF(vfnmsub231pd);
+TRANS_FUNC_DEF(vfnmsub231ss);
+TRANS_FUNC_DEF(vfnmsub231sd);
+TRANS_FUNC_DEF(vfmaddsub132ps);
+TRANS_FUNC_DEF(vfmaddsub132pd);
+TRANS_FUNC_DEF(vfmaddsub213ps);
+TRANS_FUNC_DEF(vfmaddsub213pd);
+TRANS_FUNC_DEF(vfmaddsub231ps);
+TRANS_FUNC_DEF(vfmaddsub231pd);
+TRANS_FUNC_DEF(vfmsubadd132ps);
+TRANS_FUNC_DEF(vfmsubadd132pd);
+TRANS_FUNC_DEF(vfmsubadd213ps);
+TRANS_FUNC_DEF(vfmsubadd213pd);
+TRANS_FUNC_DEF(vfmsubadd231ps);
+TRANS_FUNC_DEF(vfmsubadd231pd);
+#endif
+
 void tr_init(void *tb);
 void tr_fini(bool check_the_extension); /* default TRUE */
 
 void tr_disasm(struct TranslationBlock *tb, int max_insns);
 void etb_add_succ(void* etb,int depth);
 int tr_translate_tb(struct TranslationBlock *tb);
+uint32_t tr_cflags(CPUState *cpu);
 int tr_ir2_generate(struct TranslationBlock *tb);
 int label_dispose(TranslationBlock *tb, TRANSLATION_DATA *lat_ctx);
 int tr_ir2_assemble(const void *code_start_addr, const IR2_INST *pir2);
@@ -753,6 +1001,7 @@ int8 get_etb_type(IR1_INST *pir1);
 #endif
 
 IR1_INST *get_ir1_list(struct TranslationBlock *tb, ADDRX pc, int max_insns);
+ADDRX tr_peek_ir1(IR1_INST *pir1, ADDRX pc, void *info);
 
 extern ADDR context_switch_native_to_bt_ret_0;
 extern ADDR context_switch_native_to_bt;
@@ -793,10 +1042,17 @@ extern int GPR_USEDEF_TO_SAVE;
 extern int FPR_USEDEF_TO_SAVE;
 extern int XMM_USEDEF_TO_SAVE;
 
+/*
+ * Stripes guarding the non-llsc lock emulation, indexed by a hash of the
+ * cache line. Only option_lock_stripes of them are used.
+ */
 struct lat_lock{
 	int lock;
+#ifdef CONFIG_LATX_PROFILER
+	uint32_t contended;
+#endif
 } __attribute__ ((aligned (64)));;
-extern struct lat_lock lat_lock[16];
+extern struct lat_lock lat_lock[LAT_LOCK_MAX_STRIPES];
 
 void tr_set_running_of_cs(bool value);
 void tr_save_gpr_to_env(uint8 gpr_to_save);
@@ -920,16 +1176,25 @@ void tr_gen_call_to_helper1(ADDR func, int use_fp, enum aot_rel_kind);
 void tr_gen_call_to_helper2(ADDR, IR2_OPND, int, enum aot_rel_kind);
 void tr_gen_call_to_helper_xgetbv(void);
 void tr_gen_call_to_helper_vfll(ADDR, IR2_OPND, IR2_OPND, int);
-void tr_gen_call_to_helper_pcmpxstrx(ADDR, int, int, int);
 void tr_gen_call_to_helper_cvttpd2pi(ADDR, int, int);
-void tr_gen_call_to_helper_pclmulqdq(ADDR, int, int, int, int ,int );
-void tr_gen_call_to_helper_aes(ADDR, int, int, int);
 void tr_load_top_from_env(void);
 void tr_gen_top_mode_init(void);
 
 IR2_OPND tr_lat_spin_lock(IR2_OPND mem_addr, int imm);
 void tr_lat_spin_unlock(IR2_OPND lat_lock_addr);
 
+/*
+ * dbar hints: bit 4 asks ordering instead of completion, bits 3..0 leave
+ * out earlier loads, earlier stores, later loads and later stores.
+ */
+#define DBAR_FULL       0x00
+#define DBAR_SYNC       0x10    /* rw -> rw */
+#define DBAR_RMB        0x15    /* r -> r */
+#define DBAR_WMB        0x1a    /* w -> w */
+#define DBAR_ACQUIRE    0x14    /* r -> rw */
+#define DBAR_RELEASE    0x12    /* rw -> w */
+void tr_fence(int hint);
+
 void gen_softfpu_helper_prologue(IR1_INST *pir1);
 void gen_softfpu_helper_epilogue(IR1_INST *pir1);
 void update_fcsr_rm(IR2_OPND control_word, IR2_OPND fcsr);
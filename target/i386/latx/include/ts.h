@@ -29,6 +29,9 @@ void my_debug_ts1(TranslationBlock *tb);
 void dump_ir1(TranslationBlock *tb);
 uint64 translate_lib(seg_info **seg_info_vector, int begin_id,
         int end_id, CPUState *cpu, tb_tmp_message *tb_message_vector);
+#ifdef CONFIG_LATX_TS_WORKER
+void ts_work_queue_succ(CPUState *cpu, TranslationBlock *tb);
+#endif
 extern __thread TranslationBlock **ts_vector;
 extern __thread int in_pre_translate;
 #endif
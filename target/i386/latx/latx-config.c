@@ -430,47 +430,283 @@ static __thread TRANSLATION_DATA tr_data_real;
 
 /* global lsenv defined here */
 __thread ENV *lsenv;
-FastTB *fast_jmp_cache;
 
+#ifdef CONFIG_LATX_PROFILER
+/* counters of the vCPUs which have already exited */
+static uint64_t fast_jmp_hit_exited;
+static uint64_t fast_jmp_miss_exited;
+#endif
 
+/*
+ * Every vCPU owns its fast_jmp_cache. Entries are only added by the owner
+ * thread, other threads may clear them while holding mmap_lock.
+ *
+ * The cache is option_fast_jmp_ways-way set associative, the newest
+ * target of a set is kept in way 0.
+ */
+static FastTB *latx_fast_jmp_cache_set(CPUState *cpu, target_ulong pc)
+{
+    CPUX86State *env = cpu->env_ptr;
+    FastTB *fast_jmp_cache = env->fast_jmp_cache;
+    uint32_t set;
 
-void latx_fast_jmp_cache_add(int hash, struct TranslationBlock *tb)
+    if (!fast_jmp_cache) {
+        return NULL;
+    }
+    set = tb_jmp_cache_hash_func(pc) &
+          (TB_JMP_CACHE_SIZE / option_fast_jmp_ways - 1);
+    return &fast_jmp_cache[set * option_fast_jmp_ways];
+}
+
+void latx_fast_jmp_cache_add(CPUState *cpu, struct TranslationBlock *tb)
 {
-    fast_jmp_cache[hash].pc = tb->pc;
-    fast_jmp_cache[hash].ptr = tb->tc.ptr;
+    FastTB *set = latx_fast_jmp_cache_set(cpu, tb->pc);
+    int way;
+
+    if (!set) {
+        return;
+    }
+    for (way = 0; way < option_fast_jmp_ways - 1; way++) {
+        if (set[way].pc == tb->pc || !set[way].pc) {
+            break;
+        }
+    }
+    for (; way > 0; way--) {
+        qatomic_set(&set[way].ptr, set[way - 1].ptr);
+        qatomic_set(&set[way].pc, set[way - 1].pc);
+    }
+    qatomic_set(&set[0].ptr, tb->tc.ptr);
+    qatomic_set(&set[0].pc, tb->pc);
 }
 
-void latx_fast_jmp_cache_clear(int hash)
+void latx_fast_jmp_cache_clear(CPUState *cpu, struct TranslationBlock *tb)
 {
-    fast_jmp_cache[hash].pc = 0;
+    FastTB *set = latx_fast_jmp_cache_set(cpu, tb->pc);
+
+    if (!set) {
+        return;
+    }
+    for (int way = 0; way < option_fast_jmp_ways; way++) {
+        if (qatomic_read(&set[way].ptr) == tb->tc.ptr) {
+            qatomic_set(&set[way].pc, 0);
+        }
+    }
 }
 
-void latx_fast_jmp_cache_clear_all(void)
+void latx_fast_jmp_cache_clear_all(CPUState *cpu)
 {
+    CPUX86State *env = cpu->env_ptr;
+    FastTB *fast_jmp_cache = env->fast_jmp_cache;
+
+    if (!fast_jmp_cache) {
+        return;
+    }
     for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
-        fast_jmp_cache[i].pc = 0;
+        qatomic_set(&fast_jmp_cache[i].pc, 0);
     }
 }
 
 void latx_fast_jmp_cache_free(CPUX86State *env)
 {
     CPUState *cpu = env_cpu(env);
+    FastTB *fast_jmp_cache = env->fast_jmp_cache;
+
+    env->tb_jmp_cache_ptr = cpu->tb_jmp_cache;
+    qatomic_set(&env->fast_jmp_cache, NULL);
     if (fast_jmp_cache) {
         free(fast_jmp_cache);
     }
-    env->tb_jmp_cache_ptr = cpu->tb_jmp_cache;
+#ifdef CONFIG_LATX_PROFILER
+    qatomic_add(&fast_jmp_hit_exited, env->fast_jmp_hit);
+    qatomic_add(&fast_jmp_miss_exited, env->fast_jmp_miss);
+    env->fast_jmp_hit = 0;
+    env->fast_jmp_miss = 0;
+#endif
 }
 
 void latx_fast_jmp_cache_init(CPUX86State *env)
 {
-    size_t malloc_size;
-    malloc_size = sizeof(struct FastTB) * TB_JMP_CACHE_SIZE;
-    fast_jmp_cache = malloc(malloc_size);
+    FastTB *fast_jmp_cache;
+
+    fast_jmp_cache = calloc(TB_JMP_CACHE_SIZE, sizeof(struct FastTB));
     if (!fast_jmp_cache) {
         lsassertm(0, "fast_jmp_cache malloc error!\n");
     }
+    env->fast_jmp_cache = fast_jmp_cache;
     env->tb_jmp_cache_ptr = fast_jmp_cache;
+#ifdef CONFIG_LATX_PROFILER
+    env->fast_jmp_hit = 0;
+    env->fast_jmp_miss = 0;
+#endif
+}
+
+/*
+ * Inline caches of indirect jmp/call sites. Each belongs to the TB of its
+ * site and is freed with it. A way is filled with the gen of the bucket of
+ * its pc, and invalidating a TB bumps the gen of the bucket of its pc, so
+ * only the ways predicting a pc of that bucket go to the lookup again.
+ * The list is protected by mmap_lock.
+ */
+uint64_t latx_indirect_ic_gen[TB_JMP_CACHE_SIZE];
+static QLIST_HEAD(, IndirectIC) indirect_ic_list =
+    QLIST_HEAD_INITIALIZER(indirect_ic_list);
+#ifdef CONFIG_LATX_PROFILER
+/* site pc -> misses of the freed sites */
+static GHashTable *indirect_ic_miss_ht;
+#endif
+
+IndirectIC *latx_indirect_ic_alloc(TranslationBlock *tb, target_ulong site_pc)
+{
+    IndirectIC *ic = g_new0(IndirectIC, 1);
+
+    /* a bucket gen never gets there, both ways start invalid */
+    ic->gen[0] = UINT64_MAX;
+    ic->gen[1] = UINT64_MAX;
+    ic->site_pc = site_pc;
+    QLIST_INSERT_HEAD(&indirect_ic_list, ic, node);
+    ic->tb_next = tb->indirect_ic;
+    tb->indirect_ic = ic;
+    return ic;
+}
+
+/* the code of a dropped TB may still run until the grace period ends */
+static void indirect_ic_retire(IndirectIC *ic)
+{
+    QLIST_REMOVE(ic, node);
+#ifdef CONFIG_LATX_PROFILER
+    if (!indirect_ic_miss_ht) {
+        indirect_ic_miss_ht = g_hash_table_new(NULL, NULL);
+    }
+    if (ic->miss) {
+        gpointer key = GSIZE_TO_POINTER(ic->site_pc);
+        uint64_t miss = GPOINTER_TO_SIZE(
+            g_hash_table_lookup(indirect_ic_miss_ht, key));
+        g_hash_table_insert(indirect_ic_miss_ht, key,
+                            GSIZE_TO_POINTER(miss + ic->miss));
+    }
+#endif
+    g_free_rcu(ic, rcu);
+}
+
+void latx_indirect_ic_free(TranslationBlock *tb)
+{
+    IndirectIC *ic = tb->indirect_ic;
+
+    tb->indirect_ic = NULL;
+    while (ic) {
+        IndirectIC *next = ic->tb_next;
+
+        indirect_ic_retire(ic);
+        ic = next;
+    }
+}
+
+void latx_indirect_ic_invalidate(target_ulong pc)
+{
+    qatomic_inc(&latx_indirect_ic_gen[tb_jmp_cache_hash_func(pc)]);
+}
+
+/* all TBs are gone, free every IC */
+void latx_indirect_ic_reset(void)
+{
+    IndirectIC *ic, *next;
+
+    QLIST_FOREACH_SAFE(ic, &indirect_ic_list, node, next) {
+        indirect_ic_retire(ic);
+    }
+}
+
+#ifdef CONFIG_LATX_PROFILER
+static gint indirect_ic_miss_cmp(gconstpointer a, gconstpointer b,
+                                 gpointer ht)
+{
+    uint64_t miss_a = GPOINTER_TO_SIZE(g_hash_table_lookup(ht, a));
+    uint64_t miss_b = GPOINTER_TO_SIZE(g_hash_table_lookup(ht, b));
+
+    return miss_a < miss_b ? 1 : (miss_a > miss_b ? -1 : 0);
+}
+
+#define INDIRECT_IC_DUMP_SITES 32
+
+static void latx_indirect_ic_dump(void)
+{
+    GList *sites, *it;
+    int i = 0;
+
+    /* fold the live sites as if they were flushed */
+    latx_indirect_ic_reset();
+    if (!g_hash_table_size(indirect_ic_miss_ht)) {
+        return;
+    }
+    qemu_log("\nIndirect inline cache misses (top %d sites):\n",
+             INDIRECT_IC_DUMP_SITES);
+    sites = g_list_sort_with_data(g_hash_table_get_keys(indirect_ic_miss_ht),
+                                  indirect_ic_miss_cmp, indirect_ic_miss_ht);
+    for (it = sites; it && i < INDIRECT_IC_DUMP_SITES; it = it->next, i++) {
+        qemu_log(" 0x" TARGET_FMT_lx " %" PRId64 "\n",
+                 (target_ulong)GPOINTER_TO_SIZE(it->data),
+                 (uint64_t)GPOINTER_TO_SIZE(
+                     g_hash_table_lookup(indirect_ic_miss_ht, it->data)));
+    }
+    g_list_free(sites);
+}
+#endif
+
+#ifdef CONFIG_LATX_PROFILER
+void latx_fast_jmp_cache_dump(void)
+{
+    CPUState *cpu;
+    uint64_t hit = qatomic_read(&fast_jmp_hit_exited);
+    uint64_t miss = qatomic_read(&fast_jmp_miss_exited);
+
+    CPU_FOREACH(cpu) {
+        CPUX86State *env = cpu->env_ptr;
+        hit += env->fast_jmp_hit;
+        miss += env->fast_jmp_miss;
+    }
+    qemu_log("\nIndirect jmp cache Profile:\n");
+    qemu_log(" ├ hit:              %" PRId64 "\n", hit);
+    qemu_log(" └ miss:             %" PRId64 "\n", miss);
+    qemu_log("indirect hit ratio:  %0.1f%%\n",
+                (double)hit / (hit + miss ? hit + miss : 1) * 100.0);
+    latx_indirect_ic_dump();
+}
+
+#define LAT_LOCK_DUMP_STRIPES 16
+
+void latx_lat_lock_dump(void)
+{
+    int top[LAT_LOCK_DUMP_STRIPES];
+    int ntop = 0;
+    uint64_t total = 0;
+
+    for (int i = 0; i < option_lock_stripes; i++) {
+        uint32_t n = qatomic_read(&lat_lock[i].contended);
+        int j;
+
+        if (!n) {
+            continue;
+        }
+        total += n;
+        if (ntop == LAT_LOCK_DUMP_STRIPES &&
+            lat_lock[top[ntop - 1]].contended >= n) {
+            continue;
+        }
+        /* insertion into the descending top list */
+        for (j = MIN(ntop, LAT_LOCK_DUMP_STRIPES - 1);
+             j > 0 && lat_lock[top[j - 1]].contended < n; j--) {
+            top[j] = top[j - 1];
+        }
+        top[j] = i;
+        ntop = MIN(ntop + 1, LAT_LOCK_DUMP_STRIPES);
+    }
+    qemu_log("\nLock stripe contention (%d stripes):\n", option_lock_stripes);
+    qemu_log(" total spins:        %" PRId64 "\n", total);
+    for (int i = 0; i < ntop; i++) {
+        qemu_log(" stripe %4d:        %u\n", top[i], lat_lock[top[i]].contended);
+    }
 }
+#endif
 
 
 #ifdef CONFIG_LATX_DEBUG
@@ -581,6 +817,21 @@ void latx_init_fpu_regs(CPUArchState *env)
     }
 }
 
+#ifdef CONFIG_LATX_TS_WORKER
+/*
+ * lsenv of a thread translating for the vCPUs, lsenv->cpu_state is set
+ * to the env of each TB it translates.
+ */
+void latx_lsenv_worker_init(void)
+{
+    lsenv = &lsenv_real;
+    lsenv->tr_data = &tr_data_real;
+#ifdef CONFIG_LATX_TU
+    tu_control_init();
+#endif
+}
+#endif
+
 void latx_lsenv_init(CPUArchState *env)
 {
     lsenv = &lsenv_real;
@@ -8,9 +8,11 @@ la_name_enum_t git_x86_insn_bcast[5];
 la_name_enum_t git_x86_insn_op_type[4];
 la_name_enum_t git_x86_insn_avx_cc[X86_AVX_CC_TRUE_US + 1];
 
-csh git_handle;
-char git_cap_tmp[IR1_INST_SIZE];
+/* per thread, insns may be decoded outside mmap_lock */
+__thread csh git_handle;
+__thread char git_cap_tmp[IR1_INST_SIZE];
 uint8_t dt_gitcatstone_mode;
+static void xtm_capstone_init(int abi_bits);
 struct la_dt_insn *gitcapstone_get_from_insn(cs_insn *inputinfo,
     int ir1_num, void *pir1_base)
 {
@@ -112,6 +114,10 @@ int gitcapstone_get(const uint8_t *code, size_t code_size,
 {
     cs_insn *inputinfo;
     struct la_dt_insn *ret;
+    if (unlikely(!git_handle)) {
+        /* first decode of this thread */
+        xtm_capstone_init(dt_gitcatstone_mode);
+    }
     dtassert(git_handle);
     int git_count = latx_cs_disasm(git_handle, code, code_size,
         address, count, &inputinfo, 0, git_cap_tmp);
@@ -10,6 +10,7 @@ int option_kzt = 0;
 
 #ifdef CONFIG_LATX_FLAG_REDUCTION
 int option_flag_reduction = 1;
+int option_flag_depth = 2;
 #endif
 
 int option_lative = 0;
@@ -39,7 +40,40 @@ int option_tunnel_lib;
 int option_insts_pattern = 1;
 #endif
 
+#ifdef CONFIG_LATX_IR2_SCHED
+int option_ir2_sched;
+#endif
+
+#ifdef CONFIG_LATX_HOT_TRACE
+int option_hot_trace;
+#endif
+
+#ifdef CONFIG_LATX_DECODE_CACHE
+int option_decode_cache = 4096;
+#endif
+
+#ifdef CONFIG_LATX_AVX
+int option_avx;
+#endif
+
+#ifdef CONFIG_LATX_PREDECODE
+int option_predecode = 1;
+#endif
+
+#ifdef CONFIG_LATX_TS_WORKER
+int option_ts_workers;
+#endif
+
 int close_latx_parallel;
+int option_parallel_fast_jmp;
+int option_fast_jmp_ways;
+int option_indirect_ic;
+int option_lock_stripes;
+int option_code_regions;
+int option_lazy_parallel;
+int option_rep_bulk;
+int option_fence;
+int option_prefetch;
 
 uint64_t option_begin_trace_addr;
 uint64_t option_end_trace_addr;
@@ -104,6 +138,15 @@ void options_init(void)
     option_dump_all_tb = 0;
     option_latx_disassemble_trace_cmp = 0;
     option_enable_lasx = 1;
+    option_parallel_fast_jmp = 1;
+    option_fast_jmp_ways = 2;
+    option_indirect_ic = 0;
+    option_lock_stripes = 256;
+    option_code_regions = 1;
+    option_lazy_parallel = 1;
+    option_rep_bulk = 1;
+    option_fence = FENCE_WEAK;
+    option_prefetch = 1;
 
     counter_tb_exec = 0;
     counter_tb_tr = 0;
@@ -4,9 +4,29 @@
  * @brief a timer module to aid in performance analysis.
  */
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
 #include "latx-perf.h"
 
-Timer latx_timer;
+__thread Timer *latx_timer;
+/* timer_list and retired, the counts of exited threads, under timer_lock */
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static Timer *timer_list;
+static Timer retired;
+static pthread_key_t timer_key;
+static pthread_once_t timer_key_once = PTHREAD_ONCE_INIT;
+
+/* -latx-perf-file, rewritten every -latx-perf-interval seconds and at exit */
+const char *latx_perf_file;
+int latx_perf_interval;
+
+/* Counter value and wall clock at latx_perf_init, to convert ticks. */
+static uint64_t base_ticks;
+static struct timespec base_time;
 
 const char* timer_names[] = {
     FOREACH_TIMER(GENERATE_STRING)
@@ -23,47 +43,184 @@ bool timer_switch[TIMER_COUNT] = {
     [TIMER_PROCESS] = true,
     [TIMER_MMAP_LOCK] = true,
     [TIMER_PAGE_FLAGS] = true,
+    [TIMER_DISASM] = true,
+    [TIMER_IR1_OPT] = true,
+    [TIMER_IR2_GEN] = true,
+    [TIMER_ASSEMBLE] = true,
+    [TIMER_AOT_LOAD] = true,
+    [TIMER_TB_MISS] = true,
+    [TIMER_INDIRECT_MISS] = true,
+    [TIMER_SMC_INVAL] = true,
 };
 #endif
 
-void latx_timer_start(TimerCategory category)
+/* Thread exit: keep the counts in retired, then free the timer. */
+static void latx_timer_release(void *arg)
 {
-    if (!timer_switch[category]) {
-        return;
+    Timer *t = arg;
+    Timer **p;
+
+    pthread_mutex_lock(&timer_lock);
+    for (int i = 0; i < TIMER_COUNT; ++i) {
+        retired.total_ticks[i] += t->total_ticks[i];
+        retired.call_times[i] += t->call_times[i];
+    }
+    for (p = &timer_list; *p != t; p = &(*p)->next) {
+    }
+    *p = t->next;
+    pthread_mutex_unlock(&timer_lock);
+    latx_timer = NULL;
+    free(t);
+}
+
+static void latx_timer_lock(void)
+{
+    pthread_mutex_lock(&timer_lock);
+}
+
+static void latx_timer_unlock(void)
+{
+    pthread_mutex_unlock(&timer_lock);
+}
+
+static void latx_timer_key_init(void)
+{
+    pthread_key_create(&timer_key, latx_timer_release);
+    /* a fork child must not inherit timer_lock held by another thread */
+    pthread_atfork(latx_timer_lock, latx_timer_unlock, latx_timer_unlock);
+}
+
+Timer *latx_timer_register(void)
+{
+    Timer *t = calloc(1, sizeof(Timer));
+    if (!t) {
+        abort();
+    }
+    pthread_once(&timer_key_once, latx_timer_key_init);
+    pthread_mutex_lock(&timer_lock);
+    t->next = timer_list;
+    timer_list = t;
+    pthread_mutex_unlock(&timer_lock);
+    pthread_setspecific(timer_key, t);
+    latx_timer = t;
+    return t;
+}
+
+/* Sum over all threads, racy reads of live counters are fine here. */
+static void latx_timer_sum(uint64_t *ticks, uint64_t *calls)
+{
+    pthread_mutex_lock(&timer_lock);
+    memcpy(ticks, retired.total_ticks, sizeof(uint64_t) * TIMER_COUNT);
+    memcpy(calls, retired.call_times, sizeof(uint64_t) * TIMER_COUNT);
+    for (Timer *t = timer_list; t; t = t->next) {
+        for (int i = 0; i < TIMER_COUNT; ++i) {
+            ticks[i] += __atomic_load_n(&t->total_ticks[i], __ATOMIC_RELAXED);
+            calls[i] += __atomic_load_n(&t->call_times[i], __ATOMIC_RELAXED);
+        }
     }
-    clock_gettime(CLOCK_MONOTONIC, &latx_timer.last_start[category]);
+    pthread_mutex_unlock(&timer_lock);
 }
 
-void latx_timer_stop(TimerCategory category)
+static double ticks_per_second(void)
 {
-    if (!timer_switch[category]) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - base_time.tv_sec) +
+                     (now.tv_nsec - base_time.tv_nsec) * 1e-9;
+    uint64_t ticks = latx_timer_now() - base_ticks;
+    return (elapsed > 0 && ticks) ? ticks / elapsed : 1e9;
+}
+
+/*
+ * Machine readable dump, one "name,calls,ticks,seconds" line per timer
+ * after a "#" header line.
+ */
+void latx_perf_dump(FILE *f)
+{
+    uint64_t ticks[TIMER_COUNT], calls[TIMER_COUNT];
+    double freq = ticks_per_second();
+
+    latx_timer_sum(ticks, calls);
+    fprintf(f, "# latx-perf pid=%d ticks_per_second=%.0f\n", getpid(), freq);
+    for (int i = 0; i < TIMER_COUNT; ++i) {
+        if (timer_switch[i]) {
+            fprintf(f, "%s,%lu,%lu,%.9f\n", timer_names[i],
+                    (unsigned long)calls[i], (unsigned long)ticks[i],
+                    ticks[i] / freq);
+        }
+    }
+}
+
+/* Write to a temporary file and rename, readers never see a torn dump. */
+static void latx_perf_dump_file(void)
+{
+    char tmp[PATH_MAX];
+    FILE *f;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", latx_perf_file, getpid());
+    f = fopen(tmp, "w");
+    if (!f) {
         return;
     }
-    struct timespec end_time;
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    latx_perf_dump(f);
+    fclose(f);
+    rename(tmp, latx_perf_file);
+}
+
+static void *latx_perf_thread(void *arg)
+{
+    for (;;) {
+        sleep(latx_perf_interval);
+        latx_perf_dump_file();
+    }
+    return NULL;
+}
 
-    double elapsed_time =
-        (end_time.tv_sec - latx_timer.last_start[category].tv_sec) * 1e9;
-    elapsed_time +=
-        (end_time.tv_nsec - latx_timer.last_start[category].tv_nsec);
-    elapsed_time *= 1e-9; // Convert nanoseconds to seconds
+void latx_perf_init(void)
+{
+    base_ticks = latx_timer_now();
+    clock_gettime(CLOCK_MONOTONIC, &base_time);
+    latx_timer_register();
+
+    if (latx_perf_file && latx_perf_interval > 0) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        sigset_t set, oldset;
 
-    latx_timer.total_time[category] += elapsed_time;
-    latx_timer.call_times[category]++;
+        /* the guest owns signal delivery, keep them off this thread */
+        sigfillset(&set);
+        pthread_sigmask(SIG_SETMASK, &set, &oldset);
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_create(&thread, &attr, latx_perf_thread, NULL);
+        pthread_attr_destroy(&attr);
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    }
 }
 
 void latx_print_timer(TimerCategory category)
 {
-    fprintf(stderr, "%-15s - Total time: %.9f seconds, Calls: %lu\n",
-        timer_names[category], latx_timer.total_time[category],
-        latx_timer.call_times[category]);
+    uint64_t ticks[TIMER_COUNT], calls[TIMER_COUNT];
+
+    latx_timer_sum(ticks, calls);
+    fprintf(stderr, "%-20s - Total time: %.9f seconds, Calls: %lu\n",
+        timer_names[category], ticks[category] / ticks_per_second(),
+        (unsigned long)calls[category]);
 }
 
 void latx_print_all_timers(void)
 {
+    uint64_t ticks[TIMER_COUNT], calls[TIMER_COUNT];
+    double freq = ticks_per_second();
+
+    latx_timer_sum(ticks, calls);
     for (int i = 0; i < TIMER_COUNT; ++i) {
         if (timer_switch[i]) {
-            latx_print_timer(i);
+            fprintf(stderr, "%-20s - Total time: %.9f seconds, Calls: %lu\n",
+                timer_names[i], ticks[i] / freq, (unsigned long)calls[i]);
         }
     }
+    if (latx_perf_file) {
+        latx_perf_dump_file();
+    }
 }
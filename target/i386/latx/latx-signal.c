@@ -100,21 +100,17 @@ void unlink_indirect_jmp(CPUArchState *env, TranslationBlock *tb, ucontext_t *uc
     }
 #endif
 #endif
-    CPUState *cpu = env_cpu(env);
-    uint32_t parallel = cpu->tcg_cflags & CF_PARALLEL;
-    if (!close_latx_parallel && !parallel) {
+    if (tb->jmp_indirect_jirl != TB_JMP_RESET_OFFSET_INVALID) {
         /*
-         * srli.d    itmp6,$x,16
-         * xor       itmp6,$x,itmp6
-         * bstrpick.d  itmp6,itmp6,15,0
-         * alsl.d    itmp6,itmp6,$fp,3
-         * ld.d      itmp1,itmp6,0
-         * bne       itmp1,$x,3
+         * The goto is inlined (see generate_indirect_goto), every hit of
+         * the inline cache and of the fast jmp cache ends at one jirl:
+         *
          * ld.d      itmp1,itmp6,8
          * jirl      $zero,itmp1,0
          */
-        insn = qatomic_read((uint32_t *)(jmp_rx + INS_SIZE * 7));
-        jmp_rw += INS_SIZE * 7;
+        jmp_rx = tc_ptr + tb->jmp_indirect_jirl;
+        jmp_rw = jmp_rx - tcg_splitwx_diff;
+        insn = qatomic_read((uint32_t *)jmp_rx);
     }
 
     env->insn_save[0] = jmp_rw;
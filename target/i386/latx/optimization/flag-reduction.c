@@ -1,4 +1,5 @@
 #include "common.h"
+#include "latx-options.h"
 #include "ir1.h"
 #include "translate.h"
 #include "flag-reduction.h"
@@ -271,7 +272,7 @@ static const IR1_EFLAG_USEDEF ir1_opcode_eflag_usedef[] = {
 };
 
 
-static const IR1_EFLAG_USEDEF *ir1_opcode_to_eflag_usedef(IR1_INST *ir1)
+static inline const IR1_EFLAG_USEDEF *ir1_eflag_usedef_lookup(IR1_INST *ir1)
 {
     if (ir1_opcode(ir1) == dt_X86_INS_MOVSD) {
         if (ir1->info->x86.opcode[0] == 0xa5) {
@@ -279,12 +280,16 @@ static const IR1_EFLAG_USEDEF *ir1_opcode_to_eflag_usedef(IR1_INST *ir1)
                 (dt_X86_INS_MOVSB - dt_X86_INS_INVALID);
         }
     }
-    lsassertm((ir1_opcode_eflag_usedef +
-        (ir1_opcode(ir1) - dt_X86_INS_INVALID))->use !=
-         __INVALID, "%s\n", ir1->info->mnemonic);
     return ir1_opcode_eflag_usedef + (ir1_opcode(ir1) - dt_X86_INS_INVALID);
 }
 
+static const IR1_EFLAG_USEDEF *ir1_opcode_to_eflag_usedef(IR1_INST *ir1)
+{
+    const IR1_EFLAG_USEDEF *usedef = ir1_eflag_usedef_lookup(ir1);
+    lsassertm(usedef->use != __INVALID, "%s\n", ir1->info->mnemonic);
+    return usedef;
+}
+
 #ifdef CONFIG_LATX_FLAG_REDUCTION
 
 static inline uint32_t rotate_shift_get_masked_imm(IR1_OPND *d, IR1_OPND *s)
@@ -403,16 +408,165 @@ _false_path:
     return false;
 }
 
-uint8 pending_use_of_succ(void *tb, int indirect_depth, int max_depth)
+/* Guest insns one pending_use_of_succ walk may decode */
+#define FLAG_SUCC_MAX_INSNS 64
+
+/*
+ * State of one pending_use_of_succ walk. Successors are only looked at
+ * when they lie on the pages the TB itself is registered on: code there
+ * can only change through an SMC write, which invalidates the TB along
+ * with the successor it relied on, so the TB is retranslated against the
+ * new code. That does not hold for TBs checked by checksum (PAGE_MEMSHARE
+ * pages with -latx-monitor-shared-mem): they only verify their own bytes,
+ * so neither such a TB nor its successors take part in the walk.
+ */
+typedef struct {
+    TranslationBlock *tb;
+    ADDRX page_lo;
+    ADDRX page_hi;
+    int max_depth;
+    int insns_left;
+} FLAG_SUCC_WALK;
+
+static inline bool flag_succ_in_pages(FLAG_SUCC_WALK *walk,
+                                      ADDRX start, ADDRX last)
 {
-    TranslationBlock *ptb = (TranslationBlock *)tb;
-    IR1_INST *pir1 = tb_ir1_inst_last(ptb);
+    ADDRX first_page = start & TARGET_PAGE_MASK;
+    ADDRX last_page = last & TARGET_PAGE_MASK;
+    return (first_page == walk->page_lo || first_page == walk->page_hi) &&
+           (last_page == walk->page_lo || last_page == walk->page_hi);
+}
+
+/*
+ * Flags killed by pir1, i.e. the def part flag_reduction drops from the
+ * pending use.
+ */
+static uint8 flag_kill_of(IR1_INST *pir1, const IR1_EFLAG_USEDEF *usedef)
+{
+    uint8 kill = usedef->def;
+    if (kill & __INVALID) {
+        return __NONE;
+    }
+#ifndef CONFIG_LATX_RADICAL_EFLAGS
+    if (rotate_need_of(pir1)) {
+        kill &= ~__OF;
+    }
+    if (shift_need_oszpcf(pir1)) {
+        kill &= ~(__OSZPF | __CF);
+    }
+    if (double_shift_need_all(pir1)) {
+        kill &= ~(__OSZPF);
+    }
+#endif
+    return kill;
+}
+
+static uint8 flag_exit_use(FLAG_SUCC_WALK *walk, IR1_INST *pir1, int depth);
+
+/*
+ * Live-in flags of the code at pc. A successor already in the qht gives
+ * its eflag_use directly, otherwise its insns are decoded until the next
+ * TB ending and the walk goes on with its own successors.
+ */
+static uint8 flag_live_in_at(FLAG_SUCC_WALK *walk, ADDRX pc, int depth)
+{
+    TranslationBlock *succ;
+    IR1_INST ir1;
+    char info[IR1_INST_SIZE] QEMU_ALIGNED(16);
+    uint8 use = __NONE;
+    uint8 kill = __NONE;
+
+    if (!flag_succ_in_pages(walk, pc, pc)) {
+        return __ALL_EFLAGS;
+    }
+
+    succ = tb_htable_lookup(env_cpu(lsenv->cpu_state), pc,
+                            walk->tb->cs_base, walk->tb->flags,
+                            tb_cflags(walk->tb));
+    if (succ && option_monitor_shared_mem && succ->checksum) {
+        return __ALL_EFLAGS;
+    }
+    if (succ && succ->icount &&
+        flag_succ_in_pages(walk, succ->pc, succ->pc + succ->size - 1)) {
+        return succ->eflag_use;
+    }
+
+    do {
+        if (walk->insns_left-- <= 0) {
+            return __ALL_EFLAGS;
+        }
+        ADDRX next_pc = tr_peek_ir1(&ir1, pc, info);
+        if (ir1.info == NULL || !flag_succ_in_pages(walk, pc, next_pc - 1)) {
+            return __ALL_EFLAGS;
+        }
+        const IR1_EFLAG_USEDEF *usedef = ir1_eflag_usedef_lookup(&ir1);
+        if (usedef->use & __INVALID) {
+            return __ALL_EFLAGS;
+        }
+        use |= usedef->use & ~kill;
+        if (cmp_scas_need_zf(&ir1)) {
+            use |= __ZF & ~kill;
+        }
+        kill |= flag_kill_of(&ir1, usedef);
+        if ((kill & __ALL_EFLAGS) == __ALL_EFLAGS) {
+            return use;
+        }
+        pc = next_pc;
+    } while (!ir1_is_tb_ending(&ir1));
+
+    return use | (flag_exit_use(walk, &ir1, depth + 1) & ~kill);
+}
+
+/* Flags still pending when pir1, the last insn of a TB, is left. */
+static uint8 flag_exit_use(FLAG_SUCC_WALK *walk, IR1_INST *pir1, int depth)
+{
+    uint8 use;
+
     if (ir1_is_syscall(pir1) ||
         (ir1_is_call(pir1) && ir1_is_indirect_call(pir1))) {
         return __NONE;
-    } else {
+    }
+    if (depth > walk->max_depth) {
+        return __ALL_EFLAGS;
+    }
+
+    if (ir1_is_branch(pir1)) {
+        use = flag_live_in_at(walk, ir1_target_addr(pir1), depth);
+        if ((use & __ALL_EFLAGS) != __ALL_EFLAGS) {
+            use |= flag_live_in_at(walk, ir1_addr_next(pir1), depth);
+        }
+        return use;
+    } else if (ir1_is_call(pir1) ||
+               (ir1_is_jump(pir1) && !ir1_is_indirect_jmp(pir1))) {
+        return flag_live_in_at(walk, ir1_target_addr(pir1), depth);
+    }
+    return __ALL_EFLAGS;
+}
+
+/**
+ * @brief Flags the successors of tb may read
+ *
+ * @param tb Current TB, its IR1 list is decoded
+ * @param indirect_depth Depth of the successors of tb, starts from 1
+ * @param max_depth Successors deeper than this are taken as reading all
+ * @return uint8 flags pending at the exit of tb
+ */
+uint8 pending_use_of_succ(void *tb, int indirect_depth, int max_depth)
+{
+    TranslationBlock *ptb = (TranslationBlock *)tb;
+    IR1_INST *pir1 = tb_ir1_inst_last(ptb);
+    FLAG_SUCC_WALK walk = {
+        .tb = ptb,
+        .page_lo = ptb->pc & TARGET_PAGE_MASK,
+        .page_hi = (ptb->pc + ptb->size - 1) & TARGET_PAGE_MASK,
+        .max_depth = max_depth,
+        .insns_left = FLAG_SUCC_MAX_INSNS,
+    };
+
+    if (option_monitor_shared_mem && ptb->checksum) {
         return __ALL_EFLAGS;
     }
+    return flag_exit_use(&walk, pir1, indirect_depth);
 }
 
 /**
@@ -518,7 +672,7 @@ uint8 flag_reduction_check(TranslationBlock *tb)
         TCGProfile *prof = &tcg_ctx->prof;
         time_t ti = profile_getclock();
 #endif
-        uint8 pending_use = pending_use_of_succ(tb, 1, MAX_DEPTH);
+        uint8 pending_use = pending_use_of_succ(tb, 1, option_flag_depth);
 #ifdef CONFIG_LATX_PROFILER
         qatomic_add(&prof->flag_rdtn_search, profile_getclock() - ti);
 #endif
@@ -1,117 +1,387 @@
 #include "common.h"
+#include "latx-options.h"
 #include "translate.h"
 #include "la-append.h"
 #include "lsenv.h"
 #include "cpu.h"
 
-#if 0
-static bool has_dependency(IR2_INST *p1, IR2_INST *p2)
+#ifdef CONFIG_LATX_IR2_SCHED
+/*
+ * List scheduler over the IR2 list of one TB.
+ *
+ * Regions are runs of plain ALU, load and store insns, everything else
+ * (branches, LBT and FP ops, labels, pseudo insns) ends a region. Inside
+ * a region insns are reordered by a dependency DAG so that independent
+ * work fills the load-use and mul latency.
+ *
+ * LISA_X86_INST markers stay in the region as nodes. A load or a store
+ * may fault and a write to a register the guest can see is part of the
+ * guest state, such insns (anchored) never cross a marker and keep their
+ * order against each other, so a fault is still reported on the right
+ * x86 insn with the guest state of that insn. Only insns that write
+ * temps and cannot fault float across markers.
+ *
+ * Code after a label up to the next marker is left alone, labels mark
+ * patch sites and relocations that are found by position.
+ *
+ * The list links are kept and only the insn payloads are permuted, so
+ * ir2 ids still follow list order as ir2_opt_push_pop relies on.
+ */
+
+/* IR2 insns one scheduling region holds at most */
+#define SCHED_MAX_NODES     64
+#define SCHED_LOAD_LATENCY  4
+#define SCHED_MUL_LATENCY   4
+
+#define SCHED_LOAD      0x01
+#define SCHED_STORE     0x02
+#define SCHED_GUEST_WR  0x04    /* writes a register the guest can see */
+#define SCHED_MARKER    0x08    /* LISA_X86_INST */
+#define SCHED_RMW       0x10    /* opnd 0 is also read */
+#define SCHED_ANCHORED  (SCHED_LOAD | SCHED_STORE | SCHED_GUEST_WR)
+
+typedef struct {
+    IR2_INST *ir2;
+    uint64_t preds;
+    uint32_t gpr_def;
+    uint32_t gpr_use;
+    uint32_t fpr_def;
+    uint32_t fpr_use;
+    uint8_t flags;
+    uint8_t latency;
+    int height;
+    int ready_cycle;
+} SCHED_NODE;
+
+static bool ir2_sched_classify(IR2_INST *ir2, SCHED_NODE *node)
 {
-    IR2_OPND empty_opnd = ir2_opnd_new_none();
+    int first_use = 1;
 
-    for (int i = 0; i < 3; ++i) {
-        IR2_OPND *opnd1 = p1->_opnd + i;
-        if (ir2_opnd_cmp(opnd1, &empty_opnd)) {
-            break;
-        }
+    memset(node, 0, sizeof(*node));
+    node->latency = 1;
 
-        for (int j = 0; j < 3; ++j) {
-            IR2_OPND *opnd2 = p2->_opnd + j;
-            if (ir2_opnd_cmp(opnd2, &empty_opnd)) {
-                break;
+    switch (ir2_opcode(ir2)) {
+    case LISA_X86_INST:
+        node->flags = SCHED_MARKER;
+        node->latency = 0;
+        return true;
+    case LISA_LU32I_D:
+    case LISA_BSTRINS_W:
+    case LISA_BSTRINS_D:
+        node->flags |= SCHED_RMW;
+        break;
+    case LISA_ADD_W:
+    case LISA_ADD_D:
+    case LISA_SUB_W:
+    case LISA_SUB_D:
+    case LISA_ADDI_W:
+    case LISA_ADDI_D:
+    case LISA_AND:
+    case LISA_OR:
+    case LISA_XOR:
+    case LISA_NOR:
+    case LISA_ANDN:
+    case LISA_ORN:
+    case LISA_ANDI:
+    case LISA_ORI:
+    case LISA_XORI:
+    case LISA_SLL_W:
+    case LISA_SLL_D:
+    case LISA_SRL_W:
+    case LISA_SRL_D:
+    case LISA_SRA_W:
+    case LISA_SRA_D:
+    case LISA_SLLI_W:
+    case LISA_SLLI_D:
+    case LISA_SRLI_W:
+    case LISA_SRLI_D:
+    case LISA_SRAI_W:
+    case LISA_SRAI_D:
+    case LISA_ROTR_W:
+    case LISA_ROTR_D:
+    case LISA_ROTRI_W:
+    case LISA_ROTRI_D:
+    case LISA_SLT:
+    case LISA_SLTU:
+    case LISA_SLTI:
+    case LISA_SLTUI:
+    case LISA_LU12I_W:
+    case LISA_LU52I_D:
+    case LISA_EXT_W_B:
+    case LISA_EXT_W_H:
+    case LISA_BSTRPICK_W:
+    case LISA_BSTRPICK_D:
+    case LISA_ALSL_W:
+    case LISA_ALSL_WU:
+    case LISA_ALSL_D:
+    case LISA_MASKEQZ:
+    case LISA_MASKNEZ:
+        break;
+    case LISA_MUL_W:
+    case LISA_MUL_D:
+    case LISA_MULH_W:
+    case LISA_MULH_WU:
+    case LISA_MULH_D:
+    case LISA_MULH_DU:
+        node->latency = SCHED_MUL_LATENCY;
+        break;
+    case LISA_LD_B:
+    case LISA_LD_H:
+    case LISA_LD_W:
+    case LISA_LD_D:
+    case LISA_LD_BU:
+    case LISA_LD_HU:
+    case LISA_LD_WU:
+    case LISA_LDX_B:
+    case LISA_LDX_H:
+    case LISA_LDX_W:
+    case LISA_LDX_D:
+    case LISA_LDX_BU:
+    case LISA_LDX_HU:
+    case LISA_LDX_WU:
+    case LISA_LDPTR_W:
+    case LISA_LDPTR_D:
+    case LISA_FLD_S:
+    case LISA_FLD_D:
+    case LISA_FLDX_S:
+    case LISA_FLDX_D:
+    case LISA_VLD:
+    case LISA_VLDX:
+    case LISA_XVLD:
+    case LISA_XVLDX:
+        node->flags |= SCHED_LOAD;
+        node->latency = SCHED_LOAD_LATENCY;
+        break;
+    case LISA_ST_B:
+    case LISA_ST_H:
+    case LISA_ST_W:
+    case LISA_ST_D:
+    case LISA_STX_B:
+    case LISA_STX_H:
+    case LISA_STX_W:
+    case LISA_STX_D:
+    case LISA_STPTR_W:
+    case LISA_STPTR_D:
+    case LISA_FST_S:
+    case LISA_FST_D:
+    case LISA_FSTX_S:
+    case LISA_FSTX_D:
+    case LISA_VST:
+    case LISA_VSTX:
+    case LISA_XVST:
+    case LISA_XVSTX:
+        node->flags |= SCHED_STORE | SCHED_GUEST_WR;
+        first_use = 0;
+        break;
+    default:
+        return false;
+    }
+
+    for (int i = 0; i < ir2->op_count; i++) {
+        IR2_OPND *opnd = &ir2->_opnd[i];
+        int reg = opnd->_reg_num;
+
+        switch (ir2_opnd_type(opnd)) {
+        case IR2_OPND_NONE:
+        case IR2_OPND_IMM:
+            continue;
+        case IR2_OPND_GPR:
+        case IR2_OPND_FPR:
+            if (reg < 0 || reg >= 32) {
+                return false;
             }
+            break;
+        default:
+            return false;
+        }
 
-            if (opnd1->_reg_num == opnd2->_reg_num) {
-                IR2_OPND_TYPE t1 = ir2_opnd_type(opnd1);
-                IR2_OPND_TYPE t2 = ir2_opnd_type(opnd2);
-                if (t1 == IR2_OPND_GPR &&
-                    (t2 == IR2_OPND_GPR || t2 == IR2_OPND_MEM))
-                    return true;
-                else if (t2 == IR2_OPND_GPR &&
-                         (t1 == IR2_OPND_GPR || t1 == IR2_OPND_MEM)) {
-                    return true;
-                } else if (t1 == IR2_OPND_FPR && t2 == IR2_OPND_FPR) {
-                    return true;
+        if (ir2_opnd_type(opnd) == IR2_OPND_GPR) {
+            if (i >= first_use) {
+                if (reg) {
+                    node->gpr_use |= 1u << reg;
                 }
+                continue;
+            }
+            if (!reg) {
+                /* a nop, it may be a patch slot */
+                return false;
+            }
+            node->gpr_def |= 1u << reg;
+            if (node->flags & SCHED_RMW) {
+                node->gpr_use |= 1u << reg;
+            }
+            if (!ir2_opnd_is_itemp(opnd)) {
+                node->flags |= SCHED_GUEST_WR;
+            }
+        } else {
+            if (i >= first_use) {
+                node->fpr_use |= 1u << reg;
+                continue;
+            }
+            node->fpr_def |= 1u << reg;
+            if (!ir2_opnd_is_ftemp(opnd)) {
+                node->flags |= SCHED_GUEST_WR;
             }
         }
     }
+    return true;
+}
+
+static inline bool ir2_sched_raw(SCHED_NODE *a, SCHED_NODE *b)
+{
+    return (a->gpr_def & b->gpr_use) || (a->fpr_def & b->fpr_use);
+}
+
+/* b comes after a in the list, must it stay after a */
+static bool ir2_sched_depends(SCHED_NODE *a, SCHED_NODE *b)
+{
+    uint8_t mem = SCHED_LOAD | SCHED_STORE;
+    uint8_t pin = SCHED_MARKER | SCHED_ANCHORED;
+
+    if (ir2_sched_raw(a, b) ||
+        (a->gpr_def & b->gpr_def) || (a->gpr_use & b->gpr_def) ||
+        (a->fpr_def & b->fpr_def) || (a->fpr_use & b->fpr_def)) {
+        return true;
+    }
+    /* no alias analysis, a store orders all memory accesses */
+    if (((a->flags | b->flags) & SCHED_STORE) &&
+        (a->flags & mem) && (b->flags & mem)) {
+        return true;
+    }
+    /* a fault must see the guest state of its own x86 insn */
+    if (((a->flags & mem) && (b->flags & SCHED_GUEST_WR)) ||
+        ((a->flags & SCHED_GUEST_WR) && (b->flags & mem))) {
+        return true;
+    }
+    if (((a->flags | b->flags) & SCHED_MARKER) &&
+        (a->flags & pin) && (b->flags & pin)) {
+        return true;
+    }
     return false;
 }
-#endif
 
-#if 0
-static void tri_schedule_one_ir2(IR2_INST *p, int max_distance)
+/* schedule nodes[0, n), return the number of insns moved */
+static int ir2_sched_region(SCHED_NODE *nodes, int n)
 {
-    /* max_distance default is 10 */
-    int distance = 0;
-    /* 1. scan backward to find a proper position */
-    IR2_INST *ir2_first = lsenv->tr_data->first_ir2;
-    IR2_INST *ir2_block = ir2_prev(p);
-    while (ir2_block != ir2_first) {
-        IR2_OPCODE opc = ir2_opcode(ir2_block);
-        /* 1.1 if we meet a load/store/label, stop here. */
-        if (ir2_opcode_is_load(opc) || ir2_opcode_is_store(opc) ||
-            opc == mips_label) {
-            break;
-        }
-        /* 1.2. if we meet a branch/jump, stop after the delay slot */
-        else if (ir2_opcode_is_branch(opc) || ir2_opcode_is_f_branch(opc) ||
-                 opc == mips_j || opc == mips_jal || opc == mips_jr ||
-                 opc == mips_jalr) {
-            ir2_block = ir2_next(ir2_block);
-            break;
-        }
-        /* 1.3 if the operands has any dependency, stop here */
-        else if (has_dependency(p, ir2_block)) {
-            break;
-        }
-        /* 1.4 in other case, check the previous ir2 */
-        else {
-            ir2_block = ir2_prev(ir2_block);
-            distance++;
+    IR2_INST payload[SCHED_MAX_NODES];
+    uint64_t done = 0;
+    int cycle = 0;
+    int moved = 0;
+
+    if (n < 3) {
+        return 0;
+    }
+
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < j; i++) {
+            if (ir2_sched_depends(&nodes[i], &nodes[j])) {
+                nodes[j].preds |= 1ull << i;
+            }
         }
-        if (distance >= max_distance) {
-            break;
+    }
+    /* height: longest latency path to the end of the region */
+    for (int i = n - 1; i >= 0; i--) {
+        int height = 0;
+        for (int j = i + 1; j < n; j++) {
+            if (nodes[j].preds & (1ull << i)) {
+                int edge = ir2_sched_raw(&nodes[i], &nodes[j]) ?
+                           nodes[i].latency : 0;
+                height = MAX(height, edge + nodes[j].height);
+            }
         }
+        nodes[i].height = height + (nodes[i].flags & SCHED_MARKER ? 0 : 1);
     }
 
-    while (ir2_opcode(ir2_next(ir2_block)) == LISA_X86_INST) {
-        ir2_block = ir2_next(ir2_block);
+    for (int k = 0; k < n; k++) {
+        int pick = -1;
+        for (int i = 0; i < n; i++) {
+            if ((done & (1ull << i)) || (nodes[i].preds & ~done)) {
+                continue;
+            }
+            if (pick < 0) {
+                pick = i;
+                continue;
+            }
+            bool ready = nodes[i].ready_cycle <= cycle;
+            bool pick_ready = nodes[pick].ready_cycle <= cycle;
+            if (ready != pick_ready) {
+                if (ready) {
+                    pick = i;
+                }
+            } else if (!ready &&
+                       nodes[i].ready_cycle != nodes[pick].ready_cycle) {
+                if (nodes[i].ready_cycle < nodes[pick].ready_cycle) {
+                    pick = i;
+                }
+            } else if (nodes[i].height > nodes[pick].height) {
+                pick = i;
+            }
+        }
+        lsassert(pick >= 0);
+
+        SCHED_NODE *p = &nodes[pick];
+        int issue = MAX(cycle, p->ready_cycle);
+        for (int j = pick + 1; j < n; j++) {
+            if (nodes[j].preds & (1ull << pick)) {
+                int ready = issue +
+                            (ir2_sched_raw(p, &nodes[j]) ? p->latency : 0);
+                nodes[j].ready_cycle = MAX(nodes[j].ready_cycle, ready);
+            }
+        }
+        cycle = issue + (p->flags & SCHED_MARKER ? 0 : 1);
+        done |= 1ull << pick;
+        payload[k] = *p->ir2;
+        moved += (pick != k);
     }
 
-    /* 2. now we have a proper ir2_block, so insert p after ir2_block */
-    if (p != ir2_block && p != ir2_next(ir2_block)) {
-        ir2_remove(p);
-        ir2_insert_after(p, ir2_block);
+    if (moved) {
+        for (int k = 0; k < n; k++) {
+            IR2_INST *ir2 = nodes[k].ir2;
+            ir2->_opcode = payload[k]._opcode;
+            ir2->op_count = payload[k].op_count;
+            memcpy(ir2->_opnd, payload[k]._opnd, sizeof(ir2->_opnd));
+        }
     }
+    return moved;
 }
-#endif
 
-static __attribute__((unused))
-void ir2_schedule(TranslationBlock *tb)
+static void ir2_schedule(TranslationBlock *tb)
 {
-#if 0
-    /* 1. scan forward, from the second ir2 */
-    IR2_INST *ir2_current = ir2_next(lsenv->tr_data->first_ir2);
-    while (ir2_current != NULL) {
-        /* 1.1 schedule every load/store */
-        if (ir2_opcode_is_load(ir2_opcode(ir2_current)) ||
-            ir2_opcode_is_store(ir2_opcode(ir2_current))) {
-            tri_schedule_one_ir2(ir2_current, 10);
+    SCHED_NODE nodes[SCHED_MAX_NODES];
+    IR2_INST *ir2;
+    bool pinned = false;
+    int n = 0, moved = 0;
+
+    /* the leading LISA_X86_INST stays first, push/pop relies on it */
+    ir2 = lsenv->tr_data->first_ir2;
+    if (ir2 == NULL) {
+        return;
+    }
+    for (ir2 = ir2_next(ir2); ir2 != NULL; ir2 = ir2_next(ir2)) {
+        IR2_OPCODE op = ir2_opcode(ir2);
+        if (op == LISA_LABEL) {
+            pinned = true;
+        } else if (op == LISA_X86_INST) {
+            pinned = false;
         }
-        /* 1.2 we should stop before the linkage code */
-        else if (ir2_opcode(ir2_current) == LISA_LABEL) {
-            int label_id = ir2_opnd_addr(ir2_current->_opnd);
-            if (tb->jmp_target_arg[0] == label_id ||
-                tb->jmp_target_arg[1] == label_id)
-                break;
+        if (n == SCHED_MAX_NODES) {
+            moved += ir2_sched_region(nodes, n);
+            n = 0;
+        }
+        if (!pinned && ir2_sched_classify(ir2, &nodes[n])) {
+            nodes[n++].ir2 = ir2;
+        } else {
+            moved += ir2_sched_region(nodes, n);
+            n = 0;
         }
-
-        ir2_current = ir2_next(ir2_current);
     }
-#endif
+    moved += ir2_sched_region(nodes, n);
+
+    qemu_log_mask(LAT_IR2_SCHED, "[LAT_SCHED] TB = 0x" TARGET_FMT_lx
+                  " moved %d\n", tb->pc, moved);
 }
+#endif
+
 static __attribute__((unused))
 void tri_separate_branch_from_ldst(TranslationBlock *tb)
 {
@@ -520,23 +790,57 @@ static void ir2_opt_push_pop(TranslationBlock *tb)
     }
 }
 
+/*
+ * Merge dbars that only have x86 insn markers between them: no access
+ * sits in the gap, so one dbar ordering both sets of accesses is enough.
+ * Hints merge by AND, an access class or completion asked by either dbar
+ * stays asked.
+ */
+static void ir2_opt_fence(void)
+{
+    IR2_INST *fence = NULL;
+    IR2_INST *curr = lsenv->tr_data->first_ir2;
+
+    while (curr) {
+        IR2_INST *next = ir2_next(curr);
+        IR2_OPCODE op = ir2_opcode(curr);
+        if (op == LISA_DBAR) {
+            if (fence) {
+                int hint = ir2_opnd_imm(&fence->_opnd[0]) &
+                           ir2_opnd_imm(&curr->_opnd[0]);
+                fence->_opnd[0] = create_immh_opnd(hint);
+                ir2_remove(ir2_get_id(curr));
+            } else {
+                fence = curr;
+            }
+        } else if (!la_ir2_opcode_is_x86_inst(op)) {
+            fence = NULL;
+        }
+        curr = next;
+    }
+}
+
 void tr_ir2_optimize(TranslationBlock *tb)
 {
+    /*
+     * the passes before push/pop change the host insn layout,
+     * ir2_opt_push_pop_fix replays them in this order
+     */
+    ir2_opt_fence();
+#ifdef CONFIG_LATX_IR2_SCHED
+    if (option_ir2_sched) {
+        ir2_schedule(tb);
+        tb->bool_flags |= IS_IR2_SCHED;
+    }
+#endif
 #ifdef CONFIG_LATX_OPT_PUSH_POP
     CPUX86State *env = (CPUX86State*)lsenv->cpu_state;
     CPUState *cpu = env_cpu(env);
-    uint32_t parallel = cpu->tcg_cflags & CF_PARALLEL;
+    uint32_t parallel = tr_cflags(cpu) & CF_PARALLEL;
     if (!parallel) {
         ir2_opt_push_pop(tb);
     }
 #endif
-    /* temporarily disabled to prevent reschedule ldc1 before dectop/inctop
-    if (0) {
-        ir2_schedule(lsenv->tr_data->curr_tb);
-        tri_avoid_last_ir2_is_ldst_not_rl();
-        tri_separate_branch_from_ldst(lsenv->tr_data->curr_tb);
-        tri_avoid_leading_label();
-    } */
 }
 
 extern void ir1_optimization(TranslationBlock *tb);
@@ -553,6 +857,12 @@ void ir2_opt_push_pop_fix(TranslationBlock *tb, CPUState *cpu, int i)
     ir1_optimization(ntb);
     tr_init(ntb);
     tr_ir2_generate(ntb);
+    ir2_opt_fence();
+#ifdef CONFIG_LATX_IR2_SCHED
+    if (tb->bool_flags & IS_IR2_SCHED) {
+        ir2_schedule(ntb);
+    }
+#endif
 
     IR2_INST *curr;
     int curr_id, end_id, off, patch_off, last_id;
@@ -24,6 +24,22 @@ static bool tb_ending_with_call(TranslationBlock *tb)
     return tb->next_86_pc ? true : false;
 }
 
+/*
+ * Keep the code region of next_tb from being evicted for as long as tb
+ * is patched to return there, see do_tb_phys_invalidate().
+ */
+static void jrra_pin(TranslationBlock *tb, TranslationBlock *next_tb)
+{
+    if (tb->jrra_pin == next_tb->tc.ptr) {
+        return;
+    }
+    if (tb->jrra_pin) {
+        tcg_region_unpin(tb->jrra_pin);
+    }
+    tb->jrra_pin = next_tb->tc.ptr;
+    tcg_region_pin(next_tb->tc.ptr);
+}
+
 static TranslationBlock *get_next_tb(TranslationBlock *tb, CPUState *cpu,
                     target_ulong cs_base, uint32_t flags, uint32_t cflags)
 {
@@ -81,6 +97,7 @@ static void patch_jrra(TranslationBlock *tb, TranslationBlock *next_tb)
 #endif
         *tb->return_target_ptr = (patch_pcalau12i | (patch_ori << 32));
         *(tb->return_target_ptr + 1) = (patch_scr1 | (patch_scr0 << 32));
+        jrra_pin(tb, next_tb);
     }
 }
 
@@ -108,6 +125,7 @@ static void patch_jrra_stack(TranslationBlock *tb, TranslationBlock *next_tb)
     tb->bool_flags |= IS_ENABLE_JRRA;
 #endif
     *tb->return_target_ptr = (patch_pcalau12i | (patch_ori << 32));
+    jrra_pin(tb, next_tb);
 }
 #endif /* ifdef CONFIG_LATX_JRRA */
 
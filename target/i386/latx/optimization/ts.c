@@ -14,6 +14,12 @@
 #ifdef CONFIG_LATX_TU
 #include "tu.h"
 #endif
+#ifdef CONFIG_LATX_TS_WORKER
+#include "qemu/units.h"
+#include "qemu/thread.h"
+#include "qemu/rcu.h"
+#include "lsenv.h"
+#endif
 
 /* static GTree *ts_tree; */
 static __thread tb_tmp_message *dynamic_tb_message_vector;
@@ -761,3 +767,179 @@ uint64 translate_lib(seg_info **seg_info_vector, int begin_id,
     return tb_num_in_ts;
 }
 
+#ifdef CONFIG_LATX_TS_WORKER
+/*
+ * Background pre-translation: after a miss in tb_find() the direct
+ * successors of the new TB are queued, -latx-ts-workers threads translate
+ * them with tb_gen_code() and publish them in the qht, where the vCPU
+ * finds them when it gets there.
+ */
+#define TS_WORK_QUEUE_SIZE 256
+/* code buffer left in the current region for a TB of a worker */
+#define TS_WORK_CODE_MARGIN (256 * KiB)
+
+typedef struct TSWork {
+    CPUState *cpu;
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+} TSWork;
+
+static struct {
+    QemuMutex lock;
+    QemuCond cond;
+    /* queue[head % SIZE] up to queue[tail % SIZE] are pending */
+    unsigned head, tail;
+    TSWork queue[TS_WORK_QUEUE_SIZE];
+} ts_work;
+static bool ts_work_started;
+
+/*
+ * Translate w like tb_find() would, unless it is translated meanwhile.
+ * Nothing in here may exit to cpu_loop as the vCPU does: the guest code
+ * is decoded by tr_predecode() from a copy of readable pages, and
+ * tb_gen_code() of a worker returns NULL on a full code buffer, in which
+ * case w is dropped. The margin only keeps workers from filling a region
+ * the vCPUs are about to need.
+ */
+static void ts_work_translate(TSWork *w)
+{
+    CPUState *cpu = w->cpu;
+
+    mmap_lock();
+    if (!tb_htable_lookup(cpu, w->pc, w->cs_base, w->flags, w->cflags) &&
+        tcg_ctx->code_gen_ptr + TS_WORK_CODE_MARGIN <
+            tcg_ctx->code_gen_highwater &&
+        (!option_split_tb ||
+         tcg_ctx->tb_gen_ptr + 2 * sizeof(TranslationBlock) <
+            tcg_ctx->tb_gen_highwater) &&
+        tr_predecode(cpu, w->pc, w->cflags)) {
+        lsenv->cpu_state = cpu->env_ptr;
+        tb_gen_code(cpu, w->pc, w->cs_base, w->flags, w->cflags);
+    }
+    mmap_unlock();
+}
+
+static void *ts_work_thread(void *arg)
+{
+    TSWork w;
+
+    rcu_register_thread();
+    tcg_register_thread();
+    latx_lsenv_worker_init();
+    tb_gen_fail_soft = true;
+
+    while (true) {
+        qemu_mutex_lock(&ts_work.lock);
+        while (ts_work.head == ts_work.tail) {
+            qemu_cond_wait(&ts_work.cond, &ts_work.lock);
+        }
+        w = ts_work.queue[ts_work.head++ % TS_WORK_QUEUE_SIZE];
+        qemu_mutex_unlock(&ts_work.lock);
+
+        ts_work_translate(&w);
+        object_unref(OBJECT(w.cpu));
+    }
+    return NULL;
+}
+
+/* Called with mmap_lock held. */
+static void ts_work_start(void)
+{
+    QemuThread thread;
+
+    qemu_mutex_init(&ts_work.lock);
+    qemu_cond_init(&ts_work.cond);
+    for (int i = 0; i < option_ts_workers; i++) {
+        qemu_thread_create(&thread, "latx-ts", ts_work_thread, NULL,
+                           QEMU_THREAD_DETACHED);
+    }
+    ts_work_started = true;
+}
+
+/* Queue pc unless the queue is full, a worker holds a reference to cpu. */
+static void ts_work_push(CPUState *cpu, TranslationBlock *tb, target_ulong pc)
+{
+    TSWork *w;
+
+    if (ts_work.tail - ts_work.head == TS_WORK_QUEUE_SIZE ||
+        (pc & TARGET_PAGE_MASK) == 0) {
+        return;
+    }
+    w = &ts_work.queue[ts_work.tail++ % TS_WORK_QUEUE_SIZE];
+    w->cpu = cpu;
+    w->pc = pc;
+    w->cs_base = tb->cs_base;
+    w->flags = tb->flags;
+    w->cflags = tb->cflags;
+    object_ref(OBJECT(cpu));
+}
+
+/**
+ * @brief Queue the direct successors of tb for the workers
+ *
+ * Called with mmap_lock held right after tb_gen_code(), while the IR1
+ * list of tb is still there. Successors get the cs_base, flags and cflags
+ * of tb, a TB reached with other ones is simply not found.
+ */
+void ts_work_queue_succ(CPUState *cpu, TranslationBlock *tb)
+{
+    IR1_INST *pir1;
+
+    if (!tb->icount || (tb->bool_flags & (IS_AOT_TB | IS_TUNNEL_LIB))) {
+        return;
+    }
+    if (!ts_work_started) {
+        ts_work_start();
+    }
+    pir1 = tb_ir1_inst_last(tb);
+
+    qemu_mutex_lock(&ts_work.lock);
+    if (ir1_is_branch(pir1) ||
+        (ir1_is_call(pir1) && !ir1_is_indirect_call(pir1))) {
+        ts_work_push(cpu, tb, ir1_target_addr(pir1));
+        ts_work_push(cpu, tb, ir1_addr_next(pir1));
+    } else if (ir1_is_jump(pir1) && !ir1_is_indirect_jmp(pir1)) {
+        /* also the jmp ending a TB of max_insns */
+        ts_work_push(cpu, tb, ir1_target_addr(pir1));
+    } else if (ir1_is_syscall(pir1)) {
+        ts_work_push(cpu, tb, ir1_addr_next(pir1));
+    }
+    qemu_cond_broadcast(&ts_work.cond);
+    qemu_mutex_unlock(&ts_work.lock);
+}
+
+/*
+ * Called from fork_start() with mmap_lock held, so no worker is inside
+ * tb_gen_code(), and the queue lock is not held across the fork.
+ */
+void ts_work_fork_start(void)
+{
+    if (ts_work_started) {
+        qemu_mutex_lock(&ts_work.lock);
+    }
+}
+
+/*
+ * The child has no worker threads and its queue refers to vCPUs of the
+ * parent, so it drops the queue with the references the entries hold,
+ * before fork_end() discards those vCPUs, and starts its own workers on
+ * the next ts_work_queue_succ().
+ */
+void ts_work_fork_end(int child)
+{
+    if (!ts_work_started) {
+        return;
+    }
+    if (child) {
+        while (ts_work.head != ts_work.tail) {
+            TSWork *w = &ts_work.queue[ts_work.head++ % TS_WORK_QUEUE_SIZE];
+            object_unref(OBJECT(w->cpu));
+        }
+        ts_work.head = ts_work.tail = 0;
+        ts_work_started = false;
+    }
+    qemu_mutex_unlock(&ts_work.lock);
+}
+#endif
@@ -13,6 +13,9 @@
 #include "latx-config.h"
 #include "tu.h"
 #include "reg-alloc.h"
+#ifdef CONFIG_LATX_PERF
+#include "latx-perf.h"
+#endif
 #include "latx-options.h"
 #include "aot_page.h"
 
@@ -80,7 +83,7 @@ void tu_enough_space(CPUState *cpu)
     if (unlikely((tcg_ctx->code_gen_ptr + MAX_TU_SIZE >= tcg_ctx->code_gen_highwater)
                 || (tcg_ctx->tb_gen_ptr + MAX_TB_IN_CACHE * sizeof(TranslationBlock)
                     >= tcg_ctx->tb_gen_highwater))){
-        tb_flush(cpu);
+        tb_evict(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -103,6 +106,7 @@ void tu_reset_tb(TranslationBlock *tb)
     tb->jmp_reset_offset[0] = TB_JMP_RESET_OFFSET_INVALID;
     tb->jmp_reset_offset[1] = TB_JMP_RESET_OFFSET_INVALID;
     tb->jmp_indirect = TB_JMP_RESET_OFFSET_INVALID;
+    tb->jmp_indirect_jirl = TB_JMP_RESET_OFFSET_INVALID;
 #ifdef CONFIG_LATX_INSTS_PATTERN
     tb->eflags_target_arg[0] = TB_JMP_RESET_OFFSET_INVALID;
     tb->eflags_target_arg[1] = TB_JMP_RESET_OFFSET_INVALID;
@@ -114,6 +118,8 @@ void tu_reset_tb(TranslationBlock *tb)
     tb_set_page_addr1(tb, -1);
     tb->next_86_pc = 0;
     tb->return_target_ptr = NULL;
+    tb->jrra_pin = NULL;
+    tb->indirect_ic = NULL;
 #ifdef CONFIG_LATX_TU
     tb->tc.offset_in_tu = 0;
     tb->next_pc = 0;
@@ -191,7 +197,7 @@ TranslationBlock* tb_create(CPUState *cpu, target_ulong pc,
         qemu_log_mask(LAT_LOG_AOT, "tb flush in tu translate\n");
         /* exit(-1); */
         /* flush must be done */
-        tb_flush(cpu);
+        tb_evict(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -1070,6 +1076,9 @@ void tu_ir1_optimization(TranslationBlock **tb_list, int tb_num_in_tu)
 {
     int option_over_tb_rfd = 1;
 
+#ifdef CONFIG_LATX_PERF
+    latx_timer_start(TIMER_IR1_OPT);
+#endif
     if (option_over_tb_rfd) {
         over_tb_rfd(tb_list, tb_num_in_tu);
     } else {
@@ -1077,6 +1086,9 @@ void tu_ir1_optimization(TranslationBlock **tb_list, int tb_num_in_tu)
             ir1_optimization(tb_list[i]);
         }
     }
+#ifdef CONFIG_LATX_PERF
+    latx_timer_stop(TIMER_IR1_OPT);
+#endif
 
 }
 
@@ -369,7 +369,7 @@ static size_t gen_tunnel_glue(TranslationBlock *tb,
     ARCH(gen_set_next_tb_code)(&esp_ir2_opnd);
     ARCH(gen_set_last_tb_code)(tb);
     /* tunnel glue return to indirect_jmp_glue*/
-    if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
+    if (latx_fast_jmp_cache_enabled(cpu->tcg_cflags)) {
         set_ret_location(tb, indirect_jmp_glue);
     } else {
         set_ret_location(tb, parallel_indirect_jmp_glue);
@@ -405,6 +405,7 @@ static void reset_tb(TranslationBlock *tb)
     tb->jmp_stub_reset_offset[0] = TB_JMP_RESET_OFFSET_INVALID;
     tb->jmp_stub_reset_offset[1] = TB_JMP_RESET_OFFSET_INVALID;
     tb->jmp_indirect = TB_JMP_RESET_OFFSET_INVALID;
+    tb->jmp_indirect_jirl = TB_JMP_RESET_OFFSET_INVALID;
 #ifdef CONFIG_LATX_INSTS_PATTERN
     tb->eflags_target_arg[0] = TB_JMP_RESET_OFFSET_INVALID;
     tb->eflags_target_arg[1] = TB_JMP_RESET_OFFSET_INVALID;
@@ -418,6 +419,8 @@ static void reset_tb(TranslationBlock *tb)
     tb_set_page_addr1(tb, -1);
     tb->next_86_pc = 0;
     tb->return_target_ptr = NULL;
+    tb->jrra_pin = NULL;
+    tb->indirect_ic = NULL;
 #ifdef CONFIG_LATX_AOT
     tb->s_data->rel_start = -1;
     tb->s_data->rel_end = -1;
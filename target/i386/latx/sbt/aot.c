@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "latx-options.h"
+#include "latx-config.h"
 #include "translate.h"
 #include "tunnel_lib.h"
 #include "qemu.h"
@@ -21,6 +22,9 @@
 #include "aot_page.h"
 #include<sys/syscall.h>
 #include "exec/translate-all.h"
+#ifdef CONFIG_LATX_PERF
+#include "latx-perf.h"
+#endif
 #ifdef CONFIG_LATX_AOT
 /* Tbs vector with @tb_num@ elements. */
 static TranslationBlock **tb_vector;
@@ -201,6 +205,7 @@ static struct aot_header *get_aot_buffer(int first_seg_in_lib,
         sizeof(struct aot_segment) * curr_lib_seg_num + /* AOT segment table size */
         sizeof(struct page_table_info) * page_count + /* AOT page table */
         PATH_MAX * curr_lib_seg_num +                   /* AOT segment name size */
+        sizeof(uint32_t) * aot_seg_index_size(curr_lib_seg_num) + /* segment index */
         sizeof(struct aot_tb) * tb_num +            /* AOT tb table size */
         sizeof(struct aot_rel) * rel_entry_num +/* AOT rel table size */
         256;                                      /* extra alignment bytes. */
@@ -295,6 +300,7 @@ static inline int create_aot_tb(aot_tb *curr_aot_tb, TranslationBlock *tb,
     curr_aot_tb->icount = tb->icount;
 
     curr_aot_tb->jmp_indirect = tb->jmp_indirect;
+    curr_aot_tb->jmp_indirect_jirl = tb->jmp_indirect_jirl;
     curr_aot_tb->tu_size = tb->s_data->tu_size;
     curr_aot_tb->offset_in_segment =
         tb->pc - curr_seg->details.seg_begin;
@@ -615,6 +621,8 @@ static int write_aot_file(int *lockfd, aot_header *p_header, uint32_t *p_insn,
 	}
     FILE *pfile = fdopen(fd, "w");
     size_t write_size = (uintptr_t)p_insn - (uintptr_t)p_header;
+    aot_seal_header(p_header,
+            write_size + total_code_cache_size + strlen(AOT_VERSION));
 
     /* FILE *tp = pfile; */
     if (fwrite(p_header, write_size, 1, pfile) != 1) {
@@ -681,6 +689,7 @@ void do_generate_aot(int first_seg_in_lib, int end_seg_in_lib)
         (struct aot_segment *)ROUND_UP((uintptr_t)(p_header + 1), 8);
     /* Fill segment table and save lib name to string table */
     fill_seg_table(first_seg_in_lib, end_seg_in_lib, p_header, p_segments);
+    table_end_addr = aot_build_seg_index(p_header, p_segments, table_end_addr);
     init_page_table(p_segments, p_header);
     struct aot_tb *p_aot_tbs; 
     p_aot_tbs = (struct aot_tb *)ROUND_UP(table_end_addr, 8);
@@ -739,38 +748,27 @@ static int get_tb_num(char *lib_name, CPUState *cpu) {
         return 0;
     }
     int fd = open(aot_file_path, O_RDONLY);
-    FILE *pf = fdopen(fd, "r");
-    lsassert(pf && ("open aot file failed!"));
-    /* Get file size */
-    fseek(pf, 0, SEEK_END);      /* seek to end of file */
-    size_t file_sz = ftell(pf);  /* get current file pointer */
-    char aot_version[strlen(AOT_VERSION) + 1];
-    /*check aot complete.*/
-    if (fseek(pf, -strlen(AOT_VERSION), SEEK_END) != 0) {
-        qemu_log_mask(LAT_LOG_AOT, "can't fseek aot file\n");
-        fclose(pf);
-        return 0;
-    }
-    if (fread(aot_version, strlen(AOT_VERSION), 1, pf) != 1) {
-        qemu_log_mask(LAT_LOG_AOT, "get error.\n");
-        fclose(pf);
+    struct stat file_stat;
+    if (fd < 0) {
         return 0;
     }
-    if (!strstr(aot_version, AOT_VERSION)) {
-        qemu_log_mask(LAT_LOG_AOT, "aot file is not complete %s\n", lib_name);
-        remove(aot_file_path);
+    if (fstat(fd, &file_stat) || file_stat.st_size == 0) {
+        close(fd);
         return 0;
     }
-    fseek(pf, 0, SEEK_SET);      /* seek back to beginning of file */
-
-    /* Read aot file */
-    /* buffer = malloc(file_sz); */
+    size_t file_sz = file_stat.st_size;
     void *buffer = mmap(NULL, file_sz, PROT_READ, MAP_SHARED, fd, 0);
-    if (buffer < 0) {
+    close(fd);
+    if (buffer == MAP_FAILED) {
         qemu_log_mask(LAT_LOG_AOT, "aot file mmap error\n");
         return 0;
     }
-    assert(buffer);
+    if (!aot_header_valid(buffer, file_sz)) {
+        qemu_log_mask(LAT_LOG_AOT, "aot file is not complete %s\n", lib_name);
+        munmap(buffer, file_sz);
+        remove(aot_file_path);
+        return 0;
+    }
     aot_header *p_header = (aot_header *)buffer;
     /* dump_aot_buffer(p_header); */
     struct stat statbuf;
@@ -780,6 +778,7 @@ static int get_tb_num(char *lib_name, CPUState *cpu) {
             || p_header->last_modify_time.tv_nsec != statbuf.st_mtim.tv_nsec) {
         qemu_log_mask(LAT_LOG_AOT, "need remove old aot file. %s lib_size %d %ld\n",
                 aot_file_path, p_header->lib_size, statbuf.st_size);
+        munmap(buffer, file_sz);
         remove(aot_file_path);
         qemu_log_mask(LAT_LOG_AOT, "remove end\n");
         return 0;
@@ -793,7 +792,6 @@ static int get_tb_num(char *lib_name, CPUState *cpu) {
     }
 
     munmap(buffer, file_sz);
-    fclose(pf);
     return aim_tb_num;
 }
 
@@ -1066,40 +1064,31 @@ lib_info *aot_load(char *lib_name)
         return NULL;
     }
 
-    /* Open aot_file. */
-    void *buffer;
+#ifdef CONFIG_LATX_PERF
+    latx_timer_start(TIMER_AOT_LOAD);
+#endif
+    /* Map aot_file, everything below is checked on the mapping. */
+    void *buffer = MAP_FAILED;
+    size_t file_sz = 0;
     struct stat statbuf;
     lib_info *curr_lib_info = NULL;
-    char aot_version[strlen(AOT_VERSION) + 1];
     int fd = open(aot_file_path, O_RDONLY);
-    FILE *pf = NULL;
-    if (fd < 0) {
+    if (fd < 0 || fstat(fd, &statbuf)) {
         goto exit_aot_load;
     }
-    pf = fdopen(fd, "r");
-    lsassert(pf && ("open aot file failed!"));
-    fseek(pf, 0, SEEK_END);      /* seek to end of file */
-    size_t file_sz = ftell(pf);  /* get current file pointer */
-
-    /*check aot complete.*/
-    if (fseek(pf, -strlen(AOT_VERSION), SEEK_END) != 0
-            || fread(aot_version, strlen(AOT_VERSION), 1, pf) != 1) {
+    file_sz = statbuf.st_size;
+    if (file_sz) {
+        buffer = mmap(NULL, file_sz, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (buffer == MAP_FAILED) {
+        qemu_log_mask(LAT_LOG_AOT, "aot file mmap error\n");
         goto exit_aot_load;
     }
-    if (!strstr(aot_version, AOT_VERSION)) {
+    if (!aot_header_valid(buffer, file_sz)) {
         qemu_log_mask(LAT_LOG_AOT, "aot file is not complete %s\n", lib_name);
         remove_curr_aot_file();
         goto exit_aot_load;
     }
-
-    /* Read aot file */
-    fseek(pf, 0, SEEK_SET);      /* seek back to beginning of file */
-    buffer = mmap(NULL, file_sz, PROT_READ, MAP_SHARED, fd, 0);
-    if (buffer <= 0) {
-        qemu_log_mask(LAT_LOG_AOT, "aot file mmap error\n");
-        goto exit_aot_load;
-    }
-    assert(buffer);
     aot_header *p_header = (aot_header *)buffer;
 
     /* Test original file state. */
@@ -1113,25 +1102,128 @@ lib_info *aot_load(char *lib_name)
         goto exit_aot_load;
     }
 
+    /*
+     * Segment, page and TB tables are walked on every lookup, fault them
+     * in now. Code pages are only touched when a TB is recovered.
+     */
+    madvise(buffer, p_header->rel_table_offset, MADV_WILLNEED);
+
     /* dump_aot_buffer(p_header); */
     aot_buffer = buffer;
     curr_lib_info = lib_tree_insert(lib_name, buffer);
 
 exit_aot_load:
-    if (likely(pf)) {
-        fclose(pf);
+    if (!curr_lib_info && buffer != MAP_FAILED) {
+        munmap(buffer, file_sz);
+    }
+    if (fd >= 0) {
+        close(fd);
     }
-    close(fd);
     flock_set(lockfd, F_UNLCK, true);
     close(lockfd);
+#ifdef CONFIG_LATX_PERF
+    latx_timer_stop(TIMER_AOT_LOAD);
+#endif
     return curr_lib_info;
 }
 
+static inline uint32_t aot_str_hash(const char *str, uint32_t h)
+{
+    /* FNV-1a */
+    while (*str) {
+        h = (h ^ (uint8_t)*str++) * 16777619u;
+    }
+    return h;
+}
+
+static inline uint32_t aot_version_hash(void)
+{
+    return aot_str_hash(AOT_VERSION, 2166136261u);
+}
+
+static inline uint32_t aot_seg_hash(const char *lib_name, uint32_t offset)
+{
+    uint32_t h = aot_str_hash(lib_name, 2166136261u);
+    return (h ^ offset) * 0x9e3779b1u;
+}
+
+/* Keep the index at most half full so probe chains stay short. */
+uint32_t aot_seg_index_size(int seg_num)
+{
+    return pow2ceil(MAX(seg_num, 1) * 2);
+}
+
+/*
+ * Build the segment index right after @table_end and record it in
+ * @p_header. Segments and their lib names must already be filled.
+ * Return the end address of the index.
+ */
+uintptr_t aot_build_seg_index(aot_header *p_header, aot_segment *p_segments,
+        uintptr_t table_end)
+{
+    uint32_t *index = (uint32_t *)ROUND_UP(table_end, 8);
+    uint32_t size = aot_seg_index_size(p_header->segments_num);
+    uint32_t mask = size - 1;
+    memset(index, 0, size * sizeof(uint32_t));
+    for (int i = 0; i < p_header->segments_num; i++) {
+        char *lib_name = (char *)p_header + p_segments[i].lib_name_offset;
+        uint32_t h = aot_seg_hash(lib_name,
+                        (uint32_t)p_segments[i].details.file_offset) & mask;
+        while (index[h]) {
+            h = (h + 1) & mask;
+        }
+        index[h] = i + 1;
+    }
+    p_header->seg_index_offset = (uintptr_t)index - (uintptr_t)p_header;
+    p_header->seg_index_size = size;
+    return (uintptr_t)(index + size);
+}
+
+void aot_seal_header(aot_header *p_header, size_t file_size)
+{
+    p_header->magic = AOT_MAGIC;
+    p_header->version_hash = aot_version_hash();
+    p_header->file_size = file_size;
+}
+
+/*
+ * Check a mapped aot file before trusting anything in it. A stale
+ * LATX build is rejected by the header alone, a torn write by the size
+ * and the trailing AOT_VERSION.
+ */
+bool aot_header_valid(const void *buffer, size_t file_sz)
+{
+    const aot_header *p_header = buffer;
+    size_t version_len = strlen(AOT_VERSION);
+    if (file_sz < sizeof(aot_header) + version_len
+            || p_header->magic != AOT_MAGIC
+            || p_header->version_hash != aot_version_hash()
+            || p_header->file_size != file_sz) {
+        return false;
+    }
+    return !memcmp(buffer + file_sz - version_len, AOT_VERSION, version_len);
+}
+
 struct aot_segment *aot_find_segment(char *path, int offset)
 {
     struct aot_header *p_header = (struct aot_header *)aot_buffer;
     struct aot_segment *p_segment =
         (struct aot_segment *)(aot_buffer + p_header->segment_table_offset);
+    if (p_header->seg_index_size) {
+        uint32_t *index = (uint32_t *)(aot_buffer + p_header->seg_index_offset);
+        uint32_t mask = p_header->seg_index_size - 1;
+        for (uint32_t h = aot_seg_hash(path, (uint32_t)offset) & mask;
+                index[h]; h = (h + 1) & mask) {
+            struct aot_segment *seg = &p_segment[index[h] - 1];
+            char *lib_name = (char *)(aot_buffer + seg->lib_name_offset);
+            if (seg->segment_tbs_num &&
+                    (int)seg->details.file_offset == offset &&
+                    strcmp(path, lib_name) == 0) {
+                return seg;
+            }
+        }
+        return NULL;
+    }
     for (int i = 0; i < p_header->segments_num; i++) {
         if (p_segment[i].segment_tbs_num == 0) {
             continue;
@@ -1199,9 +1291,8 @@ void aot_do_tb_reloc(TranslationBlock *tb, struct aot_tb *stb,
     int lib_method_index;
     CPUArchState* env = (CPUArchState*)(lsenv->cpu_state);
     target_ulong base = env->segs[R_CS].base;
-    uint32_t parallel = tb->cflags & CF_PARALLEL;
     ADDR loacl_indirect_jmp_glue = indirect_jmp_glue;
-    if (close_latx_parallel || parallel) {
+    if (!latx_fast_jmp_cache_enabled(tb->cflags)) {
         loacl_indirect_jmp_glue = parallel_indirect_jmp_glue;
     }
 
@@ -1514,6 +1605,11 @@ void aot_exit_entry(CPUState *cpu, int is_end)
     int signum = SIGCHLD;
     struct sigaction old_sa;
 
+    /* No file backed code was translated, the child would find nothing. */
+    if (get_segment_num() == 0) {
+        goto parent_exit;
+    }
+
     /* Get sigset. */
     if (sigprocmask(0, NULL, &sigset) < 0) {
 	qemu_log_mask(LAT_LOG_AOT, "get sigprocmask error\n");
@@ -1547,8 +1643,20 @@ void aot_exit_entry(CPUState *cpu, int is_end)
         }
     }
 
+    /*
+     * The AOT child only reads TB metadata from tb_gen_buffer and rebuilds
+     * its code cache from scratch in pre_translate. Let it start from an
+     * empty code cache, so fork neither copies the page tables of the
+     * parent code cache nor leaves the parent COW faulting on every code
+     * page it writes while the child is alive. Only this fork may wipe
+     * it: a guest fork must keep the code its TBs point into.
+     */
+    qemu_madvise(tcg_ctx->code_gen_buffer, tcg_ctx->code_gen_buffer_size,
+                 QEMU_MADV_WIPEONFORK);
     pid_t pid = fork();
     if (pid) {
+        qemu_madvise(tcg_ctx->code_gen_buffer, tcg_ctx->code_gen_buffer_size,
+                     QEMU_MADV_KEEPONFORK);
         if (pid > 0) {
             wait(NULL);
             if (old_sa.sa_handler != SIG_DFL) {
@@ -346,6 +346,7 @@ static struct aot_header *get_aot_buffer(
         sizeof(struct aot_segment) * curr_lib_seg_num + /* AOT segment table size */
         sizeof(struct page_table_info) * page_count + /* AOT page table */
         PATH_MAX * curr_lib_seg_num +                   /* AOT segment name size */
+        sizeof(uint32_t) * aot_seg_index_size(curr_lib_seg_num) + /* segment index */
         sizeof(struct aot_tb) * aot_tb_num +            /* AOT tb table size */
         sizeof(struct aot_rel) * merge_rel_entry_num +/* AOT rel table size */
         256;                                      /* extra alignment bytes. */
@@ -461,9 +462,11 @@ static void merge_aot_generate(void)
     }
 
     init_page_table(p_segments, p_header, seg_info_num);
+    uintptr_t seg_index_end =
+        aot_build_seg_index(p_header, p_segments, (uintptr_t)curr_name);
 
     struct aot_tb *p_aot_tbs =
-        (struct aot_tb *)ROUND_UP((uintptr_t)curr_name, 8);
+        (struct aot_tb *)ROUND_UP(seg_index_end, 8);
 
     struct aot_segment *curr_seg = p_segments;
     struct aot_tb *curr_aot_tb = p_aot_tbs;
@@ -538,6 +541,8 @@ static void merge_aot_generate(void)
         goto out;
     }
     size_t write_size = (uintptr_t)p_insn - (uintptr_t)p_header;
+    aot_seal_header(p_header,
+            write_size + total_code_cache_size + strlen(AOT_VERSION));
     if (fwrite(p_header, write_size, 1, pfile) != 1) {
         qemu_log_mask(LAT_LOG_AOT, "Error! write aot metadata failed!\n");
         fclose(pfile);
@@ -642,7 +647,6 @@ static int aot_load_no_lock(char *lib_name)
     struct stat statbuf;
     int count = aot_get_file_init(aot_file_path);
     size_t total_file_sz = 0;
-    char aot_version[strlen(AOT_VERSION) + 1];
     lsassert(count > 0);
     char tmp_file_path[PATH_MAX];
     if (lstat(aot_file_path, &statbuf)) {
@@ -660,27 +664,6 @@ static int aot_load_no_lock(char *lib_name)
         /* Get file size */
         fseek(pf, 0, SEEK_END);      /* seek to end of file */
         size_t file_sz = ftell(pf);  /* get current file pointer */
-        /*check aot complete.*/
-        if (fseek(pf, -strlen(AOT_VERSION), SEEK_END) != 0) {
-            aot_buffer_all_num--;
-            fclose(pf);
-            continue;
-        }
-        if (fread(aot_version, strlen(AOT_VERSION), 1, pf) != 1) {
-            aot_buffer_all_num--;
-            fclose(pf);
-            continue;
-        }
-        if (!strstr(aot_version, AOT_VERSION)) {
-            fclose(pf);
-            for (int ii = i; ii < count; ii++) {
-                aot_get_file_name(aot_file_path, tmp_file_path, ii);
-                remove(tmp_file_path);
-            }
-            aot_buffer_all_num = j;
-            return 0;
-        }
-
         fseek(pf, 0, SEEK_SET);      /* seek back to beginning of file */
 
         /* Read aot file */
@@ -698,6 +681,17 @@ static int aot_load_no_lock(char *lib_name)
             fclose(pf);
             continue;
         }
+        /*check aot complete.*/
+        if (!aot_header_valid(buffer, file_sz)) {
+            free(buffer);
+            fclose(pf);
+            for (int ii = i; ii < count; ii++) {
+                aot_get_file_name(aot_file_path, tmp_file_path, ii);
+                remove(tmp_file_path);
+            }
+            aot_buffer_all_num = j;
+            return 0;
+        }
         fclose(pf);
         aot_buffer_all[j].p = buffer;
         j++;
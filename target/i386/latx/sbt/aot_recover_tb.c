@@ -41,6 +41,7 @@ inline static TranslationBlock *creat_tb(aot_tb *p_aot_tb, abi_ulong start,
     tb->jmp_list_head = 0;
     tb->icount = p_aot_tb->icount;
     tb->jmp_indirect = p_aot_tb->jmp_indirect;
+    tb->jmp_indirect_jirl = p_aot_tb->jmp_indirect_jirl;
     tb->tc.size = p_aot_tb->tb_cache_size;
     tb->tc.ptr = tc_ptr; 
     tb->pc = start + p_aot_tb->offset_in_segment;
@@ -55,6 +56,8 @@ inline static TranslationBlock *creat_tb(aot_tb *p_aot_tb, abi_ulong start,
     tb->first_jmp_align = p_aot_tb->first_jmp_align;
     tb->bool_flags = p_aot_tb->bool_flags;
     tb->return_target_ptr = NULL;
+    tb->jrra_pin = NULL;
+    tb->indirect_ic = NULL;
 
 #if defined(CONFIG_LATX_JRRA) || defined(CONFIG_LATX_JRRA_STACK)
     if (p_aot_tb->return_target_ptr_offset) {
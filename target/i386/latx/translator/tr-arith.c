@@ -291,7 +291,7 @@ bool translate_add(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -373,7 +373,7 @@ bool translate_adc(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -438,7 +438,7 @@ bool translate_inc(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -515,7 +515,7 @@ bool translate_dec(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -593,7 +593,7 @@ bool translate_sub(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -691,7 +691,7 @@ bool translate_sbb(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -755,7 +755,7 @@ bool translate_neg(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -1622,7 +1622,7 @@ bool translate_xadd(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
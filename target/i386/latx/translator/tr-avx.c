@@ -0,0 +1,1109 @@
+#include "common.h"
+#include "reg-alloc.h"
+#include "latx-options.h"
+#include "translate.h"
+
+/*
+ * VEX encoded AVX/AVX2 insns on LASX. An xmm register is mapped to a
+ * 256-bit LASX register whose high 128 bits hold the high half of the ymm
+ * register. A VEX.128 insn zeroes that half, a VEX.256 insn works on the
+ * full register with the xv* form of the LSX insn of its SSE sibling. The
+ * AVX2 integer insns work on each 128-bit lane, like LASX does.
+ */
+
+#ifdef CONFIG_LATX_AVX
+static bool avx_is_256(IR1_INST *pir1)
+{
+    for (int i = 0; i < ir1_get_opnd_num(pir1); i++) {
+        IR1_OPND *opnd = ir1_get_opnd(pir1, i);
+        if (ir1_opnd_is_ymm(opnd) ||
+            (ir1_opnd_is_mem(opnd) && ir1_opnd_size(opnd) == 256)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static IR2_OPND avx_dest(IR1_INST *pir1)
+{
+    return ra_alloc_xmm(ir1_opnd_base_reg_num(ir1_get_opnd(pir1, 0)));
+}
+
+static IR2_OPND avx_load(IR1_OPND *opnd, bool is_256)
+{
+    return is_256 ? load_freg256_from_ir1(opnd) : load_freg128_from_ir1(opnd);
+}
+
+/*
+ * dest = src1 op src2, the VEX.128 form zeroes the high half. _REV passes
+ * the sources swapped, for the insns LA defines the other way round.
+ */
+#define AVX_BINARY(name, op, s1, s2)                                        \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src1 = avx_load(ir1_get_opnd(pir1, 1), is_256);                \
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 2), is_256);                \
+    if (is_256) {                                                           \
+        la_xv##op(dest, s1, s2);                                            \
+    } else {                                                                \
+        la_v##op(dest, s1, s2);                                             \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+#define AVX_BINARY_OP(name, op)     AVX_BINARY(name, op, src1, src2)
+#define AVX_BINARY_REV(name, op)    AVX_BINARY(name, op, src2, src1)
+
+/* fp */
+AVX_BINARY_OP(vaddps, fadd_s)
+AVX_BINARY_OP(vaddpd, fadd_d)
+AVX_BINARY_OP(vsubps, fsub_s)
+AVX_BINARY_OP(vsubpd, fsub_d)
+AVX_BINARY_OP(vmulps, fmul_s)
+AVX_BINARY_OP(vmulpd, fmul_d)
+AVX_BINARY_OP(vdivps, fdiv_s)
+AVX_BINARY_OP(vdivpd, fdiv_d)
+AVX_BINARY_OP(vandps, and_v)
+AVX_BINARY_OP(vandpd, and_v)
+AVX_BINARY_OP(vandnps, andn_v)
+AVX_BINARY_OP(vandnpd, andn_v)
+AVX_BINARY_OP(vorps, or_v)
+AVX_BINARY_OP(vorpd, or_v)
+AVX_BINARY_OP(vxorps, xor_v)
+AVX_BINARY_OP(vxorpd, xor_v)
+AVX_BINARY_REV(vunpcklps, ilvl_w)
+AVX_BINARY_REV(vunpcklpd, ilvl_d)
+AVX_BINARY_REV(vunpckhps, ilvh_w)
+AVX_BINARY_REV(vunpckhpd, ilvh_d)
+
+/* integer */
+AVX_BINARY_OP(vpaddb, add_b)
+AVX_BINARY_OP(vpaddw, add_h)
+AVX_BINARY_OP(vpaddd, add_w)
+AVX_BINARY_OP(vpaddq, add_d)
+AVX_BINARY_OP(vpsubb, sub_b)
+AVX_BINARY_OP(vpsubw, sub_h)
+AVX_BINARY_OP(vpsubd, sub_w)
+AVX_BINARY_OP(vpsubq, sub_d)
+AVX_BINARY_OP(vpaddsb, sadd_b)
+AVX_BINARY_OP(vpaddsw, sadd_h)
+AVX_BINARY_OP(vpaddusb, sadd_bu)
+AVX_BINARY_OP(vpaddusw, sadd_hu)
+AVX_BINARY_OP(vpsubsb, ssub_b)
+AVX_BINARY_OP(vpsubsw, ssub_h)
+AVX_BINARY_OP(vpsubusb, ssub_bu)
+AVX_BINARY_OP(vpsubusw, ssub_hu)
+AVX_BINARY_OP(vpand, and_v)
+AVX_BINARY_OP(vpandn, andn_v)
+AVX_BINARY_OP(vpor, or_v)
+AVX_BINARY_OP(vpxor, xor_v)
+AVX_BINARY_OP(vpcmpeqb, seq_b)
+AVX_BINARY_OP(vpcmpeqw, seq_h)
+AVX_BINARY_OP(vpcmpeqd, seq_w)
+AVX_BINARY_OP(vpcmpeqq, seq_d)
+AVX_BINARY_REV(vpcmpgtb, slt_b)
+AVX_BINARY_REV(vpcmpgtw, slt_h)
+AVX_BINARY_REV(vpcmpgtd, slt_w)
+AVX_BINARY_REV(vpcmpgtq, slt_d)
+AVX_BINARY_OP(vpmaxsb, max_b)
+AVX_BINARY_OP(vpmaxsw, max_h)
+AVX_BINARY_OP(vpmaxsd, max_w)
+AVX_BINARY_OP(vpmaxub, max_bu)
+AVX_BINARY_OP(vpmaxuw, max_hu)
+AVX_BINARY_OP(vpmaxud, max_wu)
+AVX_BINARY_OP(vpminsb, min_b)
+AVX_BINARY_OP(vpminsw, min_h)
+AVX_BINARY_OP(vpminsd, min_w)
+AVX_BINARY_OP(vpminub, min_bu)
+AVX_BINARY_OP(vpminuw, min_hu)
+AVX_BINARY_OP(vpminud, min_wu)
+AVX_BINARY_OP(vpavgb, avgr_bu)
+AVX_BINARY_OP(vpavgw, avgr_hu)
+AVX_BINARY_OP(vpmullw, mul_h)
+AVX_BINARY_OP(vpmulld, mul_w)
+AVX_BINARY_OP(vpmulhw, muh_h)
+AVX_BINARY_OP(vpmulhuw, muh_hu)
+AVX_BINARY_OP(vpmuldq, mulwev_d_w)
+AVX_BINARY_OP(vpmuludq, mulwev_d_wu)
+AVX_BINARY_REV(vpunpcklbw, ilvl_b)
+AVX_BINARY_REV(vpunpcklwd, ilvl_h)
+AVX_BINARY_REV(vpunpckldq, ilvl_w)
+AVX_BINARY_REV(vpunpcklqdq, ilvl_d)
+AVX_BINARY_REV(vpunpckhbw, ilvh_b)
+AVX_BINARY_REV(vpunpckhwd, ilvh_h)
+AVX_BINARY_REV(vpunpckhdq, ilvh_w)
+AVX_BINARY_REV(vpunpckhqdq, ilvh_d)
+
+/*
+ * As MAXPS/MINPS: src2 is taken if the compare with cond is true, which
+ * covers NaNs and equal zeros.
+ */
+#define AVX_FMINMAX(name, sz, s1, s2)                                       \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src1 = avx_load(ir1_get_opnd(pir1, 1), is_256);                \
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 2), is_256);                \
+    IR2_OPND mask = ra_alloc_ftemp();                                       \
+    if (is_256) {                                                           \
+        la_xvfcmp_cond_##sz(mask, s1, s2, 0xF);                             \
+        la_xvbitsel_v(dest, src1, src2, mask);                              \
+    } else {                                                                \
+        la_vfcmp_cond_##sz(mask, s1, s2, 0xF);                              \
+        la_vbitsel_v(dest, src1, src2, mask);                               \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_FMINMAX(vmaxps, s, src1, src2)
+AVX_FMINMAX(vmaxpd, d, src1, src2)
+AVX_FMINMAX(vminps, s, src2, src1)
+AVX_FMINMAX(vminpd, d, src2, src1)
+
+/* dest = op(src) */
+#define AVX_UNARY(name, op)                                                 \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    if (is_256) {                                                           \
+        la_xv##op(dest, src);                                               \
+    } else {                                                                \
+        la_v##op(dest, src);                                                \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_UNARY(vsqrtps, fsqrt_s)
+AVX_UNARY(vsqrtpd, fsqrt_d)
+AVX_UNARY(vcvtdq2ps, ffint_s_w)
+
+/*
+ * Scalar fp: dest = { src1[0] op src2[0], src1[127:size] }, the high half
+ * of dest is zeroed.
+ */
+#define AVX_SCALAR(name, op, sz, insve)                                     \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src1 = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));           \
+    IR2_OPND src2 = load_freg128_from_ir1(ir1_get_opnd(pir1, 2));           \
+    IR2_OPND temp = ra_alloc_ftemp();                                       \
+    IR2_OPND res = ra_alloc_ftemp();                                        \
+    la_f##op##_##sz(temp, src1, src2);                                      \
+    la_xvori_b(res, src1, 0);                                               \
+    la_xvinsve0_##insve(res, temp, 0);                                      \
+    set_high128_xreg_to_zero(res);                                          \
+    la_xvori_b(dest, res, 0);                                               \
+    return true;                                                            \
+}
+
+AVX_SCALAR(vaddss, add, s, w)
+AVX_SCALAR(vaddsd, add, d, d)
+AVX_SCALAR(vsubss, sub, s, w)
+AVX_SCALAR(vsubsd, sub, d, d)
+AVX_SCALAR(vmulss, mul, s, w)
+AVX_SCALAR(vmulsd, mul, d, d)
+AVX_SCALAR(vdivss, div, s, w)
+AVX_SCALAR(vdivsd, div, d, d)
+
+bool translate_vsqrtss(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src1 = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));
+    IR2_OPND src2 = load_freg128_from_ir1(ir1_get_opnd(pir1, 2));
+    IR2_OPND temp = ra_alloc_ftemp();
+    IR2_OPND res = ra_alloc_ftemp();
+    la_fsqrt_s(temp, src2);
+    la_xvori_b(res, src1, 0);
+    la_xvinsve0_w(res, temp, 0);
+    set_high128_xreg_to_zero(res);
+    la_xvori_b(dest, res, 0);
+    return true;
+}
+
+bool translate_vsqrtsd(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src1 = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));
+    IR2_OPND src2 = load_freg128_from_ir1(ir1_get_opnd(pir1, 2));
+    IR2_OPND temp = ra_alloc_ftemp();
+    IR2_OPND res = ra_alloc_ftemp();
+    la_fsqrt_d(temp, src2);
+    la_xvori_b(res, src1, 0);
+    la_xvinsve0_d(res, temp, 0);
+    set_high128_xreg_to_zero(res);
+    la_xvori_b(dest, res, 0);
+    return true;
+}
+
+/* shifts, a count above the element width shifts out everything */
+#define AVX_SHIFT(name, op, sz, bits, arith)                                \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    IR1_OPND *count = ir1_get_opnd(pir1, 2);                                \
+    if (ir1_opnd_is_imm(count)) {                                           \
+        uint8_t imm = ir1_opnd_uimm(count);                                 \
+        if (imm >= bits && !arith) {                                        \
+            la_xvxor_v(dest, dest, dest);                                   \
+            return true;                                                    \
+        }                                                                   \
+        imm = MIN(imm, bits - 1);                                           \
+        if (is_256) {                                                       \
+            la_xv##op##i_##sz(dest, src, imm);                              \
+        } else {                                                            \
+            la_v##op##i_##sz(dest, src, imm);                               \
+            set_high128_xreg_to_zero(dest);                                 \
+        }                                                                   \
+        return true;                                                        \
+    }                                                                       \
+    IR2_OPND cnt = load_freg128_from_ir1(count);                            \
+    IR2_OPND temp = ra_alloc_ftemp();                                       \
+    IR2_OPND mask = ra_alloc_ftemp();                                       \
+    la_xvreplve0_d(temp, cnt);                                              \
+    la_xvldi(mask, VLDI_IMM_TYPE0(3, bits - 1));                            \
+    if (arith) {                                                            \
+        la_xvmin_du(temp, temp, mask);                                      \
+    } else {                                                                \
+        la_xvsle_du(mask, temp, mask);                                      \
+    }                                                                       \
+    la_xvreplve0_##sz(temp, temp);                                          \
+    la_xv##op##_##sz(dest, src, temp);                                      \
+    if (!arith) {                                                           \
+        la_xvand_v(dest, dest, mask);                                       \
+    }                                                                       \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_SHIFT(vpsllw, sll, h, 16, false)
+AVX_SHIFT(vpslld, sll, w, 32, false)
+AVX_SHIFT(vpsllq, sll, d, 64, false)
+AVX_SHIFT(vpsrlw, srl, h, 16, false)
+AVX_SHIFT(vpsrld, srl, w, 32, false)
+AVX_SHIFT(vpsrlq, srl, d, 64, false)
+AVX_SHIFT(vpsraw, sra, h, 16, true)
+AVX_SHIFT(vpsrad, sra, w, 32, true)
+
+/* per element shift counts of AVX2 */
+#define AVX_SHIFTV(name, op, sz, mode, bits, arith)                         \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    IR2_OPND cnt = avx_load(ir1_get_opnd(pir1, 2), is_256);                 \
+    IR2_OPND temp = ra_alloc_ftemp();                                       \
+    IR2_OPND mask = ra_alloc_ftemp();                                       \
+    la_xvldi(mask, VLDI_IMM_TYPE0(mode, bits - 1));                         \
+    if (arith) {                                                            \
+        la_xvmin_##sz##u(temp, cnt, mask);                                  \
+        la_xv##op##_##sz(dest, src, temp);                                  \
+    } else {                                                                \
+        la_xvsle_##sz##u(mask, cnt, mask);                                  \
+        la_xv##op##_##sz(dest, src, cnt);                                   \
+        la_xvand_v(dest, dest, mask);                                       \
+    }                                                                       \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_SHIFTV(vpsllvd, sll, w, 2, 32, false)
+AVX_SHIFTV(vpsllvq, sll, d, 3, 64, false)
+AVX_SHIFTV(vpsrlvd, srl, w, 2, 32, false)
+AVX_SHIFTV(vpsrlvq, srl, d, 3, 64, false)
+AVX_SHIFTV(vpsravd, sra, w, 2, 32, true)
+
+/* byte shifts of each 128-bit lane */
+#define AVX_BSHIFT(name, op)                                                \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    uint8_t imm = ir1_opnd_uimm(ir1_get_opnd(pir1, 2));                     \
+    if (imm > 15) {                                                         \
+        la_xvxor_v(dest, dest, dest);                                       \
+        return true;                                                        \
+    }                                                                       \
+    la_xv##op(dest, src, imm);                                              \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_BSHIFT(vpslldq, bsll_v)
+AVX_BSHIFT(vpsrldq, bsrl_v)
+
+/* moves */
+static bool translate_avx_mov(IR1_INST *pir1)
+{
+    IR1_OPND *dest = ir1_get_opnd(pir1, 0);
+    IR1_OPND *src = ir1_get_opnd(pir1, 1);
+    bool is_256 = avx_is_256(pir1);
+
+    if (ir1_opnd_is_mem(dest)) {
+        IR2_OPND src_ir2 = ra_alloc_xmm(ir1_opnd_base_reg_num(src));
+        if (is_256) {
+            store_freg256_to_ir1_mem(src_ir2, dest);
+        } else {
+            store_freg128_to_ir1_mem(src_ir2, dest);
+        }
+        return true;
+    }
+
+    IR2_OPND dest_ir2 = avx_dest(pir1);
+    if (ir1_opnd_is_mem(src)) {
+        if (is_256) {
+            load_freg256_from_ir1_mem(dest_ir2, src);
+        } else {
+            load_freg128_from_ir1_mem(dest_ir2, src);
+            set_high128_xreg_to_zero(dest_ir2);
+        }
+    } else {
+        IR2_OPND src_ir2 = ra_alloc_xmm(ir1_opnd_base_reg_num(src));
+        if (is_256) {
+            la_xvori_b(dest_ir2, src_ir2, 0);
+        } else {
+            la_vori_b(dest_ir2, src_ir2, 0);
+            set_high128_xreg_to_zero(dest_ir2);
+        }
+    }
+    return true;
+}
+
+bool translate_vmovaps(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovapd(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovups(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovupd(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovdqa(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovdqu(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vlddqu(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovntdqa(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovntdq(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovntps(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+bool translate_vmovntpd(IR1_INST *pir1) { return translate_avx_mov(pir1); }
+
+/* VMOVD/VMOVQ are MOVD/MOVQ, the high half of an xmm dest is zeroed */
+bool translate_vmovd(IR1_INST *pir1)
+{
+    translate_movd(pir1);
+    if (ir1_opnd_is_xmm(ir1_get_opnd(pir1, 0))) {
+        set_high128_xreg_to_zero(avx_dest(pir1));
+    }
+    return true;
+}
+
+bool translate_vmovq(IR1_INST *pir1)
+{
+    translate_movq(pir1);
+    if (ir1_opnd_is_xmm(ir1_get_opnd(pir1, 0))) {
+        set_high128_xreg_to_zero(avx_dest(pir1));
+    }
+    return true;
+}
+
+/*
+ * The load and store forms are MOVSS/MOVSD, the register form merges the
+ * scalar of src2 into src1.
+ */
+#define AVX_MOVS(name, sse, insve)                                          \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    if (ir1_get_opnd_num(pir1) == 2) {                                      \
+        translate_##sse(pir1);                                              \
+        if (ir1_opnd_is_xmm(ir1_get_opnd(pir1, 0))) {                       \
+            set_high128_xreg_to_zero(avx_dest(pir1));                       \
+        }                                                                   \
+        return true;                                                        \
+    }                                                                       \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src1 = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));           \
+    IR2_OPND src2 = load_freg128_from_ir1(ir1_get_opnd(pir1, 2));           \
+    IR2_OPND res = ra_alloc_ftemp();                                        \
+    la_xvori_b(res, src1, 0);                                               \
+    la_xvinsve0_##insve(res, src2, 0);                                      \
+    set_high128_xreg_to_zero(res);                                          \
+    la_xvori_b(dest, res, 0);                                               \
+    return true;                                                            \
+}
+
+AVX_MOVS(vmovss, movss, w)
+AVX_MOVS(vmovsd, movsd, d)
+
+/* broadcasts */
+#define AVX_BROADCAST(name, sz)                                             \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = ir1_opnd_is_ymm(ir1_get_opnd(pir1, 0));                   \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));            \
+    la_xvreplve0_##sz(dest, src);                                           \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_BROADCAST(vpbroadcastb, b)
+AVX_BROADCAST(vpbroadcastw, h)
+AVX_BROADCAST(vpbroadcastd, w)
+AVX_BROADCAST(vpbroadcastq, d)
+AVX_BROADCAST(vbroadcastss, w)
+AVX_BROADCAST(vbroadcastsd, d)
+AVX_BROADCAST(vbroadcastf128, q)
+AVX_BROADCAST(vbroadcasti128, q)
+
+/* 128-bit lanes */
+static bool translate_avx_insert128(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src1 = ra_alloc_xmm(ir1_opnd_base_reg_num(ir1_get_opnd(pir1, 1)));
+    IR2_OPND src2 = load_freg128_from_ir1(ir1_get_opnd(pir1, 2));
+    uint8_t imm = ir1_opnd_uimm(ir1_get_opnd(pir1, 3));
+    IR2_OPND res = ra_alloc_ftemp();
+
+    la_xvori_b(res, src1, 0);
+    /* the selected lane of res gets the low lane of src2 */
+    la_xvpermi_q(res, src2, (imm & 1) ? 0x02 : 0x30);
+    la_xvori_b(dest, res, 0);
+    return true;
+}
+
+bool translate_vinsertf128(IR1_INST *pir1)
+{
+    return translate_avx_insert128(pir1);
+}
+
+bool translate_vinserti128(IR1_INST *pir1)
+{
+    return translate_avx_insert128(pir1);
+}
+
+static bool translate_avx_extract128(IR1_INST *pir1)
+{
+    IR1_OPND *dest = ir1_get_opnd(pir1, 0);
+    IR2_OPND src = ra_alloc_xmm(ir1_opnd_base_reg_num(ir1_get_opnd(pir1, 1)));
+    uint8_t imm = ir1_opnd_uimm(ir1_get_opnd(pir1, 2));
+    IR2_OPND lane = src;
+
+    if (imm & 1) {
+        lane = ra_alloc_ftemp();
+        la_xvpermi_d(lane, src, 0xee);
+    }
+    if (ir1_opnd_is_mem(dest)) {
+        store_freg128_to_ir1_mem(lane, dest);
+    } else {
+        IR2_OPND dest_ir2 = avx_dest(pir1);
+        la_xvori_b(dest_ir2, lane, 0);
+        set_high128_xreg_to_zero(dest_ir2);
+    }
+    return true;
+}
+
+bool translate_vextractf128(IR1_INST *pir1)
+{
+    return translate_avx_extract128(pir1);
+}
+
+bool translate_vextracti128(IR1_INST *pir1)
+{
+    return translate_avx_extract128(pir1);
+}
+
+/*
+ * The lane selectors of VPERM2I128 pick from {src1, src2} like the ones
+ * of xvpermi.q pick from {xj, xd}, so src2 is copied to the result first.
+ */
+static bool translate_avx_perm2x128(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src1 = ra_alloc_xmm(ir1_opnd_base_reg_num(ir1_get_opnd(pir1, 1)));
+    IR2_OPND src2 = load_freg256_from_ir1(ir1_get_opnd(pir1, 2));
+    uint8_t imm = ir1_opnd_uimm(ir1_get_opnd(pir1, 3));
+    IR2_OPND res = ra_alloc_ftemp();
+
+    la_xvori_b(res, src2, 0);
+    la_xvpermi_q(res, src1, imm & 0x33);
+    if (imm & 0x08) {
+        la_xvinsgr2vr_d(res, zero_ir2_opnd, 0);
+        la_xvinsgr2vr_d(res, zero_ir2_opnd, 1);
+    }
+    if (imm & 0x80) {
+        set_high128_xreg_to_zero(res);
+    }
+    la_xvori_b(dest, res, 0);
+    return true;
+}
+
+bool translate_vperm2f128(IR1_INST *pir1)
+{
+    return translate_avx_perm2x128(pir1);
+}
+
+bool translate_vperm2i128(IR1_INST *pir1)
+{
+    return translate_avx_perm2x128(pir1);
+}
+
+/* xvpermi.d has the qword selectors of VPERMQ */
+bool translate_vpermq(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src = load_freg256_from_ir1(ir1_get_opnd(pir1, 1));
+    la_xvpermi_d(dest, src, ir1_opnd_uimm(ir1_get_opnd(pir1, 2)));
+    return true;
+}
+
+bool translate_vpermpd(IR1_INST *pir1)
+{
+    return translate_vpermq(pir1);
+}
+
+/* xvperm.w takes the dword indexes in its last operand */
+bool translate_vpermd(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND idx = load_freg256_from_ir1(ir1_get_opnd(pir1, 1));
+    IR2_OPND src = load_freg256_from_ir1(ir1_get_opnd(pir1, 2));
+    la_xvperm_w(dest, src, idx);
+    return true;
+}
+
+bool translate_vpermps(IR1_INST *pir1)
+{
+    return translate_vpermd(pir1);
+}
+
+/* shuffles within each 128-bit lane */
+bool translate_vpshufd(IR1_INST *pir1)
+{
+    bool is_256 = avx_is_256(pir1);
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);
+    la_xvshuf4i_w(dest, src, ir1_opnd_uimm(ir1_get_opnd(pir1, 2)));
+    if (!is_256) {
+        set_high128_xreg_to_zero(dest);
+    }
+    return true;
+}
+
+/* shuffle the words of both qwords, then keep the other qword of src */
+#define AVX_PSHUFXW(name, keep)                                             \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    IR2_OPND temp = ra_alloc_ftemp();                                       \
+    la_xvshuf4i_h(temp, src, ir1_opnd_uimm(ir1_get_opnd(pir1, 2)));         \
+    la_xvori_b(dest, src, 0);                                               \
+    la_xvextrins_d(dest, temp, keep);                                       \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_PSHUFXW(vpshuflw, 0x00)
+AVX_PSHUFXW(vpshufhw, 0x11)
+
+bool translate_vshufps(IR1_INST *pir1)
+{
+    bool is_256 = avx_is_256(pir1);
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src1 = avx_load(ir1_get_opnd(pir1, 1), is_256);
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 2), is_256);
+    uint8_t imm8 = ir1_opnd_uimm(ir1_get_opnd(pir1, 3));
+    IR2_OPND temp1 = ra_alloc_ftemp();
+    IR2_OPND temp2 = ra_alloc_ftemp();
+
+    la_xvshuf4i_w(temp1, src1, imm8);
+    la_xvshuf4i_w(temp2, src2, imm8 >> 4);
+    la_xvpickev_d(dest, temp2, temp1);
+    if (!is_256) {
+        set_high128_xreg_to_zero(dest);
+    }
+    return true;
+}
+
+/* as PSHUFB, an index with bit 7 set picks a byte of zero */
+bool translate_vpshufb(IR1_INST *pir1)
+{
+    bool is_256 = avx_is_256(pir1);
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);
+    IR2_OPND idx = avx_load(ir1_get_opnd(pir1, 2), is_256);
+    IR2_OPND vzero = ra_alloc_ftemp();
+    IR2_OPND idx_t1 = ra_alloc_ftemp();
+    IR2_OPND idx_t2 = ra_alloc_ftemp();
+
+    la_xvxor_v(vzero, vzero, vzero);
+    la_xvandi_b(idx_t2, idx, 0xf);
+    la_xvandi_b(idx_t1, idx, 0x80);
+    la_xvsrli_b(idx_t1, idx_t1, 3);
+    la_xvadd_b(idx_t1, idx_t2, idx_t1);
+    la_xvshuf_b(dest, vzero, src, idx_t1);
+    if (!is_256) {
+        set_high128_xreg_to_zero(dest);
+    }
+    return true;
+}
+
+/* abs(x) as |x - 0| like PABSB */
+#define AVX_PABS(name, sz)                                                  \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    IR2_OPND vzero = ra_alloc_ftemp();                                      \
+    la_xvxor_v(vzero, vzero, vzero);                                        \
+    la_xvabsd_##sz(dest, src, vzero);                                       \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_PABS(vpabsb, b)
+AVX_PABS(vpabsw, h)
+AVX_PABS(vpabsd, w)
+
+/* variable blends select by the sign of each element of the mask */
+#define AVX_BLENDV(name, sz)                                                \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src1 = avx_load(ir1_get_opnd(pir1, 1), is_256);                \
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 2), is_256);                \
+    IR2_OPND mask = avx_load(ir1_get_opnd(pir1, 3), is_256);                \
+    IR2_OPND temp = ra_alloc_ftemp();                                       \
+    la_xvslti_##sz(temp, mask, 0);                                          \
+    la_xvbitsel_v(dest, src1, src2, temp);                                  \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_BLENDV(vpblendvb, b)
+AVX_BLENDV(vblendvps, w)
+AVX_BLENDV(vblendvpd, d)
+
+/*
+ * Sign masks: xvmskltz leaves the mask of each lane in the low qword of
+ * the lane, the one of the high lane goes above the one of the low lane.
+ */
+#define AVX_MOVMSK(name, sz, lo, hi)                                        \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);                                \
+    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);                                \
+    IR2_OPND dest = ra_alloc_gpr(ir1_opnd_base_reg_num(opnd0));             \
+    IR2_OPND src = ra_alloc_xmm(ir1_opnd_base_reg_num(opnd1));              \
+    IR2_OPND ftemp = ra_alloc_ftemp();                                      \
+    if (!avx_is_256(pir1)) {                                                \
+        la_vmskltz_##sz(ftemp, src);                                        \
+        la_movfr2gr_d(dest, ftemp);                                         \
+        return true;                                                        \
+    }                                                                       \
+    IR2_OPND itemp = ra_alloc_itemp();                                      \
+    la_xvmskltz_##sz(ftemp, src);                                           \
+    la_xvpickve2gr_wu(itemp, ftemp, 4);                                     \
+    la_xvpickve2gr_wu(dest, ftemp, 0);                                      \
+    la_bstrins_d(dest, itemp, hi, lo);                                      \
+    ra_free_temp(itemp);                                                    \
+    return true;                                                            \
+}
+
+AVX_MOVMSK(vpmovmskb, b, 16, 31)
+AVX_MOVMSK(vmovmskps, w, 4, 7)
+AVX_MOVMSK(vmovmskpd, d, 2, 3)
+
+/* as PTEST on the full width */
+bool translate_vptest(IR1_INST *pir1)
+{
+    bool is_256 = avx_is_256(pir1);
+    IR2_OPND src1 = avx_load(ir1_get_opnd(pir1, 0), is_256);
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 1), is_256);
+    IR2_OPND temp = ra_alloc_ftemp();
+    IR2_OPND label_1 = ra_alloc_label();
+    IR2_OPND label_2 = ra_alloc_label();
+    IR2_OPND n4095_opnd = ra_alloc_num_4095();
+
+    la_x86mtflag(zero_ir2_opnd, 0x3f);
+    if (is_256) {
+        la_xvand_v(temp, src2, src1);
+        la_xvseteqz_v(fcc0_ir2_opnd, temp);
+    } else {
+        la_vand_v(temp, src2, src1);
+        la_vseteqz_v(fcc0_ir2_opnd, temp);
+    }
+    la_bceqz(fcc0_ir2_opnd, label_1);
+    la_x86mtflag(n4095_opnd, ZF_USEDEF_BIT);
+
+    la_label(label_1);
+    if (is_256) {
+        la_xvandn_v(temp, src1, src2);
+        la_xvseteqz_v(fcc0_ir2_opnd, temp);
+    } else {
+        la_vandn_v(temp, src1, src2);
+        la_vseteqz_v(fcc0_ir2_opnd, temp);
+    }
+    la_bceqz(fcc0_ir2_opnd, label_2);
+    la_x86mtflag(n4095_opnd, CF_USEDEF_BIT);
+    la_label(label_2);
+
+    ra_free_num_4095(n4095_opnd);
+    return true;
+}
+
+/* VZEROUPPER moves the low lane of zero into the high lane of each reg */
+bool translate_vzeroupper(IR1_INST *pir1)
+{
+    IR2_OPND vzero = ra_alloc_ftemp();
+
+    la_xvxor_v(vzero, vzero, vzero);
+    for (int i = 0; i < CPU_NB_REGS; i++) {
+        la_xvpermi_q(ra_alloc_xmm(i), vzero, 0x02);
+    }
+    return true;
+}
+
+bool translate_vzeroall(IR1_INST *pir1)
+{
+    for (int i = 0; i < CPU_NB_REGS; i++) {
+        IR2_OPND xmm = ra_alloc_xmm(i);
+        la_xvxor_v(xmm, xmm, xmm);
+    }
+    return true;
+}
+
+/*
+ * The VEX.128 forms whose operands are the ones of the SSE insn, which
+ * then only needs the high half of an xmm dest zeroed. None of them has a
+ * VEX.256 form: vcomis* ignore VEX.L and vpextr* #UD on it.
+ */
+#define AVX_AS_SSE(name, sse)                                               \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    lsassert(!avx_is_256(pir1));                                            \
+    translate_##sse(pir1);                                                  \
+    if (ir1_opnd_is_xmm(ir1_get_opnd(pir1, 0))) {                           \
+        set_high128_xreg_to_zero(avx_dest(pir1));                           \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_AS_SSE(vucomiss, ucomiss)
+AVX_AS_SSE(vucomisd, ucomisd)
+AVX_AS_SSE(vcomiss, comiss)
+AVX_AS_SSE(vcomisd, comisd)
+AVX_AS_SSE(vpextrb, pextrb)
+AVX_AS_SSE(vpextrw, pextrw)
+AVX_AS_SSE(vpextrd, pextrd)
+AVX_AS_SSE(vpextrq, pextrq)
+
+/*
+ * LA saturates a positive overflow and turns NaN into 0 where x86 gives the
+ * integer indefinite 0x80000000. A negative overflow saturates to it
+ * already, so only the lanes not below 2^31 or unordered are patched.
+ */
+static void avx_cvtps2dq_256(IR1_INST *pir1)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src = load_freg256_from_ir1(ir1_get_opnd(pir1, 1));
+    IR2_OPND res = ra_alloc_ftemp();
+    IR2_OPND mask = ra_alloc_ftemp();
+    IR2_OPND splat = ra_alloc_ftemp();
+    IR2_OPND itemp = ra_alloc_itemp();
+
+    la_xvftint_w_s(res, src);
+    li_wu(itemp, 0x4f000000);
+    la_xvreplgr2vr_w(splat, itemp);
+    la_xvfcmp_cond_s(mask, splat, src, FCMP_COND_CULE);
+    li_wu(itemp, 0x80000000);
+    la_xvreplgr2vr_w(splat, itemp);
+    la_xvbitsel_v(dest, res, splat, mask);
+    ra_free_temp(itemp);
+}
+
+bool translate_vcvtps2dq(IR1_INST *pir1)
+{
+    if (avx_is_256(pir1)) {
+        avx_cvtps2dq_256(pir1);
+        return true;
+    }
+    translate_cvtps2dq(pir1);
+    set_high128_xreg_to_zero(avx_dest(pir1));
+    return true;
+}
+
+/* the even/odd lanes of each 128-bit half, VEX.256 included */
+#define AVX_DUP(name, op)                                                   \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    bool is_256 = avx_is_256(pir1);                                         \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = avx_load(ir1_get_opnd(pir1, 1), is_256);                 \
+    la_xv##op(dest, src, src);                                              \
+    if (!is_256) {                                                          \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_DUP(vmovshdup, packod_w)
+AVX_DUP(vmovsldup, packev_w)
+AVX_DUP(vmovddup, packev_d)
+
+/* vext2xv widens the low elements of the source over the whole xreg */
+#define AVX_PMOVX(name, ext)                                                \
+bool translate_##name(IR1_INST *pir1)                                       \
+{                                                                           \
+    IR2_OPND dest = avx_dest(pir1);                                         \
+    IR2_OPND src = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));            \
+    la_vext2xv_##ext(dest, src);                                            \
+    if (!avx_is_256(pir1)) {                                                \
+        set_high128_xreg_to_zero(dest);                                     \
+    }                                                                       \
+    return true;                                                            \
+}
+
+AVX_PMOVX(vpmovzxbw, hu_bu)
+AVX_PMOVX(vpmovzxbd, wu_bu)
+AVX_PMOVX(vpmovzxbq, du_bu)
+AVX_PMOVX(vpmovzxwd, wu_hu)
+AVX_PMOVX(vpmovzxwq, du_hu)
+AVX_PMOVX(vpmovzxdq, du_wu)
+AVX_PMOVX(vpmovsxbw, h_b)
+AVX_PMOVX(vpmovsxbd, w_b)
+AVX_PMOVX(vpmovsxbq, d_b)
+AVX_PMOVX(vpmovsxwd, w_h)
+AVX_PMOVX(vpmovsxwq, d_h)
+AVX_PMOVX(vpmovsxdq, d_w)
+
+/*
+ * FMA3: the digits give which of dest, src2 and src3 are the two factors
+ * and the addend, 213 is dest = src2 * dest + src3. VFNM* negate the
+ * product by negating one factor, which keeps the sign of an exact zero
+ * result the way x86 rounds it. Rounding and exception flags are the ones
+ * of the fcsr, like the other fp insns.
+ */
+static void avx_fma_order(int form, IR2_OPND d, IR2_OPND b, IR2_OPND c,
+                          IR2_OPND *mul1, IR2_OPND *mul2, IR2_OPND *add)
+{
+    switch (form) {
+    case 132:
+        *mul1 = d; *mul2 = c; *add = b;
+        break;
+    case 213:
+        *mul1 = b; *mul2 = d; *add = c;
+        break;
+    case 231:
+        *mul1 = b; *mul2 = c; *add = d;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static bool avx_fma_packed(IR1_INST *pir1, int form, bool is_sub,
+                           bool is_neg, bool is_d)
+{
+    bool is_256 = avx_is_256(pir1);
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 1), is_256);
+    IR2_OPND src3 = avx_load(ir1_get_opnd(pir1, 2), is_256);
+    IR2_OPND mul1, mul2, add;
+
+    avx_fma_order(form, dest, src2, src3, &mul1, &mul2, &add);
+    if (is_neg) {
+        IR2_OPND temp = ra_alloc_ftemp();
+        if (is_d) {
+            la_xvbitrevi_d(temp, mul1, 63);
+        } else {
+            la_xvbitrevi_w(temp, mul1, 31);
+        }
+        mul1 = temp;
+    }
+
+    if (is_256) {
+        if (is_d) {
+            if (is_sub) {
+                la_xvfmsub_d(dest, mul1, mul2, add);
+            } else {
+                la_xvfmadd_d(dest, mul1, mul2, add);
+            }
+        } else {
+            if (is_sub) {
+                la_xvfmsub_s(dest, mul1, mul2, add);
+            } else {
+                la_xvfmadd_s(dest, mul1, mul2, add);
+            }
+        }
+    } else {
+        if (is_d) {
+            if (is_sub) {
+                la_vfmsub_d(dest, mul1, mul2, add);
+            } else {
+                la_vfmadd_d(dest, mul1, mul2, add);
+            }
+        } else {
+            if (is_sub) {
+                la_vfmsub_s(dest, mul1, mul2, add);
+            } else {
+                la_vfmadd_s(dest, mul1, mul2, add);
+            }
+        }
+        set_high128_xreg_to_zero(dest);
+    }
+    return true;
+}
+
+/* the scalar forms keep dest[127:size] */
+static bool avx_fma_scalar(IR1_INST *pir1, int form, bool is_sub,
+                           bool is_neg, bool is_d)
+{
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src2 = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));
+    IR2_OPND src3 = load_freg128_from_ir1(ir1_get_opnd(pir1, 2));
+    IR2_OPND res = ra_alloc_ftemp();
+    IR2_OPND mul1, mul2, add;
+
+    avx_fma_order(form, dest, src2, src3, &mul1, &mul2, &add);
+    if (is_neg) {
+        IR2_OPND temp = ra_alloc_ftemp();
+        if (is_d) {
+            la_fneg_d(temp, mul1);
+        } else {
+            la_fneg_s(temp, mul1);
+        }
+        mul1 = temp;
+    }
+
+    if (is_d) {
+        if (is_sub) {
+            la_fmsub_d(res, mul1, mul2, add);
+        } else {
+            la_fmadd_d(res, mul1, mul2, add);
+        }
+        la_xvinsve0_d(dest, res, 0);
+    } else {
+        if (is_sub) {
+            la_fmsub_s(res, mul1, mul2, add);
+        } else {
+            la_fmadd_s(res, mul1, mul2, add);
+        }
+        la_xvinsve0_w(dest, res, 0);
+    }
+    set_high128_xreg_to_zero(dest);
+    return true;
+}
+
+#define AVX_FMA(op, form, is_sub, is_neg)                                   \
+bool translate_v##op##form##ps(IR1_INST *pir1)                              \
+{                                                                           \
+    return avx_fma_packed(pir1, form, is_sub, is_neg, false);               \
+}                                                                           \
+bool translate_v##op##form##pd(IR1_INST *pir1)                              \
+{                                                                           \
+    return avx_fma_packed(pir1, form, is_sub, is_neg, true);                \
+}                                                                           \
+bool translate_v##op##form##ss(IR1_INST *pir1)                              \
+{                                                                           \
+    return avx_fma_scalar(pir1, form, is_sub, is_neg, false);               \
+}                                                                           \
+bool translate_v##op##form##sd(IR1_INST *pir1)                              \
+{                                                                           \
+    return avx_fma_scalar(pir1, form, is_sub, is_neg, true);                \
+}
+
+AVX_FMA(fmadd, 132, false, false)
+AVX_FMA(fmadd, 213, false, false)
+AVX_FMA(fmadd, 231, false, false)
+AVX_FMA(fmsub, 132, true, false)
+AVX_FMA(fmsub, 213, true, false)
+AVX_FMA(fmsub, 231, true, false)
+AVX_FMA(fnmadd, 132, false, true)
+AVX_FMA(fnmadd, 213, false, true)
+AVX_FMA(fnmadd, 231, false, true)
+AVX_FMA(fnmsub, 132, true, true)
+AVX_FMA(fnmsub, 213, true, true)
+AVX_FMA(fnmsub, 231, true, true)
+
+/*
+ * VFMADDSUB subtracts in the even lanes and adds in the odd ones, VFMSUBADD
+ * the other way round. Negate the addend in the subtracting lanes and do a
+ * single fmadd, so each lane is rounded once and raises only its own flags.
+ */
+static bool avx_fma_alt(IR1_INST *pir1, int form, bool sub_even, bool is_d)
+{
+    bool is_256 = avx_is_256(pir1);
+    IR2_OPND dest = avx_dest(pir1);
+    IR2_OPND src2 = avx_load(ir1_get_opnd(pir1, 1), is_256);
+    IR2_OPND src3 = avx_load(ir1_get_opnd(pir1, 2), is_256);
+    IR2_OPND addend = ra_alloc_ftemp();
+    IR2_OPND mul1, mul2, add;
+
+    avx_fma_order(form, dest, src2, src3, &mul1, &mul2, &add);
+    /* flip the sign of every lane, then copy back the adding lanes */
+    if (is_d) {
+        la_xvbitrevi_d(addend, add, 63);
+        la_xvextrins_d(addend, add, sub_even ? 0x11 : 0x00);
+    } else {
+        la_xvbitrevi_w(addend, add, 31);
+        la_xvextrins_w(addend, add, sub_even ? 0x11 : 0x00);
+        la_xvextrins_w(addend, add, sub_even ? 0x33 : 0x22);
+    }
+
+    if (is_256) {
+        if (is_d) {
+            la_xvfmadd_d(dest, mul1, mul2, addend);
+        } else {
+            la_xvfmadd_s(dest, mul1, mul2, addend);
+        }
+    } else {
+        if (is_d) {
+            la_vfmadd_d(dest, mul1, mul2, addend);
+        } else {
+            la_vfmadd_s(dest, mul1, mul2, addend);
+        }
+        set_high128_xreg_to_zero(dest);
+    }
+    return true;
+}
+
+#define AVX_FMA_ALT(op, form, sub_even)                                     \
+bool translate_v##op##form##ps(IR1_INST *pir1)                              \
+{                                                                           \
+    return avx_fma_alt(pir1, form, sub_even, false);                        \
+}                                                                           \
+bool translate_v##op##form##pd(IR1_INST *pir1)                              \
+{                                                                           \
+    return avx_fma_alt(pir1, form, sub_even, true);                         \
+}
+
+AVX_FMA_ALT(fmaddsub, 132, true)
+AVX_FMA_ALT(fmaddsub, 213, true)
+AVX_FMA_ALT(fmaddsub, 231, true)
+AVX_FMA_ALT(fmsubadd, 132, false)
+AVX_FMA_ALT(fmsubadd, 213, false)
+AVX_FMA_ALT(fmsubadd, 231, false)
+#endif
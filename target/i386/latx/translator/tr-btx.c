@@ -168,7 +168,7 @@ bool translate_btx(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
     /*
@@ -18,7 +18,7 @@ bool translate_xor(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -163,7 +163,7 @@ bool translate_and(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -285,7 +285,7 @@ bool translate_or(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -372,7 +372,7 @@ bool translate_not(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -79,7 +79,7 @@ static void tr_generate_exit_tb_for_bridge(void)
     if (!qemu_loglevel_mask(CPU_LOG_TB_NOCHAIN)) {
         CPUArchState* env = (CPUArchState*)(lsenv->cpu_state);
         CPUState *cpu = env_cpu(env);
-        if (!(cpu->tcg_cflags & CF_PARALLEL)) {
+        if (latx_fast_jmp_cache_enabled(tr_cflags(cpu))) {
             la_data_li(target, indirect_jmp_glue);
         } else {
             la_data_li(target, parallel_indirect_jmp_glue);
@@ -288,27 +288,76 @@ bool translate_out(IR1_INST *pir1)
     return true;
 }
 
-bool translate_prefetch(IR1_INST *pir1) { return true; }
-bool translate_prefetchnta(IR1_INST *pir1) { return true; }
-// bool translate_prefetcht0(IR1_INST *pir1) { return true; }
-bool translate_prefetcht1(IR1_INST *pir1) { return true; }
-bool translate_prefetcht2(IR1_INST *pir1) { return true; }
+/*
+ * preld hint 0 prefetches for load and 8 for store, into the L1 cache.
+ * Other hints are no-ops on current cores, so T1/T2 and NTA use the load
+ * hint as well: there is no level or streaming preld to map them to.
+ */
+#define PRELD_LOAD  0
+#define PRELD_STORE 8
+
+static void tr_prefetch(IR1_INST *pir1, int hint)
+{
+    if (!option_prefetch) {
+        return;
+    }
+    int offset;
+    IR2_OPND mem_opnd = convert_mem(ir1_get_opnd(pir1, 0), &offset);
+    la_preld(hint, mem_opnd, offset);
+}
+
+bool translate_prefetch(IR1_INST *pir1)
+{
+    tr_prefetch(pir1, PRELD_LOAD);
+    return true;
+}
+
+bool translate_prefetchnta(IR1_INST *pir1)
+{
+    tr_prefetch(pir1, PRELD_LOAD);
+    return true;
+}
+
+bool translate_prefetcht0(IR1_INST *pir1)
+{
+    tr_prefetch(pir1, PRELD_LOAD);
+    return true;
+}
+
+bool translate_prefetcht1(IR1_INST *pir1)
+{
+    tr_prefetch(pir1, PRELD_LOAD);
+    return true;
+}
+
+bool translate_prefetcht2(IR1_INST *pir1)
+{
+    tr_prefetch(pir1, PRELD_LOAD);
+    return true;
+}
+
+bool translate_prefetchw(IR1_INST *pir1)
+{
+    tr_prefetch(pir1, PRELD_STORE);
+    return true;
+}
 
+/* x86 keeps loads in order already, lfence also holds back later stores */
 bool translate_lfence(IR1_INST *pir1)
 {
-    la_dbar(0);
+    tr_fence(DBAR_ACQUIRE);
     return true;
 }
 
 bool translate_mfence(IR1_INST *pir1)
 {
-    la_dbar(0);
+    tr_fence(DBAR_SYNC);
     return true;
 }
 
 bool translate_sfence(IR1_INST *pir1)
 {
-    la_dbar(0);
+    tr_fence(DBAR_WMB);
     return true;
 }
 
@@ -1721,35 +1770,6 @@ bool translate_frstor(IR1_INST *pir1)
     return true;
 }
 
-bool translate_prefetcht0(IR1_INST *pir1)
-{
-    int offset;
-    IR2_OPND mem_opnd = convert_mem(ir1_get_opnd(pir1, 0), &offset);
-    /* if the value of zero_imm_opnd is 0, it is load.
-     * if the value of zero_imm_opnd is 8, it is store.
-     * if the value of zero_imm_opnd is others, it is invalid.
-     */
-    int imm = 0;
-
-    la_preld(imm, mem_opnd, offset);
-    return true;
-}
-
-bool translate_prefetchw(IR1_INST *pir1)
-{
-    int offset;
-    IR2_OPND mem_opnd = convert_mem(ir1_get_opnd(pir1, 0), &offset);
-    /*
-     * if the value of zero_imm_opnd is 0, it is load.
-     * if the value of zero_imm_opnd is 8, it is store.
-     * if the value of zero_imm_opnd is others, it is invalid.
-     */
-    int imm = 8;
-
-    la_preld(imm, mem_opnd, offset);
-    return true;
-}
-
 /*  Set the x87 FPU tag word to empty: x87FPUTagWord ← FFFFH */
 bool translate_emms(IR1_INST *pir1)
 {
@@ -498,6 +498,224 @@ static void load_step_to_reg_ir1(IR2_OPND *p_step_opnd, IR1_OPND *opnd_ir1)
     ra_free_temp(tmp_step);
 }
 
+#ifdef TARGET_X86_64
+/*
+ * Bulk path of the REP string insns: when DF is clear and enough elements
+ * are left, whole chunks are handled with LSX and ESI/EDI/ECX are updated
+ * once per chunk. A fault inside a chunk restarts the insn at the chunk
+ * start, so a chunk must never read bytes it writes itself.
+ */
+#define REP_BULK_BYTES 32
+#define REP_SCAN_BYTES 16
+
+static bool rep_bulk_ok(IR1_INST *pir1, IR1_OPND *mem_si, IR1_OPND *mem_di)
+{
+    if (!option_rep_bulk || option_mem_test || ir1_prefix(pir1) == 0 ||
+        pir1->info->x86.prefix[3] == 0x67) {
+        return false;
+    }
+    /* FS/GS based operands need the segment base */
+    IR1_OPND *mem[2] = {mem_si, mem_di};
+    for (int i = 0; i < 2; ++i) {
+        if (mem[i] && ir1_opnd_has_seg(mem[i]) &&
+            (mem[i]->mem.segment == dt_X86_REG_FS ||
+             mem[i]->mem.segment == dt_X86_REG_GS)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void rep_bulk_replicate(IR2_OPND vec_opnd, IR2_OPND value_opnd,
+                               int bytes, bool lasx)
+{
+    if (lasx) {
+        switch (bytes) {
+        case 1:
+            la_xvreplgr2vr_b(vec_opnd, value_opnd);
+            break;
+        case 2:
+            la_xvreplgr2vr_h(vec_opnd, value_opnd);
+            break;
+        case 4:
+            la_xvreplgr2vr_w(vec_opnd, value_opnd);
+            break;
+        case 8:
+            la_xvreplgr2vr_d(vec_opnd, value_opnd);
+            break;
+        default:
+            lsassert(0);
+        }
+        return;
+    }
+    switch (bytes) {
+    case 1:
+        la_vreplgr2vr_b(vec_opnd, value_opnd);
+        break;
+    case 2:
+        la_vreplgr2vr_h(vec_opnd, value_opnd);
+        break;
+    case 4:
+        la_vreplgr2vr_w(vec_opnd, value_opnd);
+        break;
+    case 8:
+        la_vreplgr2vr_d(vec_opnd, value_opnd);
+        break;
+    default:
+        lsassert(0);
+    }
+}
+
+/*
+ * REP MOVS/STOS: copy or fill REP_BULK_BYTES per iteration until less than
+ * a chunk is left, then continue at label_scalar. For MOVS (esi_opnd valid)
+ * the distance between EDI and ESI must be at least one chunk; a chunk of
+ * an overlapping copy would read bytes it stored, which neither matches the
+ * element order of x86 nor survives a restart.
+ */
+static void tr_rep_bulk(IR2_OPND *esi_opnd, IR2_OPND edi_opnd,
+                        IR2_OPND ecx_opnd, IR2_OPND *value_opnd, int bytes,
+                        IR2_OPND label_scalar, IR2_OPND label_end)
+{
+    int elems = REP_BULK_BYTES / bytes;
+    bool lasx = option_enable_lasx;
+    IR2_OPND tmp = ra_alloc_itemp();
+    IR2_OPND eflags_opnd = ra_alloc_eflags();
+
+    la_andi(tmp, eflags_opnd, 0x400);
+    la_bne(tmp, zero_ir2_opnd, label_scalar);
+    if (esi_opnd) {
+        /* scalar when EDI - ESI is in (-REP_BULK_BYTES, REP_BULK_BYTES) */
+        la_sub_d(tmp, edi_opnd, *esi_opnd);
+        la_addi_d(tmp, tmp, REP_BULK_BYTES - 1);
+        la_sltui(tmp, tmp, 2 * REP_BULK_BYTES - 1);
+        la_bne(tmp, zero_ir2_opnd, label_scalar);
+    }
+
+    IR2_OPND data_lo = ra_alloc_ftemp();
+    IR2_OPND data_hi = ra_alloc_ftemp();
+    if (value_opnd) {
+        rep_bulk_replicate(data_lo, *value_opnd, bytes, lasx);
+    }
+
+    IR2_OPND label_bulk = ra_alloc_label();
+    la_label(label_bulk);
+    la_sltui(tmp, ecx_opnd, elems);
+    la_bne(tmp, zero_ir2_opnd, label_scalar);
+
+    if (lasx) {
+        if (esi_opnd) {
+            la_xvld(data_lo, *esi_opnd, 0);
+        }
+        la_xvst(data_lo, edi_opnd, 0);
+    } else if (esi_opnd) {
+        la_vld(data_lo, *esi_opnd, 0);
+        la_vld(data_hi, *esi_opnd, 16);
+        la_vst(data_lo, edi_opnd, 0);
+        la_vst(data_hi, edi_opnd, 16);
+    } else {
+        la_vst(data_lo, edi_opnd, 0);
+        la_vst(data_lo, edi_opnd, 16);
+    }
+
+    if (esi_opnd) {
+        la_addi_d(*esi_opnd, *esi_opnd, REP_BULK_BYTES);
+    }
+    la_addi_d(edi_opnd, edi_opnd, REP_BULK_BYTES);
+    la_addi_d(ecx_opnd, ecx_opnd, -elems);
+    la_bne(ecx_opnd, zero_ir2_opnd, label_bulk);
+    la_b(label_end);
+
+    ra_free_temp(tmp);
+    ra_free_temp(data_lo);
+    ra_free_temp(data_hi);
+}
+
+/*
+ * REPE/REPNE CMPS/SCAS: skip REP_SCAN_BYTES chunks in which no element
+ * stops the loop, then go on with the scalar loop at label_scalar. This
+ * runs once per instruction, ahead of the scalar loop. At least one
+ * element is always left to the scalar loop, which computes the final
+ * eflags. The scalar loop also takes the rest from the first chunk that
+ * crosses a guest page, x86 may stop before touching the next page.
+ * cmp_vec holds the replicated AL/AX/EAX/RAX for SCAS.
+ */
+static void tr_rep_scan_bulk(IR1_INST *pir1, IR2_OPND *esi_opnd,
+                             IR2_OPND edi_opnd, IR2_OPND ecx_opnd,
+                             IR2_OPND step_opnd, IR2_OPND *cmp_vec, int bytes,
+                             IR2_OPND label_scalar)
+{
+    int elems = REP_SCAN_BYTES / bytes;
+    IR2_OPND tmp = ra_alloc_itemp();
+    IR2_OPND tmp2 = ra_alloc_itemp();
+    IR2_OPND label_bulk = ra_alloc_label();
+
+    /* step is -bytes when DF is clear */
+    la_addi_d(tmp, step_opnd, bytes);
+    la_bne(tmp, zero_ir2_opnd, label_scalar);
+    la_label(label_bulk);
+    la_sltui(tmp, ecx_opnd, elems + 1);
+    la_bne(tmp, zero_ir2_opnd, label_scalar);
+
+    la_addi_d(tmp, edi_opnd, REP_SCAN_BYTES - 1);
+    la_xor(tmp, tmp, edi_opnd);
+    if (esi_opnd) {
+        la_addi_d(tmp2, *esi_opnd, REP_SCAN_BYTES - 1);
+        la_xor(tmp2, tmp2, *esi_opnd);
+        la_or(tmp, tmp, tmp2);
+    }
+    la_srli_d(tmp, tmp, TARGET_PAGE_BITS);
+    la_bne(tmp, zero_ir2_opnd, label_scalar);
+
+    IR2_OPND data = ra_alloc_ftemp();
+    IR2_OPND other = cmp_vec ? *cmp_vec : ra_alloc_ftemp();
+    la_vld(data, edi_opnd, 0);
+    if (esi_opnd) {
+        la_vld(other, *esi_opnd, 0);
+    }
+    switch (bytes) {
+    case 1:
+        la_vseq_b(data, data, other);
+        break;
+    case 2:
+        la_vseq_h(data, data, other);
+        break;
+    case 4:
+        la_vseq_w(data, data, other);
+        break;
+    case 8:
+        la_vseq_d(data, data, other);
+        break;
+    default:
+        lsassert(0);
+    }
+    la_vmskltz_b(data, data);
+    la_vpickve2gr_hu(tmp, data, 0);
+    if (ir1_prefix(pir1) == dt_X86_PREFIX_REPE) {
+        /* every byte equal: 0xffff + 1 >> 16 is 1 */
+        la_addi_d(tmp, tmp, 1);
+        la_srli_d(tmp, tmp, 16);
+        la_beq(tmp, zero_ir2_opnd, label_scalar);
+    } else {
+        la_bne(tmp, zero_ir2_opnd, label_scalar);
+    }
+
+    if (esi_opnd) {
+        la_addi_d(*esi_opnd, *esi_opnd, REP_SCAN_BYTES);
+    }
+    la_addi_d(edi_opnd, edi_opnd, REP_SCAN_BYTES);
+    la_addi_d(ecx_opnd, ecx_opnd, -elems);
+    la_b(label_bulk);
+
+    ra_free_temp(tmp);
+    ra_free_temp(tmp2);
+    ra_free_temp(data);
+    if (!cmp_vec) {
+        ra_free_temp(other);
+    }
+}
+#endif
+
 bool translate_movs(IR1_INST *pir1)
 {
     IR2_OPND esi_opnd = ra_alloc_gpr(esi_index);
@@ -595,8 +813,17 @@ bool translate_movs(IR1_INST *pir1)
     IR2_OPND step_opnd = ra_alloc_itemp();
     load_step_to_reg_ir1(&step_opnd, mem_di);
 
-    /* 3. loop starts */
     IR2_OPND label_loop_begin = ra_alloc_label();
+    IR2_OPND label_loop_end = ra_alloc_label();
+#ifdef TARGET_X86_64
+    if (rep_bulk_ok(pir1, mem_si, mem_di)) {
+        tr_rep_bulk(&esi_opnd, edi_opnd, ecx_opnd, NULL,
+                    ir1_opnd_size(mem_di) >> 3, label_loop_begin,
+                    label_loop_end);
+    }
+#endif
+
+    /* 3. loop starts */
     la_label(label_loop_begin);
 
     /* 3.1 load memory value at ESI, and store into memory at EDI */
@@ -621,6 +848,7 @@ bool translate_movs(IR1_INST *pir1)
         la_addi_d(ecx_opnd, ecx_opnd, -1);
 #endif
         la_bne(ecx_opnd, zero_ir2_opnd, label_loop_begin);
+        la_label(label_loop_end);
         store_ireg_to_ir1(ecx_opnd, &ecx_ir1_opnd, false);
     }
 
@@ -752,8 +980,17 @@ bool translate_stos(IR1_INST *pir1)
     IR2_OPND step_opnd = ra_alloc_itemp();
     load_step_to_reg_ir1(&step_opnd, opnd_di);
 
-    /* 3. loop starts */
     IR2_OPND label_loop_begin = ra_alloc_label();
+    IR2_OPND label_loop_end = ra_alloc_label();
+#ifdef TARGET_X86_64
+    if (rep_bulk_ok(pir1, NULL, opnd_di)) {
+        tr_rep_bulk(NULL, edi_opnd, ecx_opnd, &eax_value_opnd,
+                    ir1_opnd_size(opnd_di) >> 3, label_loop_begin,
+                    label_loop_end);
+    }
+#endif
+
+    /* 3. loop starts */
     la_label(label_loop_begin);
 
     /* 3.1 store EAX into memory at EDI */
@@ -774,6 +1011,7 @@ bool translate_stos(IR1_INST *pir1)
         la_addi_d(ecx_opnd, ecx_opnd, -1);
 #endif
         la_bne(ecx_opnd, zero_ir2_opnd, label_loop_begin);
+        la_label(label_loop_end);
         store_ireg_to_ir1(ecx_opnd, &ecx_ir1_opnd, false);
     }
 
@@ -862,6 +1100,15 @@ bool translate_cmps(IR1_INST *pir1)
 
     /* 3. loop starts */
     IR2_OPND label_loop_begin = ra_alloc_label();
+#ifdef TARGET_X86_64
+    if (rep_bulk_ok(pir1, ir1_get_opnd(pir1, 0), ir1_get_opnd(pir1, 0) + 1)) {
+        IR2_OPND bulk_esi_opnd = ra_alloc_gpr(esi_index);
+        tr_rep_scan_bulk(pir1, &bulk_esi_opnd, ra_alloc_gpr(edi_index),
+                         ecx_opnd, step_opnd, NULL,
+                         ir1_opnd_size(ir1_get_opnd(pir1, 0)) >> 3,
+                         label_loop_begin);
+    }
+#endif
     la_label(label_loop_begin);
 
     /* 3.1 load memory value at ESI and EDI */
@@ -971,9 +1218,25 @@ bool translate_scas(IR1_INST *pir1)
         load_ireg_from_ir1(opnd_eax, SIGN_EXTENSION, false);
     IR2_OPND step_opnd = ra_alloc_itemp();
     load_step_to_reg(&step_opnd, pir1);
+#ifdef TARGET_X86_64
+    IR1_OPND *opnd_di = ir1_get_opnd(pir1, ir1_get_opnd_num(pir1) - 1);
+    bool bulk = rep_bulk_ok(pir1, NULL, opnd_di);
+    IR2_OPND eax_vec_opnd = ra_alloc_ftemp();
+    if (bulk) {
+        rep_bulk_replicate(eax_vec_opnd, eax_value_opnd,
+                           ir1_opnd_size(opnd_di) >> 3, false);
+    }
+#endif
 
     /* 3. loop starts */
     IR2_OPND label_loop_begin = ra_alloc_label();
+#ifdef TARGET_X86_64
+    if (bulk) {
+        tr_rep_scan_bulk(pir1, NULL, ra_alloc_gpr(edi_index), ecx_opnd,
+                         step_opnd, &eax_vec_opnd,
+                         ir1_opnd_size(opnd_di) >> 3, label_loop_begin);
+    }
+#endif
     la_label(label_loop_begin);
 
     /* 3.1 load memory value at EDI */
@@ -1051,6 +1314,9 @@ bool translate_scas(IR1_INST *pir1)
     ra_free_temp(step_opnd);
     ra_free_temp(edi_mem_value);
     ra_free_temp(cmp_result);
+#ifdef TARGET_X86_64
+    ra_free_temp(eax_vec_opnd);
+#endif
     return true;
 }
 
@@ -1204,7 +1470,7 @@ bool translate_xchg(IR1_INST *pir1)
         return true;
     }
 
-    if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
+    if (!close_latx_parallel && !(tr_cflags(cpu) & CF_PARALLEL)) {
         /* get src0 and src1*/
         src0 = load_ireg_from_ir1(opnd0, UNKNOWN_EXTENSION, false);
         src1 = load_ireg_from_ir1(opnd1, UNKNOWN_EXTENSION, false);
@@ -1361,7 +1627,7 @@ bool translate_cmpxchg(IR1_INST *pir1)
     CPUState *cpu = env_cpu(env);
     bool is_lock = ir1_is_prefix_lock(pir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
 
 #ifdef CONFIG_LATX_LLSC
@@ -1151,7 +1151,7 @@ IR2_OPND set_fpu_fcsr_rounding_field_by_x86(void)
 {
     CPUArchState* env = (CPUArchState*)(lsenv->cpu_state);
     CPUState *cpu = env_cpu(env);
-    if (!close_latx_parallel && !(cpu->tcg_cflags & CF_PARALLEL)) {
+    if (!close_latx_parallel && !(tr_cflags(cpu) & CF_PARALLEL)) {
         return zero_ir2_opnd;
     }
 
@@ -1183,7 +1183,7 @@ void set_fpu_rounding_mode(IR2_OPND rm)
     CPUState *cpu = env_cpu(env);
     if (close_latx_parallel) {
         la_movgr2fcsr(fcsr3_ir2_opnd, rm);
-    } else if (cpu->tcg_cflags & CF_PARALLEL) {
+    } else if (tr_cflags(cpu) & CF_PARALLEL) {
         la_movgr2fcsr(fcsr3_ir2_opnd, rm);
     }
 }
@@ -298,7 +298,7 @@ bool translate_sub_jcc(IR1_INST *ir1)
 
     bool is_lock = ir1_is_prefix_lock(ir1) && ir1_opnd_is_mem(opnd0);
     if (!close_latx_parallel) {
-        is_lock = is_lock && (cpu->tcg_cflags & CF_PARALLEL);
+        is_lock = is_lock && (tr_cflags(cpu) & CF_PARALLEL);
     }
     if (is_lock) {
         translate_sub(ir1);
@@ -3,26 +3,35 @@
 #include "latx-options.h"
 #include "translate.h"
 
+/*
+ * The message schedule insns map onto LSX word lanes. The rounds are a
+ * serial chain, so they run in GPRs on words picked out of the vectors.
+ * The dest is only written once every source word has been read, since
+ * the source may be the dest too.
+ */
+
+static IR2_OPND tr_sha_load_src(IR1_OPND *opnd1)
+{
+    lsassert(ir1_opnd_is_xmm(opnd1) || ir1_opnd_size(opnd1) == 128);
+    return load_freg128_from_ir1(opnd1);
+}
+
 bool translate_sha1nexte(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_sha1nexte, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_sha1nexte, d, d, s1);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND temp = ra_alloc_ftemp();
+
+    /* d = b, d[3] += rol(a[3], 30) */
+    la_vrotri_w(temp, dest, 2);
+    la_vadd_w(temp, temp, src);
+    la_vor_v(dest, src, src);
+    la_vextrins_w(dest, temp, 0x33);
+
+    ra_free_temp(temp);
+    ra_free_temp_auto(src);
     return true;
 }
 
@@ -30,22 +39,17 @@ bool translate_sha1msg1(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_sha1msg1, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_sha1msg1, d, d, s1);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND temp = ra_alloc_ftemp();
+
+    /* d = a ^ {b[2], b[3], a[0], a[1]} */
+    la_vbsll_v(temp, dest, 8);
+    la_vextrins_d(temp, src, 0x01);
+    la_vxor_v(dest, dest, temp);
+
+    ra_free_temp(temp);
+    ra_free_temp_auto(src);
     return true;
 }
 
@@ -53,118 +57,254 @@ bool translate_sha1msg2(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_sha1msg2, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_sha1msg2, d, d, s1);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND temp = ra_alloc_ftemp();
+    IR2_OPND d3 = ra_alloc_ftemp();
+
+    /* d[i] = rol(a[i] ^ b[i - 1], 1), with d[3] standing in for b[-1] */
+    la_vbsll_v(temp, src, 4);
+    la_vxor_v(temp, temp, dest);
+    la_vrotri_w(temp, temp, 31);
+    /* rol(a[0] ^ d[3], 1) = rol(a[0], 1) ^ rol(d[3], 1) */
+    la_vbsrl_v(d3, temp, 12);
+    la_vrotri_w(d3, d3, 31);
+    la_vxor_v(dest, temp, d3);
+
+    ra_free_temp(d3);
+    ra_free_temp(temp);
+    ra_free_temp_auto(src);
     return true;
 }
 
+/*
+ * Additive forms of the SHA-1 round functions: the two terms of ch and of
+ * maj never have a bit set in common, so they can be summed into the round
+ * value one at a time with a single scratch register.
+ */
+static void tr_sha1_f(IR2_OPND acc, IR2_OPND b, IR2_OPND c, IR2_OPND d,
+                      IR2_OPND temp, int f)
+{
+    switch (f) {
+    case 0:
+        /* (b & c) | (~b & d) */
+        la_and(temp, b, c);
+        la_add_w(acc, acc, temp);
+        la_andn(temp, d, b);
+        la_add_w(acc, acc, temp);
+        break;
+    case 2:
+        /* (b & c) | (d & (b ^ c)) */
+        la_and(temp, b, c);
+        la_add_w(acc, acc, temp);
+        la_xor(temp, b, c);
+        la_and(temp, temp, d);
+        la_add_w(acc, acc, temp);
+        break;
+    default:
+        /* b ^ c ^ d */
+        la_xor(temp, b, c);
+        la_xor(temp, temp, d);
+        la_add_w(acc, acc, temp);
+        break;
+    }
+}
+
 bool translate_sha1rnds4(IR1_INST *pir1)
 {
+    static const uint32_t k[4] = {
+        0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6
+    };
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND *opnd2 = ir1_get_opnd(pir1, 2);
-    int imm = ir1_opnd_uimm(opnd2);
-    int d = ir1_opnd_base_reg_num(opnd0);
-	ADDR helper_func;
-	switch (imm) {
-		case 0:
-			helper_func = (ADDR)helper_sha1rnds4_f0;
-			break;
-		case 1:
-			helper_func = (ADDR)helper_sha1rnds4_f1;
-			break;
-		case 2:
-			helper_func = (ADDR)helper_sha1rnds4_f2;
-			break;
-		case 3:
-			helper_func = (ADDR)helper_sha1rnds4_f3;
-			break;
-        default:
-            helper_func = 0xdeadbeaf;
-            lsassert(0);
-            break;
-	}
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_func, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-		/* DO NOT use XMM0 because this insns use it implicitly */
-        if (s1 == 0)
-            s1++;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_func, d, d, s1);
-        la_xvor_v(src, temp, temp);
+    int f = ir1_opnd_uimm(ir1_get_opnd(pir1, 2)) & 3;
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND wk = ra_alloc_ftemp();
+    IR2_OPND temp = ra_alloc_itemp();
+    /* state words A, B, C, D, E */
+    IR2_OPND st[5];
+    int i;
+
+    li_d(temp, k[f]);
+    la_vreplgr2vr_w(wk, temp);
+    la_vadd_w(wk, wk, src);
+    for (i = 0; i < 4; i++) {
+        st[i] = ra_alloc_itemp();
+        la_vpickve2gr_w(st[i], dest, 3 - i);
+    }
+
+    /*
+     * Each round sums into the register of E, which is dead afterwards,
+     * and renames the rest: E = D, D = C, C = rol(B, 30), B = A.
+     */
+    for (i = 0; i < 4; i++) {
+        IR2_OPND acc = i ? st[4] : ra_alloc_itemp();
+        la_vpickve2gr_w(temp, wk, 3 - i);
+        if (i) {
+            la_add_w(acc, acc, temp);
+        } else {
+            la_or(acc, temp, zero_ir2_opnd);
+        }
+        tr_sha1_f(acc, st[1], st[2], st[3], temp, f);
+        la_rotri_w(temp, st[0], 27);
+        la_add_w(acc, acc, temp);
+        la_rotri_w(st[1], st[1], 2);
+
+        st[4] = st[3];
+        st[3] = st[2];
+        st[2] = st[1];
+        st[1] = st[0];
+        st[0] = acc;
+    }
+
+    for (i = 0; i < 4; i++) {
+        la_vinsgr2vr_w(dest, st[i], 3 - i);
+    }
+
+    for (i = 0; i < 5; i++) {
+        ra_free_temp(st[i]);
     }
-    /* TODO: need to check */
+    ra_free_temp(temp);
+    ra_free_temp(wk);
+    ra_free_temp_auto(src);
     return true;
 }
 
+/* dest += ror(x, r0) ^ ror(x, r1) ^ ror(x, r2), folded as nested rotates */
+static void tr_sha256_sum(IR2_OPND dest, IR2_OPND x, IR2_OPND temp,
+                          int r0, int r1, int r2)
+{
+    la_rotri_w(temp, x, r2 - r1);
+    la_xor(temp, temp, x);
+    la_rotri_w(temp, temp, r1 - r0);
+    la_xor(temp, temp, x);
+    la_rotri_w(temp, temp, r0);
+    la_add_w(dest, dest, temp);
+}
+
+/* acc += ch(e, f, g) + sum1(e), ch as the sum of its disjoint terms */
+static void tr_sha256_ch_sum1(IR2_OPND acc, IR2_OPND e, IR2_OPND f,
+                              IR2_OPND g, IR2_OPND temp)
+{
+    la_and(temp, e, f);
+    la_add_w(acc, acc, temp);
+    la_andn(temp, g, e);
+    la_add_w(acc, acc, temp);
+    tr_sha256_sum(acc, e, temp, 6, 11, 25);
+}
+
+/* acc += maj(a, b, c) + sum0(a) */
+static void tr_sha256_maj_sum0(IR2_OPND acc, IR2_OPND a, IR2_OPND b,
+                               IR2_OPND c, IR2_OPND temp)
+{
+    la_and(temp, a, b);
+    la_add_w(acc, acc, temp);
+    la_xor(temp, a, b);
+    la_and(temp, temp, c);
+    la_add_w(acc, acc, temp);
+    tr_sha256_sum(acc, a, temp, 2, 13, 22);
+}
+
 bool translate_sha256rnds2(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_sha256rnds2_xmm0, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-		/* DO NOT use XMM0 because this insns use it implicitly */
-        if (s1 == 0)
-            s1++;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_sha256rnds2_xmm0, d, d, s1);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND xmm0 = ra_alloc_xmm(0);
+    IR2_OPND res = ra_alloc_ftemp();
+    IR2_OPND temp = ra_alloc_itemp();
+
+    /*
+     * A, B, E, F come from src and C, D, G, H from dest. The E half of
+     * both rounds goes first, so at most six GPRs are live at a time.
+     */
+    IR2_OPND e = ra_alloc_itemp();
+    IR2_OPND f = ra_alloc_itemp();
+    IR2_OPND g = ra_alloc_itemp();
+    IR2_OPND t0 = ra_alloc_itemp();
+    la_vpickve2gr_w(e, src, 1);
+    la_vpickve2gr_w(f, src, 0);
+    la_vpickve2gr_w(g, dest, 1);
+
+    /* even round: t0 = H + wk0 + ch(E, F, G) + sum1(E), EE = t0 + D */
+    la_vpickve2gr_w(t0, dest, 0);
+    la_vpickve2gr_w(temp, xmm0, 0);
+    la_add_w(t0, t0, temp);
+    tr_sha256_ch_sum1(t0, e, f, g, temp);
+    IR2_OPND ee = ra_alloc_itemp();
+    la_vpickve2gr_w(ee, dest, 2);
+    la_add_w(ee, ee, t0);
+    la_vinsgr2vr_w(res, ee, 0);
+
+    /* odd round: t1 = G + wk1 + ch(EE, E, F) + sum1(EE), summed into G */
+    IR2_OPND t1 = g;
+    la_vpickve2gr_w(temp, xmm0, 1);
+    la_add_w(t1, t1, temp);
+    tr_sha256_ch_sum1(t1, ee, e, f, temp);
+    ra_free_temp(ee);
+    ra_free_temp(f);
+
+    /* EE of the odd round = t1 + C */
+    IR2_OPND a = e;
+    IR2_OPND b = ra_alloc_itemp();
+    IR2_OPND c = ra_alloc_itemp();
+    la_vpickve2gr_w(c, dest, 3);
+    la_add_w(temp, t1, c);
+    la_vinsgr2vr_w(res, temp, 1);
+
+    /* AA = t0 + maj(A, B, C) + sum0(A), then the odd round on t1 */
+    la_vpickve2gr_w(a, src, 3);
+    la_vpickve2gr_w(b, src, 2);
+    tr_sha256_maj_sum0(t0, a, b, c, temp);
+    la_vinsgr2vr_w(res, t0, 2);
+    tr_sha256_maj_sum0(t1, t0, a, b, temp);
+    la_vinsgr2vr_w(res, t1, 3);
+    la_vor_v(dest, res, res);
+
+    ra_free_temp(c);
+    ra_free_temp(b);
+    ra_free_temp(a);
+    ra_free_temp(t1);
+    ra_free_temp(t0);
+    ra_free_temp(temp);
+    ra_free_temp(res);
+    ra_free_temp_auto(src);
     return true;
 }
 
+/* sigma(x) = ror(x, r0) ^ ror(x, r1) ^ (x >> sh) on each word */
+static void tr_sha256_sigma(IR2_OPND dest, IR2_OPND x, IR2_OPND temp,
+                            int r0, int r1, int sh)
+{
+    la_vrotri_w(dest, x, r0);
+    la_vrotri_w(temp, x, r1);
+    la_vxor_v(dest, dest, temp);
+    la_vsrli_w(temp, x, sh);
+    la_vxor_v(dest, dest, temp);
+}
+
 bool translate_sha256msg1(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_sha256msg1, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_sha256msg1, d, d, s1);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND w = ra_alloc_ftemp();
+    IR2_OPND s = ra_alloc_ftemp();
+    IR2_OPND temp = ra_alloc_ftemp();
+
+    /* d[i] = a[i] + sigma0(w[i]), w = {a[1], a[2], a[3], b[0]} */
+    la_vbsrl_v(w, dest, 4);
+    la_vextrins_w(w, src, 0x30);
+    tr_sha256_sigma(s, w, temp, 7, 18, 3);
+    la_vadd_w(dest, dest, s);
+
+    ra_free_temp(temp);
+    ra_free_temp(s);
+    ra_free_temp(w);
+    ra_free_temp_auto(src);
     return true;
 }
 
@@ -172,21 +312,29 @@ bool translate_sha256msg2(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_sha256msg2, d, d, s1);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_sha256msg2, d, d, s1);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = tr_sha_load_src(opnd1);
+    IR2_OPND w = ra_alloc_ftemp();
+    IR2_OPND s = ra_alloc_ftemp();
+    IR2_OPND temp = ra_alloc_ftemp();
+    IR2_OPND sigma = ra_alloc_ftemp();
+
+    /*
+     * d[0..1] = a[0..1] + sigma1(b[2..3]), then d[2..3] = a[2..3] +
+     * sigma1(d[0..1]). The lanes shifted in as zero have sigma1(0) = 0,
+     * so each step can add all four lanes.
+     */
+    la_vbsrl_v(w, src, 8);
+    tr_sha256_sigma(s, w, temp, 17, 19, 10);
+    la_vadd_w(w, dest, s);
+    la_vbsll_v(s, w, 8);
+    tr_sha256_sigma(sigma, s, temp, 17, 19, 10);
+    la_vadd_w(dest, w, sigma);
+
+    ra_free_temp(sigma);
+    ra_free_temp(temp);
+    ra_free_temp(s);
+    ra_free_temp(w);
+    ra_free_temp_auto(src);
     return true;
 }
@@ -3,6 +3,7 @@
 #include "latx-options.h"
 #include "translate.h"
 #include "hbr.h"
+#include "crypto/aes.h"
 
 bool translate_por(IR1_INST *pir1)
 {
@@ -3448,267 +3449,607 @@ bool translate_movbe(IR1_INST *pir1)
     return true;
 }
 
-bool translate_pcmpestri(IR1_INST *pir1)
+/*
+ * PCMPxSTRx is specialized on its control byte at translate time. Every
+ * element of B is compared against the elements of A selected by the
+ * aggregation mode, giving an all-ones/all-zeros element per match, and
+ * the masks of A and B element validity come from comparing an index
+ * vector with the string lengths.
+ */
+static const uint8_t pcmp_iota_b[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+static const uint16_t pcmp_iota_h[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+/* length of a zero-terminated string, n if there is no terminator */
+static void tr_pcmp_ilen(IR2_OPND len, IR2_OPND vec, bool is_word)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND *opnd2 = ir1_get_opnd(pir1, 2);
-    int imm = ir1_opnd_uimm(opnd2);
-#ifdef TARGET_X86_64
-    /* Presence of REX.W is indicated by bit 8*/
-    imm |= ir1_rex_w(pir1) << 8;
-#endif
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (ir1_opnd_is_xmm(opnd1)) {
-        int s = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpestri_xmm, d, s, imm);
+    IR2_OPND ftemp = ra_alloc_ftemp();
+    IR2_OPND temp = ra_alloc_itemp();
+    if (is_word) {
+        la_vseqi_h(ftemp, vec, 0);
+        la_vmskltz_h(ftemp, ftemp);
+        la_movfr2gr_s(len, ftemp);
+        la_ori(len, len, 1 << 8);
     } else {
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm((d + 1) % 8);
-        la_xvor_v(temp, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpestri_xmm, d, (d + 1) % 8, imm);
-        la_xvor_v(src, temp, temp);
+        la_vseqi_b(ftemp, vec, 0);
+        la_vmskltz_b(ftemp, ftemp);
+        la_movfr2gr_s(len, ftemp);
+        la_lu12i_w(temp, 1 << 4);
+        la_or(len, len, temp);
     }
-    /* TODO:fix eflags and mem opnd */
-    return true;
+    la_ctz_w(len, len);
+    ra_free_temp(temp);
+    ra_free_temp(ftemp);
 }
 
-bool translate_pcmpestrm(IR1_INST *pir1)
+/* explicit length in a gpr: |len| saturated to n */
+static void tr_pcmp_elen(IR2_OPND len, int gpr_num, bool rex_w, bool is_word)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND *opnd2 = ir1_get_opnd(pir1, 2);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    int imm = ir1_opnd_uimm(opnd2);
-#ifdef TARGET_X86_64
-    /* Presence of REX.W is indicated by bit 8*/
-    imm |= ir1_rex_w(pir1) << 8;
-#endif
-    if (ir1_opnd_is_xmm(opnd1)) {
-        int s = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpestrm_xmm, d, s, imm);
+    IR2_OPND reg = ra_alloc_gpr(gpr_num);
+    IR2_OPND temp = ra_alloc_itemp();
+    if (rex_w) {
+        la_or(len, reg, zero_ir2_opnd);
     } else {
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm((d + 1) % 7 + 1);
-        la_xvor_v(temp, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-         tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpestrm_xmm, d,
-                                                        (d + 1) % 7 + 1, imm);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO:fix eflags and mem opnd */
-    return true;
+        la_add_w(len, reg, zero_ir2_opnd);
+    }
+    la_srai_d(temp, len, 63);
+    la_xor(len, len, temp);
+    la_sub_d(len, len, temp);
+    la_sltui(temp, len, (is_word ? 8 : 16) + 1);
+    la_maskeqz(len, len, temp);
+    la_xori(temp, temp, 1);
+    la_slli_d(temp, temp, is_word ? 3 : 4);
+    la_or(len, len, temp);
+    ra_free_temp(temp);
 }
 
-bool translate_pcmpistri(IR1_INST *pir1)
+static void tr_pcmp_valid(IR2_OPND valid, IR2_OPND len, bool is_word)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND *opnd2 = ir1_get_opnd(pir1, 2);
-    int imm = ir1_opnd_uimm(opnd2);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (ir1_opnd_is_xmm(opnd1)) {
-        int s = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpistri_xmm, d, s, imm);
+    IR2_OPND addr = ra_alloc_itemp();
+    IR2_OPND iota = ra_alloc_ftemp();
+    if (is_word) {
+        li_host_addr(addr, (ADDR)pcmp_iota_h);
+        la_vld(iota, addr, 0);
+        la_vreplgr2vr_h(valid, len);
+        la_vslt_hu(valid, iota, valid);
     } else {
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm((d + 1) % 8);
-        la_xvor_v(temp, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpistri_xmm, d, (d + 1) % 8, imm);
-        la_xvor_v(src, temp, temp);
+        li_host_addr(addr, (ADDR)pcmp_iota_b);
+        la_vld(iota, addr, 0);
+        la_vreplgr2vr_b(valid, len);
+        la_vslt_bu(valid, iota, valid);
     }
-    /* TODO:fix eflags and mem opnd */
-    return true;
+    ra_free_temp(iota);
+    ra_free_temp(addr);
 }
 
-bool translate_pcmpistrm(IR1_INST *pir1)
+static void tr_pcmpxstrx(IR1_INST *pir1, bool is_explicit, bool is_index)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND *opnd2 = ir1_get_opnd(pir1, 2);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    int imm = ir1_opnd_uimm(opnd2);
-    if (ir1_opnd_is_xmm(opnd1)) {
-        int s = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpistrm_xmm, d, s, imm);
+    uint8_t ctrl = ir1_opnd_uimm(ir1_get_opnd(pir1, 2));
+    bool is_word = ctrl & 1;
+    bool is_signed = ctrl & 2;
+    int agg = (ctrl >> 2) & 3;
+    int pol = (ctrl >> 4) & 3;
+    int n = is_word ? 8 : 16;
+    int i;
+
+    IR2_OPND a = load_freg128_from_ir1(opnd0);
+    IR2_OPND b = load_freg128_from_ir1(opnd1);
+
+    /* 1. string lengths */
+    IR2_OPND len_a = ra_alloc_itemp();
+    IR2_OPND len_b = ra_alloc_itemp();
+    if (is_explicit) {
+        bool rex_w = false;
+#ifdef TARGET_X86_64
+        rex_w = ir1_rex_w(pir1);
+#endif
+        tr_pcmp_elen(len_a, eax_index, rex_w, is_word);
+        tr_pcmp_elen(len_b, edx_index, rex_w, is_word);
     } else {
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm((d + 1) % 7 + 1);
-        la_xvor_v(temp, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-         tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pcmpistrm_xmm, d,
-                                                        (d + 1) % 7 + 1, imm);
-        la_xvor_v(src, temp, temp);
+        tr_pcmp_ilen(len_a, a, is_word);
+        tr_pcmp_ilen(len_b, b, is_word);
     }
-    /* TODO:fix eflags and mem opnd */
-    return true;
-}
 
-bool translate_pclmulqdq(IR1_INST * pir1) {
-    IR1_OPND * opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND * opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND * opnd2 = ir1_get_opnd(pir1, 2);
+    IR2_OPND valid_a = ra_alloc_ftemp();
+    IR2_OPND valid_b = ra_alloc_ftemp();
+    tr_pcmp_valid(valid_a, len_a, is_word);
+    tr_pcmp_valid(valid_b, len_b, is_word);
 
-    IR2_OPND dest = load_freg128_from_ir1(opnd0);
-    IR2_OPND temp = ra_alloc_ftemp();
-    la_xvori_b(temp,dest,0x0);
-    int s0 = ir1_opnd_base_reg_num(opnd0);
-    uint8_t ctrl = ir1_opnd_uimm(opnd2);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pclmulqdq_xmm, s0, s1, ctrl);
+    /* 2. aggregation */
+    IR2_OPND acc = ra_alloc_ftemp();
+    IR2_OPND t1 = ra_alloc_ftemp();
+    IR2_OPND t2 = ra_alloc_ftemp();
+    bool valid_b_gated = false;
+    switch (agg) {
+    case 0:
+        /*
+         * equal any: invalid elements of A are replaced by A[0], which does
+         * not change the result unless A is empty, and that is gated below
+         */
+        if (is_word) {
+            la_vreplvei_h(t1, a, 0);
+            la_vbitsel_v(t1, t1, a, valid_a);
+            la_vreplvei_h(valid_a, valid_a, 0);
+        } else {
+            la_vreplvei_b(t1, a, 0);
+            la_vbitsel_v(t1, t1, a, valid_a);
+            la_vreplvei_b(valid_a, valid_a, 0);
+        }
+        la_vand_v(valid_b, valid_b, valid_a);
+        valid_b_gated = true;
+        for (i = 0; i < n; i++) {
+            IR2_OPND dst = i ? t2 : acc;
+            if (is_word) {
+                la_vreplvei_h(dst, t1, i);
+                la_vseq_h(dst, b, dst);
+            } else {
+                la_vreplvei_b(dst, t1, i);
+                la_vseq_b(dst, b, dst);
+            }
+            if (i) {
+                la_vor_v(acc, acc, t2);
+            }
+        }
+        la_vand_v(acc, acc, valid_b);
+        break;
+    case 1: {
+        /* ranges: a pair is used only if its upper bound is valid */
+        IR2_OPND t3 = ra_alloc_ftemp();
+        if (is_word) {
+            la_vpackod_h(valid_a, valid_a, valid_a);
+            la_vreplvei_w(t1, a, 0);
+            la_vbitsel_v(t1, t1, a, valid_a);
+            la_vreplvei_h(valid_a, valid_a, 0);
+        } else {
+            la_vpackod_b(valid_a, valid_a, valid_a);
+            la_vreplvei_h(t1, a, 0);
+            la_vbitsel_v(t1, t1, a, valid_a);
+            la_vreplvei_b(valid_a, valid_a, 0);
+        }
+        la_vand_v(valid_b, valid_b, valid_a);
+        valid_b_gated = true;
+        for (i = 0; i < n; i += 2) {
+            IR2_OPND dst = i ? t2 : acc;
+            if (is_word) {
+                la_vreplvei_h(t3, t1, i);
+                la_vreplvei_h(dst, t1, i + 1);
+                if (is_signed) {
+                    la_vsle_h(t3, t3, b);
+                    la_vsle_h(dst, b, dst);
+                } else {
+                    la_vsle_hu(t3, t3, b);
+                    la_vsle_hu(dst, b, dst);
+                }
+            } else {
+                la_vreplvei_b(t3, t1, i);
+                la_vreplvei_b(dst, t1, i + 1);
+                if (is_signed) {
+                    la_vsle_b(t3, t3, b);
+                    la_vsle_b(dst, b, dst);
+                } else {
+                    la_vsle_bu(t3, t3, b);
+                    la_vsle_bu(dst, b, dst);
+                }
+            }
+            la_vand_v(dst, dst, t3);
+            if (i) {
+                la_vor_v(acc, acc, t2);
+            }
+        }
+        la_vand_v(acc, acc, valid_b);
+        ra_free_temp(t3);
+        break;
+    }
+    case 2:
+        /* equal each: two invalid elements compare true */
+        if (is_word) {
+            la_vseq_h(acc, a, b);
+        } else {
+            la_vseq_b(acc, a, b);
+        }
+        la_vand_v(t1, valid_a, valid_b);
+        la_vand_v(acc, acc, t1);
+        la_vnor_v(t1, valid_a, valid_b);
+        la_vor_v(acc, acc, t1);
+        break;
+    case 3:
+        /*
+         * equal ordered: B[j] starts a match unless some valid A[i] differs
+         * from B[i + j]; the mismatches of A[i] are shifted down by i, so
+         * elements past the end of B shift in as matching.
+         */
+        for (i = 0; i < n; i++) {
+            IR2_OPND dst = i ? t1 : acc;
+            if (is_word) {
+                la_vreplvei_h(dst, a, i);
+                la_vseq_h(dst, b, dst);
+            } else {
+                la_vreplvei_b(dst, a, i);
+                la_vseq_b(dst, b, dst);
+            }
+            la_vand_v(dst, dst, valid_b);
+            la_vnor_v(dst, dst, dst);
+            if (i) {
+                la_vbsrl_v(dst, dst, is_word ? i * 2 : i);
+            }
+            if (is_word) {
+                la_vreplvei_h(t2, valid_a, i);
+            } else {
+                la_vreplvei_b(t2, valid_a, i);
+            }
+            la_vand_v(dst, dst, t2);
+            if (i) {
+                la_vor_v(acc, acc, t1);
+            }
+        }
+        la_vnor_v(acc, acc, acc);
+        break;
+    }
+
+    /* 3. polarity */
+    if (pol == 1) {
+        la_vnor_v(acc, acc, acc);
+    } else if (pol == 3) {
+        if (valid_b_gated) {
+            tr_pcmp_valid(valid_b, len_b, is_word);
+        }
+        la_vxor_v(acc, acc, valid_b);
+    }
+    ra_free_temp(t2);
+    ra_free_temp(valid_b);
+    ra_free_temp(valid_a);
+
+    IR2_OPND res = ra_alloc_itemp();
+    if (is_word) {
+        la_vmskltz_h(t1, acc);
     } else {
-        int s1 = 0;
-        while (s1 < 8) {
-            if (s1 != s0) {
-                break;
+        la_vmskltz_b(t1, acc);
+    }
+    la_movfr2gr_s(res, t1);
+
+    /* 4. output */
+    IR2_OPND temp = ra_alloc_itemp();
+    if (is_index) {
+        IR2_OPND ecx_opnd = ra_alloc_gpr(ecx_index);
+        if (ctrl & 0x40) {
+            /* most significant set bit, n if none */
+            la_clz_w(temp, res);
+            la_sub_w(temp, zero_ir2_opnd, temp);
+            la_addi_w(temp, temp, 31);
+            la_maskeqz(temp, temp, res);
+            la_sltui(ecx_opnd, res, 1);
+            la_slli_d(ecx_opnd, ecx_opnd, is_word ? 3 : 4);
+            la_or(ecx_opnd, ecx_opnd, temp);
+        } else {
+            /* least significant set bit, n if none */
+            if (is_word) {
+                la_ori(temp, res, 1 << 8);
+            } else {
+                la_lu12i_w(temp, 1 << 4);
+                la_or(temp, res, temp);
             }
-            s1++;
+            la_ctz_w(ecx_opnd, temp);
+        }
+    } else {
+        IR2_OPND xmm0 = ra_alloc_xmm(0);
+        IR2_OPND vec = acc;
+        if (!(ctrl & 0x40)) {
+            la_vxor_v(t1, t1, t1);
+            la_vinsgr2vr_d(t1, res, 0);
+            vec = t1;
+        }
+        if (option_enable_lasx) {
+            la_xvpermi_q(xmm0, vec, 0x30);
+        } else {
+            la_vori_b(xmm0, vec, 0);
         }
-        IR2_OPND temp_mem = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp_mem, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_pclmulqdq_xmm, s0, s1, ctrl);
-        la_xvor_v(src, temp_mem, temp_mem);
     }
+    ra_free_temp(t1);
+    ra_free_temp(acc);
+
+    /* 5. eflags: CF = res != 0, ZF/SF = B/A shorter than n, OF = res[0] */
+    IR2_OPND eflags = ra_alloc_itemp();
+    la_sltu(eflags, zero_ir2_opnd, res);
+    la_andi(temp, res, 1);
+    la_slli_d(temp, temp, 11);
+    la_or(eflags, eflags, temp);
+    la_sltui(temp, len_b, n);
+    la_slli_d(temp, temp, 6);
+    la_or(eflags, eflags, temp);
+    la_sltui(temp, len_a, n);
+    la_slli_d(temp, temp, 7);
+    la_or(eflags, eflags, temp);
+    la_x86mtflag(eflags, 0x3f);
+
+    ra_free_temp(eflags);
+    ra_free_temp(temp);
+    ra_free_temp(res);
+    ra_free_temp(len_b);
+    ra_free_temp(len_a);
+    ra_free_temp_auto(b);
+}
+
+bool translate_pcmpestri(IR1_INST *pir1)
+{
+    tr_pcmpxstrx(pir1, true, true);
     return true;
 }
 
-bool translate_aesdec(IR1_INST *pir1)
+bool translate_pcmpestrm(IR1_INST *pir1)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_aesdec_xmm, d, s1, 0);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
+    tr_pcmpxstrx(pir1, true, false);
+    return true;
+}
 
-        tr_gen_call_to_helper_aes((ADDR)helper_aesdec_xmm, d, s1, 0);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+bool translate_pcmpistri(IR1_INST *pir1)
+{
+    tr_pcmpxstrx(pir1, false, true);
     return true;
 }
 
-bool translate_aesdeclast(IR1_INST *pir1)
+bool translate_pcmpistrm(IR1_INST *pir1)
+{
+    tr_pcmpxstrx(pir1, false, false);
+    return true;
+}
+
+/*
+ * PCLMULQDQ without a carry-less multiplier: the factors are split into
+ * four sets of bits four apart, so the sums of an integer multiply do not
+ * carry into the next bit of the same set below bit 64. Lane 0 gets the
+ * low half of the product, lane 1 the bit-reversed high half.
+ */
+bool translate_pclmulqdq(IR1_INST *pir1)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_aesdeclast_xmm, d, s1, 0);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
+    uint8_t ctrl = ir1_opnd_uimm(ir1_get_opnd(pir1, 2));
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND src = load_freg128_from_ir1(opnd1);
+    IR2_OPND gpr = ra_alloc_itemp();
+    IR2_OPND x[4], y, t, acc;
+    int i, c;
+
+    x[0] = ra_alloc_ftemp();
+    la_vpickve2gr_d(gpr, dest, ctrl & 1);
+    la_vinsgr2vr_d(x[0], gpr, 0);
+    la_bitrev_d(gpr, gpr);
+    la_vinsgr2vr_d(x[0], gpr, 1);
+    y = ra_alloc_ftemp();
+    la_vpickve2gr_d(gpr, src, (ctrl >> 4) & 1);
+    la_vinsgr2vr_d(y, gpr, 0);
+    la_bitrev_d(gpr, gpr);
+    la_vinsgr2vr_d(y, gpr, 1);
+    ra_free_temp_auto(src);
+
+    for (i = 3; i >= 0; i--) {
+        if (i) {
+            x[i] = ra_alloc_ftemp();
+        }
+        la_vandi_b(x[i], x[0], 0x11 << i);
+    }
+    t = ra_alloc_ftemp();
+    acc = ra_alloc_ftemp();
+    for (c = 0; c < 4; c++) {
+        for (i = 0; i < 4; i++) {
+            la_vandi_b(t, y, 0x11 << ((c - i) & 3));
+            if (i) {
+                la_vmul_d(t, x[i], t);
+                la_vxor_v(acc, acc, t);
+            } else {
+                la_vmul_d(acc, x[i], t);
+            }
+        }
+        if (c) {
+            la_vandi_b(acc, acc, 0x11 << c);
+            la_vor_v(dest, dest, acc);
+        } else {
+            la_vandi_b(dest, acc, 0x11);
+        }
+    }
+
+    la_vpickve2gr_d(gpr, dest, 1);
+    la_bitrev_d(gpr, gpr);
+    la_srli_d(gpr, gpr, 1);
+    la_vinsgr2vr_d(dest, gpr, 1);
 
-        tr_gen_call_to_helper_aes((ADDR)helper_aesdeclast_xmm, d, s1, 0);
-        la_xvor_v(src, temp, temp);
+    for (i = 0; i < 4; i++) {
+        ra_free_temp(x[i]);
     }
-    /* TODO: need to check */
+    ra_free_temp(y);
+    ra_free_temp(t);
+    ra_free_temp(acc);
+    ra_free_temp(gpr);
     return true;
 }
 
-bool translate_aesenc(IR1_INST *pir1)
+/* dest[i] = src[idx[i]] for a constant 16-byte index */
+static void tr_aes_shuffle(IR2_OPND dest, IR2_OPND src, const uint8_t *idx)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_aesenc_xmm, d, s1, 0);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
+    IR2_OPND addr = ra_alloc_itemp();
+    IR2_OPND idx_opnd = ra_alloc_ftemp();
 
-        tr_gen_call_to_helper_aes((ADDR)helper_aesenc_xmm, d, s1, 0);
-        la_xvor_v(src, temp, temp);
+    li_host_addr(addr, idx);
+    la_vld(idx_opnd, addr, 0);
+    la_vshuf_b(dest, src, src, idx_opnd);
+    ra_free_temp(idx_opnd);
+    ra_free_temp(addr);
+}
+
+/*
+ * S-box lookup by vshuf.b: each 32-byte slice of the table is looked up
+ * with the low 5 bits of src and kept where the high 3 bits pick it.
+ * src is clobbered.
+ */
+static void tr_aes_sub_bytes(IR2_OPND dest, IR2_OPND src, const uint8_t *sbox)
+{
+    IR2_OPND addr = ra_alloc_itemp();
+    IR2_OPND idx = ra_alloc_ftemp();
+    IR2_OPND lo = ra_alloc_ftemp();
+    IR2_OPND hi = ra_alloc_ftemp();
+
+    li_host_addr(addr, sbox);
+    la_vandi_b(idx, src, 0x1f);
+    la_vsrli_b(src, src, 5);
+    for (int i = 0; i < 8; i++) {
+        la_vld(lo, addr, i * 32);
+        la_vld(hi, addr, i * 32 + 16);
+        la_vshuf_b(lo, hi, lo, idx);
+        la_vseqi_b(hi, src, i);
+        if (i) {
+            la_vbitsel_v(dest, dest, lo, hi);
+        } else {
+            la_vand_v(dest, lo, hi);
+        }
     }
-    /* TODO: need to check */
-    return true;
+    ra_free_temp(hi);
+    ra_free_temp(lo);
+    ra_free_temp(idx);
+    ra_free_temp(addr);
 }
 
-bool translate_aesenclast(IR1_INST *pir1)
+/* t = {02} * x in GF(2^8) for each byte */
+static void tr_aes_xtime(IR2_OPND t, IR2_OPND x, IR2_OPND temp)
+{
+    la_vslti_b(temp, x, 0);
+    la_vandi_b(temp, temp, 0x1b);
+    la_vslli_b(t, x, 1);
+    la_vxor_v(t, t, temp);
+}
+
+/*
+ * MixColumns on the columns in the words of x, with r8/r16/r24 the
+ * rotations of a column by 1/2/3 rows:
+ * x = 2x ^ r8(2x ^ x) ^ r16(x) ^ r24(x)
+ */
+static void tr_aes_mix_columns(IR2_OPND x)
+{
+    IR2_OPND t1 = ra_alloc_ftemp();
+    IR2_OPND t2 = ra_alloc_ftemp();
+
+    tr_aes_xtime(t1, x, t2);
+    la_vxor_v(t2, t1, x);
+    la_vrotri_w(t2, t2, 8);
+    la_vxor_v(t1, t1, t2);
+    la_vrotri_w(t2, x, 16);
+    la_vxor_v(t1, t1, t2);
+    la_vrotri_w(t2, x, 24);
+    la_vxor_v(x, t1, t2);
+    ra_free_temp(t2);
+    ra_free_temp(t1);
+}
+
+/* InvMixColumns is MixColumns of x ^ 4(x ^ r16(x)) */
+static void tr_aes_inv_mix_columns(IR2_OPND x)
+{
+    IR2_OPND t1 = ra_alloc_ftemp();
+    IR2_OPND t2 = ra_alloc_ftemp();
+
+    la_vrotri_w(t1, x, 16);
+    la_vxor_v(t1, t1, x);
+    tr_aes_xtime(t1, t1, t2);
+    tr_aes_xtime(t1, t1, t2);
+    la_vxor_v(x, x, t1);
+    ra_free_temp(t2);
+    ra_free_temp(t1);
+    tr_aes_mix_columns(x);
+}
+
+static bool tr_aes_round(IR1_INST *pir1, bool is_dec, bool is_last)
 {
     IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
     IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (!ir1_opnd_is_mem(opnd1)) {
-        int s1 = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_aes((ADDR)helper_aesenclast_xmm, d, s1, 0);
-    } else {
-        int s1 = (d + 1) & 7;
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm(s1);
-        la_xvor_v(temp, src, src);
-        assert(ir1_opnd_size(opnd1) == 128);
-        load_freg128_from_ir1_mem(src, opnd1);
-
-        tr_gen_call_to_helper_aes((ADDR)helper_aesenclast_xmm, d, s1, 0);
-        la_xvor_v(src, temp, temp);
+    IR2_OPND dest = load_freg128_from_ir1(opnd0);
+    IR2_OPND state = ra_alloc_ftemp();
+    IR2_OPND sub = ra_alloc_ftemp();
+    IR2_OPND key;
+
+    /* ShiftRows and SubBytes commute */
+    tr_aes_shuffle(state, dest, is_dec ? AES_ishifts : AES_shifts);
+    tr_aes_sub_bytes(sub, state, is_dec ? AES_isbox : AES_sbox);
+    ra_free_temp(state);
+    if (!is_last) {
+        if (is_dec) {
+            tr_aes_inv_mix_columns(sub);
+        } else {
+            tr_aes_mix_columns(sub);
+        }
     }
-    /* TODO: need to check */
+    key = load_freg128_from_ir1(opnd1);
+    la_vxor_v(dest, sub, key);
+    ra_free_temp_auto(key);
+    ra_free_temp(sub);
     return true;
 }
 
+bool translate_aesdec(IR1_INST *pir1)
+{
+    return tr_aes_round(pir1, true, false);
+}
+
+bool translate_aesdeclast(IR1_INST *pir1)
+{
+    return tr_aes_round(pir1, true, true);
+}
+
+bool translate_aesenc(IR1_INST *pir1)
+{
+    return tr_aes_round(pir1, false, false);
+}
+
+bool translate_aesenclast(IR1_INST *pir1)
+{
+    return tr_aes_round(pir1, false, true);
+}
+
 bool translate_aesimc(IR1_INST *pir1)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    if (ir1_opnd_is_xmm(opnd1)) {
-        int s = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_aesimc_xmm, d, s, 0);
-    } else {
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm((d + 1) % 7 + 1);
-        la_xvor_v(temp, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-         tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_aesimc_xmm, d,
-                                                    (d + 1) % 7 + 1, 0);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: IMM 0 do not need to save */
+    IR2_OPND dest = load_freg128_from_ir1(ir1_get_opnd(pir1, 0));
+    IR2_OPND src = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));
+    IR2_OPND temp = ra_alloc_ftemp();
+
+    la_vori_b(temp, src, 0);
+    ra_free_temp_auto(src);
+    tr_aes_inv_mix_columns(temp);
+    la_vori_b(dest, temp, 0);
+    ra_free_temp(temp);
     return true;
 }
 
+/*
+ * dest = { S(X1), ror8(S(X1)) ^ imm, S(X3), ror8(S(X3)) ^ imm } with X1
+ * and X3 the dwords 1 and 3 of src.
+ */
 bool translate_aeskeygenassist(IR1_INST *pir1)
 {
-    IR1_OPND *opnd0 = ir1_get_opnd(pir1, 0);
-    IR1_OPND *opnd1 = ir1_get_opnd(pir1, 1);
-    IR1_OPND *opnd2 = ir1_get_opnd(pir1, 2);
-    int d = ir1_opnd_base_reg_num(opnd0);
-    int imm = ir1_opnd_uimm(opnd2);
-    if (ir1_opnd_is_xmm(opnd1)) {
-        int s = ir1_opnd_base_reg_num(opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_aeskeygenassist_xmm, d, s, imm);
-    } else {
-        IR2_OPND temp = ra_alloc_ftemp();
-        IR2_OPND src = ra_alloc_xmm((d + 1) % 7 + 1);
-        la_xvor_v(temp, src, src);
-        load_freg128_from_ir1_mem(src, opnd1);
-        tr_gen_call_to_helper_pcmpxstrx((ADDR)helper_aeskeygenassist_xmm, d,
-                                                            (d + 1) % 7 + 1, imm);
-        la_xvor_v(src, temp, temp);
-    }
-    /* TODO: need to check */
+    IR2_OPND dest = load_freg128_from_ir1(ir1_get_opnd(pir1, 0));
+    IR2_OPND src = load_freg128_from_ir1(ir1_get_opnd(pir1, 1));
+    int imm = ir1_opnd_uimm(ir1_get_opnd(pir1, 2));
+    IR2_OPND words = ra_alloc_ftemp();
+    IR2_OPND sub = ra_alloc_ftemp();
+    IR2_OPND rot;
+
+    la_vshuf4i_w(words, src, 0xf5);
+    ra_free_temp_auto(src);
+    tr_aes_sub_bytes(sub, words, AES_sbox);
+    rot = words;
+    la_vrotri_w(rot, sub, 8);
+    if (imm) {
+        IR2_OPND rcon = ra_alloc_itemp();
+        IR2_OPND rcon_vec = ra_alloc_ftemp();
+        li_d(rcon, imm);
+        la_vreplgr2vr_w(rcon_vec, rcon);
+        la_vxor_v(rot, rot, rcon_vec);
+        ra_free_temp(rcon_vec);
+        ra_free_temp(rcon);
+    }
+    la_vextrins_w(sub, rot, 0x11);
+    la_vextrins_w(sub, rot, 0x33);
+    la_vori_b(dest, sub, 0);
+    ra_free_temp(rot);
+    ra_free_temp(sub);
     return true;
 }
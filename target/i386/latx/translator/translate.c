@@ -3,6 +3,7 @@
 #include "flag-lbt.h"
 #include <string.h>
 #include "latx-options.h"
+#include "latx-config.h"
 #include "fpu/softfloat.h"
 #include "profile.h"
 #include "translate.h"
@@ -11,6 +12,9 @@
 #include "ir2-relocate.h"
 #include "tu.h"
 #include "imm-cache.h"
+#ifdef CONFIG_LATX_PERF
+#include "latx-perf.h"
+#endif
 
 extern void *helper_tb_lookup_ptr(CPUArchState *);
 static int ss_generate_match_fail_native_code(void* code_buf);
@@ -73,7 +77,7 @@ int FPR_USEDEF_TO_SAVE = 0xff;
 int XMM_USEDEF_TO_SAVE = 0xffff;
 #endif
 
-struct lat_lock lat_lock[16];
+struct lat_lock lat_lock[LAT_LOCK_MAX_STRIPES];
 
 void tr_init(void *tb)
 {
@@ -150,6 +154,39 @@ static inline uint8_t cpu_read_code_via_qemu(void *cpu, ADDRX pc)
     return cpu_ldub_code((CPUX86State *)cpu, (target_ulong)pc);
 }
 
+#define X86_INSN_WINDOW 15
+
+/*
+ * Copy the instruction window at pc into buf, return its length.
+ * The page crossed by the window is checked once and remembered in
+ * *readable_page, so only the first insn reaching a page pays for the
+ * page_get_flags lookup. A window cut short by an unreadable page falls
+ * back to reading byte by byte.
+ */
+static inline int cpu_read_insn_via_qemu(void *cpu, ADDRX pc, uint8_t *buf,
+                                         ADDRX *readable_page)
+{
+    ADDRX next_page = (pc + X86_INSN_WINDOW) & TARGET_PAGE_MASK;
+    int len = X86_INSN_WINDOW;
+
+    if ((pc & TARGET_PAGE_MASK) != next_page && next_page != *readable_page) {
+        if (page_get_flags(next_page) & PAGE_READ) {
+            *readable_page = next_page;
+        } else {
+            len = next_page - pc;
+            for (int i = 0; i < len; ++i) {
+                buf[i] = cpu_read_code_via_qemu(cpu, pc + i);
+            }
+            return len;
+        }
+    }
+    /* a fault here is reported as an insn fetch fault like cpu_ldub_code */
+    set_helper_retaddr(1);
+    memcpy(buf, g2h_untagged((target_ulong)pc), len);
+    clear_helper_retaddr();
+    return len;
+}
+
 #ifdef CONFIG_LATX_TU
 static char insn_info[MAX_IR1_IN_TU * IR1_INST_SIZE] = {0};
 static IR1_INST ir1_list_rel[MAX_IR1_IN_TU];
@@ -163,13 +200,448 @@ static char insn_info[MAX_IR1_NUM_PER_TB * IR1_INST_SIZE] = {0};
 static IR1_INST ir1_list[MAX_IR1_NUM_PER_TB];
 #endif
 
+#ifdef CONFIG_LATX_HOT_TRACE
+/*
+ * A hot trace stays in the page of its pc and the next one, the two pages
+ * SMC invalidation checks against [tb->pc, tb->pc + tb->size).
+ */
+static ADDRX hot_trace_end(ADDRX start_pc)
+{
+    return (start_pc & TARGET_PAGE_MASK) + 2 * TARGET_PAGE_SIZE;
+}
+
+/*
+ * The target of a direct jmp ahead of it is decoded in line, keeping the
+ * trace a forward walk inside [tb->pc, tb->pc + tb->size).
+ */
+static bool hot_trace_follow(IR1_INST *pir1, ADDRX start_pc)
+{
+    ADDRX target;
+
+    if (!ir1_is_jump(pir1) || ir1_is_indirect_jmp(pir1)) {
+        return false;
+    }
+    target = ir1_target_addr(pir1);
+    return target >= ir1_addr_next(pir1) && target < hot_trace_end(start_pc);
+}
+
+/* Only TBs a hot trace would extend are worth counting. */
+static bool hot_trace_can_extend(struct TranslationBlock *tb)
+{
+    return tb->icount && hot_trace_follow(tb_ir1_inst_last(tb), tb->pc);
+}
+#endif
+
+/*
+ * Decode the insns of one TB from pc into list, the info of list[i] goes
+ * to slot base_idx + i of info_base. Stops after a TB ending insn, after
+ * max_insns insns or at an insn that does not decode, *broken is set then.
+ * With code the insns are read from this copy of the guest code at pc
+ * instead, and the decode gives up, returning -1, before reading an insn
+ * that may reach limit. *end_pc gets the pc after the last insn.
+ */
+static int ir1_decode_tb(IR1_INST *list, void *info_base, int base_idx,
+                         ADDRX pc, int max_insns, bool hot_trace,
+                         const uint8_t *code, ADDRX limit,
+                         ADDRX *end_pc, bool *broken)
+{
+    uint8_t inst_cache[X86_INSN_WINDOW + 1] = {0};
+    IR1_INST *pir1 = NULL;
+    ADDRX start_pc = pc;
+    ADDRX readable_page = -1;
+    int ir1_num = 0;
+#ifdef CONFIG_LATX_HOT_TRACE
+    ADDRX trace_jmp_pc = 0;
+#endif
+
+    *broken = false;
+    do {
+#ifdef CONFIG_LATX_HOT_TRACE
+trace_next:
+#endif
+        if (code) {
+            if (pc + X86_INSN_WINDOW > limit) {
+                return -1;
+            }
+            memcpy(inst_cache, code + (pc - start_pc), X86_INSN_WINDOW);
+        } else {
+            /* read 32 instructioin bytes */
+            lsassert(lsenv->cpu_state != NULL);
+            /*
+             * Wine-6.0 implement try/except via C code. So there has chance to access some
+             * iliigal address, such as 0.
+             * LATX need to identify this kind of address via qemu cpu_ldub_code api to handle
+             * this scenario.
+             * The window is copied at once under the same fault handling, page
+             * readability is checked once per page.
+             */
+            cpu_read_insn_via_qemu(lsenv->cpu_state, pc, inst_cache,
+                                   &readable_page);
+        }
+        /* disasemble this instruction */
+        pir1 = &list[ir1_num];
+        /* get next pc */
+        pc = ir1_disasm(pir1, inst_cache, pc, base_idx + ir1_num, info_base);
+        if (pir1->info == NULL) {
+#ifdef CONFIG_LATX_HOT_TRACE
+            if (trace_jmp_pc) {
+                /* the jmp target does not decode, keep the jmp as exit */
+                pc = trace_jmp_pc;
+                trace_jmp_pc = 0;
+                hot_trace = false;
+                goto trace_next;
+            }
+#endif
+            *broken = true;
+            break;
+        }
+        ir1_num++;
+        lsassert(ir1_num <= 255);
+#ifdef CONFIG_LATX_HOT_TRACE
+        /* the jmp target decodes, the jmp can no longer be the exit */
+        trace_jmp_pc = 0;
+#endif
+
+        /* check if TB is too large */
+#ifdef CONFIG_LATX_DEBUG
+        if (ir1_num == max_insns) {
+#else
+        if (ir1_num == max_insns && !ir1_is_tb_ending(pir1)) {
+#endif
+            pc = ir1_addr(pir1);
+            ir1_make_ins_JMP(pir1, pc, 0);
+            break;
+        }
+#ifdef CONFIG_LATX_HOT_TRACE
+        if (hot_trace) {
+            if (pc > hot_trace_end(start_pc)) {
+                /* leaves the pages of the trace, a new TB starts here */
+                pc = ir1_addr(pir1);
+                ir1_make_ins_JMP(pir1, pc, 0);
+                break;
+            }
+            if (hot_trace_follow(pir1, start_pc)) {
+                /* drop the jmp and go on at its target */
+                trace_jmp_pc = ir1_addr(pir1);
+                pc = ir1_target_addr(pir1);
+                ir1_num--;
+                goto trace_next;
+            }
+        }
+#endif
+    } while (!ir1_is_tb_ending(pir1));
+
+    *end_pc = pc;
+    return ir1_num;
+}
+
+#ifdef CONFIG_LATX_PREDECODE
+/*
+ * The IR1 of a TB decoded by tr_predecode() without mmap_lock, bytes is
+ * the guest code [pc, end_pc) it was decoded from.
+ */
+typedef struct IR1_PREDECODED {
+    ADDRX pc;
+    ADDRX end_pc;
+    int max_insns;
+    bool hot_trace;
+    int ir1_num;
+    IR1_INST ir1[MAX_IR1_NUM_PER_TB];
+    struct la_dt_insn info[MAX_IR1_NUM_PER_TB];
+    uint8_t bytes[2 * TARGET_PAGE_SIZE];
+} IR1_PREDECODED;
+
+static __thread IR1_PREDECODED *ir1_predecoded;
+
+/*
+ * Only the git capstone decoder keeps its state per thread, the others
+ * and the V2 compare share global buffers that need mmap_lock.
+ */
+static bool tr_predecode_thread_safe(void)
+{
+#ifdef CONFIG_LATX_CAPSTONE_GIT
+    return la_disa_v1 == &gitcapstone_get && !la_disa_v2;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Decode the TB at pc ahead of tb_gen_code(), before mmap_lock is taken,
+ * so that threads missing in tb_find() at the same time decode in
+ * parallel. The code is copied first and decoded from the copy, under
+ * mmap_lock get_ir1_list() takes the result only if the guest code still
+ * matches the copy. Anything unusual is left to get_ir1_list(). Returns
+ * true if the TB was decoded.
+ *
+ * The copy is taken under mmap_lock from pages checked readable, so a
+ * concurrent munmap cannot fault it: a fault here would reach the guest
+ * as a SIGSEGV the locked translation might never raise.
+ */
+bool tr_predecode(CPUState *cpu, target_ulong pc, uint32_t cflags)
+{
+    CPUX86State *env = cpu->env_ptr;
+    IR1_PREDECODED *pre = ir1_predecoded;
+    ADDRX limit = (pc & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+    int max_insns = cflags & CF_COUNT_MASK;
+    bool hot_trace = false;
+    bool broken;
+    int ir1_num;
+
+    if (!tr_predecode_thread_safe()) {
+        return false;
+    }
+#if defined(TARGET_VSYSCALL_PAGE) && defined(TARGET_X86_64)
+    if ((pc & TARGET_PAGE_MASK) == TARGET_VSYSCALL_PAGE) {
+        return false;
+    }
+#endif
+    if (!pre) {
+        pre = ir1_predecoded = g_new(IR1_PREDECODED, 1);
+    }
+    pre->pc = 0;
+
+    /* the same max_insns as tb_gen_code() and get_ir1_list() */
+    if (max_insns == 0) {
+        max_insns = CF_COUNT_MASK;
+    }
+    if (max_insns > TCG_MAX_INSNS) {
+        max_insns = TCG_MAX_INSNS;
+    }
+    if (max_insns == 1) {
+        max_insns++;
+    }
+#ifdef CONFIG_LATX_HOT_TRACE
+    hot_trace = option_hot_trace && env->hot_pc == pc;
+#endif
+
+    mmap_lock();
+    if (!(page_get_flags(pc) & PAGE_EXEC) ||
+        !page_check_range(pc, limit - pc, PAGE_READ)) {
+        mmap_unlock();
+        return false;
+    }
+    if (page_get_flags(limit) & PAGE_READ) {
+        limit += TARGET_PAGE_SIZE;
+    }
+    memcpy(pre->bytes, g2h_untagged(pc), limit - pc);
+    mmap_unlock();
+
+    ir1_num = ir1_decode_tb(pre->ir1, pre->info, 0, pc, max_insns, hot_trace,
+                            pre->bytes, limit, &pre->end_pc, &broken);
+    if (ir1_num <= 0 || broken) {
+        return false;
+    }
+    pre->max_insns = max_insns;
+    pre->hot_trace = hot_trace;
+    pre->ir1_num = ir1_num;
+    pre->pc = pc;
+    return true;
+}
+
+/*
+ * Move the predecoded IR1 of pc into list, see ir1_decode_tb() for the
+ * arguments. Returns -1 if there is none or the guest code has changed.
+ */
+static int ir1_take_predecoded(IR1_INST *list, void *info_base, int base_idx,
+                               ADDRX pc, int max_insns, bool hot_trace,
+                               ADDRX *end_pc)
+{
+    IR1_PREDECODED *pre = ir1_predecoded;
+    struct la_dt_insn *info = (struct la_dt_insn *)info_base + base_idx;
+
+    if (!pre || pre->pc != pc) {
+        return -1;
+    }
+    pre->pc = 0;
+    if (pre->max_insns != max_insns || pre->hot_trace != hot_trace ||
+        !page_check_range(pc, pre->end_pc - pc, PAGE_READ) ||
+        memcmp(g2h_untagged(pc), pre->bytes, pre->end_pc - pc)) {
+        return -1;
+    }
+
+    memcpy(info, pre->info, pre->ir1_num * sizeof(struct la_dt_insn));
+    for (int i = 0; i < pre->ir1_num; i++) {
+        list[i] = pre->ir1[i];
+        list[i].info = &info[i];
+    }
+    *end_pc = pre->end_pc;
+    return pre->ir1_num;
+}
+#endif
+
+#ifdef CONFIG_LATX_DECODE_CACHE
+/*
+ * The IR1 of decoded TBs is kept for their retranslation, after a tb
+ * flush, a TU split or the invalidation of other code in their page. The
+ * code of a write protected page changes only after page_unprotect() or
+ * page_set_flags() invalidated it, which bumps the write generation of
+ * the page. Generations are hashed by page, a collision just bumps more
+ * pages. All of this runs under mmap_lock. Pages shared with other
+ * processes (PAGE_MEMSHARE) change without any fault in this one, their
+ * code is always compared with the kept bytes.
+ */
+#define DECODE_GEN_BITS 12
+#define DECODE_GEN_SIZE (1 << DECODE_GEN_BITS)
+
+static uint32_t decode_gen[DECODE_GEN_SIZE];
+
+static uint32_t *decode_gen_of(ADDRX addr)
+{
+    return &decode_gen[(addr >> TARGET_PAGE_BITS) & (DECODE_GEN_SIZE - 1)];
+}
+
+typedef struct IR1_CACHED {
+    QTAILQ_ENTRY(IR1_CACHED) lru;
+    ADDRX pc;
+    ADDRX end_pc;
+    int max_insns;
+    bool hot_trace;
+    /* the code was write protected when gen was read */
+    bool gen_valid;
+    uint32_t gen[2];
+    int ir1_num;
+    IR1_INST *ir1;
+    struct la_dt_insn *info;
+    uint8_t *bytes;
+} IR1_CACHED;
+
+static GHashTable *ir1_cache;
+static QTAILQ_HEAD(, IR1_CACHED) ir1_cache_lru =
+    QTAILQ_HEAD_INITIALIZER(ir1_cache_lru);
+static int ir1_cache_num;
+
+void tr_decode_cache_invalidate(target_ulong start, target_ulong end)
+{
+    target_ulong addr;
+
+    if (end - start >= (target_ulong)DECODE_GEN_SIZE << TARGET_PAGE_BITS) {
+        for (int i = 0; i < DECODE_GEN_SIZE; i++) {
+            decode_gen[i]++;
+        }
+        return;
+    }
+    for (addr = start & TARGET_PAGE_MASK; addr < end;
+         addr += TARGET_PAGE_SIZE) {
+        (*decode_gen_of(addr))++;
+    }
+}
+
+/* A TB spans at most two pages, the ones of pc and end_pc - 1. */
+static void ir1_cache_set_gen(IR1_CACHED *e)
+{
+    e->gen_valid = !(page_get_flags(e->pc) & (PAGE_WRITE | PAGE_MEMSHARE)) &&
+                   !(page_get_flags(e->end_pc - 1) &
+                     (PAGE_WRITE | PAGE_MEMSHARE));
+    e->gen[0] = *decode_gen_of(e->pc);
+    e->gen[1] = *decode_gen_of(e->end_pc - 1);
+}
+
+static void ir1_cache_remove(IR1_CACHED *e)
+{
+    g_hash_table_remove(ir1_cache, (gpointer)(uintptr_t)e->pc);
+    QTAILQ_REMOVE(&ir1_cache_lru, e, lru);
+    ir1_cache_num--;
+    g_free(e->ir1);
+    g_free(e->info);
+    g_free(e->bytes);
+    g_free(e);
+}
+
+/* Keep the IR1 just decoded from [pc, end_pc), dropping the LRU entry. */
+static void ir1_cache_insert(IR1_INST *list, int ir1_num, ADDRX pc,
+                             ADDRX end_pc, int max_insns, bool hot_trace)
+{
+    IR1_CACHED *e;
+
+    if (!ir1_cache) {
+        ir1_cache = g_hash_table_new(NULL, NULL);
+    }
+    e = g_hash_table_lookup(ir1_cache, (gpointer)(uintptr_t)pc);
+    if (e) {
+        ir1_cache_remove(e);
+    } else if (ir1_cache_num >= option_decode_cache) {
+        ir1_cache_remove(QTAILQ_LAST(&ir1_cache_lru));
+    }
+
+    e = g_new(IR1_CACHED, 1);
+    e->pc = pc;
+    e->end_pc = end_pc;
+    e->max_insns = max_insns;
+    e->hot_trace = hot_trace;
+    e->ir1_num = ir1_num;
+    e->ir1 = g_new(IR1_INST, ir1_num);
+    e->info = g_new(struct la_dt_insn, ir1_num);
+    for (int i = 0; i < ir1_num; i++) {
+        e->ir1[i] = list[i];
+        e->info[i] = *list[i].info;
+    }
+    e->bytes = g_malloc(end_pc - pc);
+    memcpy(e->bytes, g2h_untagged(pc), end_pc - pc);
+    ir1_cache_set_gen(e);
+
+    g_hash_table_insert(ir1_cache, (gpointer)(uintptr_t)pc, e);
+    QTAILQ_INSERT_HEAD(&ir1_cache_lru, e, lru);
+    ir1_cache_num++;
+}
+
+/*
+ * Copy the cached IR1 of pc into list, see ir1_decode_tb() for the
+ * arguments. A page written since the IR1 was kept, maybe only its data,
+ * has the code compared with the kept bytes. Returns -1 if there is no
+ * IR1 of pc or its code has changed.
+ */
+static int ir1_cache_take(IR1_INST *list, void *info_base, int base_idx,
+                          ADDRX pc, int max_insns, bool hot_trace,
+                          ADDRX *end_pc)
+{
+    struct la_dt_insn *info = (struct la_dt_insn *)info_base + base_idx;
+    IR1_CACHED *e;
+
+    if (!ir1_cache) {
+        return -1;
+    }
+    e = g_hash_table_lookup(ir1_cache, (gpointer)(uintptr_t)pc);
+    if (!e || e->max_insns != max_insns || e->hot_trace != hot_trace) {
+        return -1;
+    }
+    if (!page_check_range(pc, e->end_pc - pc, PAGE_READ)) {
+        ir1_cache_remove(e);
+        return -1;
+    }
+    if (!e->gen_valid || e->gen[0] != *decode_gen_of(pc) ||
+        e->gen[1] != *decode_gen_of(e->end_pc - 1)) {
+        if (memcmp(g2h_untagged(pc), e->bytes, e->end_pc - pc)) {
+            ir1_cache_remove(e);
+            return -1;
+        }
+        ir1_cache_set_gen(e);
+    }
+
+    memcpy(info, e->info, e->ir1_num * sizeof(struct la_dt_insn));
+    for (int i = 0; i < e->ir1_num; i++) {
+        list[i] = e->ir1[i];
+        list[i].info = &info[i];
+    }
+    QTAILQ_REMOVE(&ir1_cache_lru, e, lru);
+    QTAILQ_INSERT_HEAD(&ir1_cache_lru, e, lru);
+    *end_pc = e->end_pc;
+    return e->ir1_num;
+}
+#endif
+
 IR1_INST *get_ir1_list(struct TranslationBlock *tb, ADDRX pc, int max_insns)
 {
-    static uint8_t inst_cache[TCG_MAX_INSNS];
-    uint8_t  *pins = inst_cache;
     IR1_INST *pir1 = NULL;
     void *pir1_base = insn_info;
     ADDRX start_pc = pc;
+    int base_idx = 0;
+    bool hot_trace = false;
+    bool broken = false;
+    int ir1_num = -1;
+#ifdef CONFIG_LATX_DECODE_CACHE
+    bool cached = false;
+#endif
 
 #ifdef CONFIG_LATX_TU
     /* TODO */
@@ -179,6 +651,7 @@ IR1_INST *get_ir1_list(struct TranslationBlock *tb, ADDRX pc, int max_insns)
         *ir1_num_in_tu = 0;
     }
     IR1_INST *ir1_list = ir1_list_rel + (*ir1_num_in_tu);
+    base_idx = *ir1_num_in_tu;
 #endif
 
     if (max_insns == 1) {
@@ -196,56 +669,36 @@ IR1_INST *get_ir1_list(struct TranslationBlock *tb, ADDRX pc, int max_insns)
     }
 #endif
 
-    int ir1_num = 0;
-    do {
-        /* read 32 instructioin bytes */
-        lsassert(lsenv->cpu_state != NULL);
-        /*
-         * Wine-6.0 implement try/except via C code. So there has chance to access some
-         * iliigal address, such as 0.
-         * LATX need to identify this kind of address via qemu cpu_ldub_code api to handle
-         * this scenario.
-         * Here are some side effect for this solution, performance might be downgrade if
-         * running some benchmarks.
-         * TODO: To fix it completely, it's better to use cpu_ldub_code inside capstone to
-         * avoid perforamnce downgrade.
-         */
-        pins = inst_cache;
-
-        int max_insn_len = get_insn_len_readable(pc);
-        for (int i = 0; i < max_insn_len; ++i) {
-            *pins = cpu_read_code_via_qemu(lsenv->cpu_state, pc + i);
-            pins++;
-        }
-        /* disasemble this instruction */
-        pir1 = &ir1_list[ir1_num];
-        /* get next pc */
-#ifdef CONFIG_LATX_TU
-        pc = ir1_disasm(pir1, inst_cache, pc, *ir1_num_in_tu + ir1_num, pir1_base);
-#else
-        pc = ir1_disasm(pir1, inst_cache, pc, ir1_num, pir1_base);
+#ifdef CONFIG_LATX_HOT_TRACE
+    hot_trace = tb->bool_flags & IS_HOT_TRACE;
 #endif
-        if (pir1->info == NULL) {
-#if defined(CONFIG_LATX_TU)
-            tb->s_data->tu_tb_mode = TU_TB_MODE_BROKEN;
-            tb->next_pc = tb->pc;
+#ifdef CONFIG_LATX_PREDECODE
+    ir1_num = ir1_take_predecoded(ir1_list, pir1_base, base_idx, pc,
+                                  max_insns, hot_trace, &pc);
 #endif
-            break;
-        }
-        ir1_num++;
-        lsassert(ir1_num <= 255);
-
-        /* check if TB is too large */
-#ifdef CONFIG_LATX_DEBUG
-        if (ir1_num == max_insns) {
-#else
-        if (ir1_num == max_insns && !ir1_is_tb_ending(pir1)) {
+#ifdef CONFIG_LATX_DECODE_CACHE
+    if (ir1_num < 0 && option_decode_cache) {
+        ir1_num = ir1_cache_take(ir1_list, pir1_base, base_idx, pc,
+                                 max_insns, hot_trace, &pc);
+        cached = ir1_num >= 0;
+    }
 #endif
-            pc = ir1_addr(pir1);
-            ir1_make_ins_JMP(pir1, pc, 0);
-            break;
-        }
-    } while (!ir1_is_tb_ending(pir1));
+    if (ir1_num < 0) {
+        ir1_num = ir1_decode_tb(ir1_list, pir1_base, base_idx, pc, max_insns,
+                                hot_trace, NULL, 0, &pc, &broken);
+    }
+#ifdef CONFIG_LATX_DECODE_CACHE
+    if (option_decode_cache && !cached && !broken && ir1_num > 0) {
+        ir1_cache_insert(ir1_list, ir1_num, start_pc, pc, max_insns,
+                         hot_trace);
+    }
+#endif
+    if (broken) {
+#if defined(CONFIG_LATX_TU)
+        tb->s_data->tu_tb_mode = TU_TB_MODE_BROKEN;
+        tb->next_pc = tb->pc;
+#endif
+    }
     tb->size = pc - start_pc;
     tb->icount = ir1_num;
 #if defined(CONFIG_LATX_TU) || defined(CONFIG_LATX_AOT)
@@ -262,7 +715,8 @@ IR1_INST *get_ir1_list(struct TranslationBlock *tb, ADDRX pc, int max_insns)
         next_pir1->info = NULL;
     }
 #endif
-    if (pir1->info != NULL && ir1_num == 2 && ir1_is_return(pir1) &&
+    pir1 = &ir1_list[ir1_num - 1];
+    if (!broken && ir1_num == 2 && ir1_is_return(pir1) &&
         ir1_opcode(&ir1_list[0]) == dt_X86_INS_MOV) {
         IR1_INST *insert_ir1 = &ir1_list[0];
         IR1_OPND *opnd1 = ir1_get_opnd(insert_ir1, 1);
@@ -282,6 +736,21 @@ IR1_INST *get_ir1_list(struct TranslationBlock *tb, ADDRX pc, int max_insns)
     return ir1_list;
 }
 
+/*
+ * Decode the single insn at pc into pir1 without touching the IR1 list of
+ * the TB being translated, info is a caller owned IR1_INST_SIZE buffer.
+ * Returns the pc of the next insn, pir1->info is NULL if pc does not
+ * decode.
+ */
+ADDRX tr_peek_ir1(IR1_INST *pir1, ADDRX pc, void *info)
+{
+    uint8_t inst_cache[X86_INSN_WINDOW + 1] = {0};
+    ADDRX readable_page = -1;
+
+    cpu_read_insn_via_qemu(lsenv->cpu_state, pc, inst_cache, &readable_page);
+    return ir1_disasm(pir1, inst_cache, pc, 0, info);
+}
+
 #if defined CONFIG_LATX_FLAG_REDUCTION && \
     defined(CONFIG_LATX_FLAG_REDUCTION_EXTEND)
 int8 get_etb_type(IR1_INST *pir1)
@@ -307,11 +776,31 @@ int8 get_etb_type(IR1_INST *pir1)
 }
 #endif
 
+/*
+ * cpu->tcg_cflags as seen by the translator. Reading it marks the TB as
+ * depending on CF_PARALLEL, TBs that never do are kept as they are when
+ * the guest starts its first thread (see tb_enter_parallel).
+ */
+uint32_t tr_cflags(CPUState *cpu)
+{
+    TranslationBlock *tb = lsenv->tr_data->curr_tb;
+    if (tb) {
+        tb->bool_flags |= IS_PARALLEL_DEP;
+    }
+    return cpu->tcg_cflags;
+}
+
 void tr_disasm(struct TranslationBlock *ptb, int max_insns)
 {
     ADDRX pc = ptb->pc;
     /* get ir1 instructions */
+#ifdef CONFIG_LATX_PERF
+    latx_timer_start(TIMER_DISASM);
+#endif
     ptb->s_data->ir1 = get_ir1_list(ptb, pc, max_insns);
+#ifdef CONFIG_LATX_PERF
+    latx_timer_stop(TIMER_DISASM);
+#endif
     lsenv->tr_data->curr_ir1_inst = NULL;
 #if defined(CONFIG_LATX_FLAG_REDUCTION) && \
     defined(CONFIG_LATX_FLAG_REDUCTION_EXTEND)
@@ -401,6 +890,10 @@ int label_dispose(TranslationBlock *tb, TRANSLATION_DATA *lat_ctx)
         if (label_id != TB_JMP_RESET_OFFSET_INVALID) {
             tb->jmp_indirect = ir2_label[label_id];
         }
+        label_id = tb->jmp_indirect_jirl;
+        if (label_id != TB_JMP_RESET_OFFSET_INVALID) {
+            tb->jmp_indirect_jirl = ir2_label[label_id];
+        }
 
 #ifdef CONFIG_LATX_TU
         if (in_pre_translate && !(tb->bool_flags & IS_TUNNEL_LIB)) {
@@ -644,6 +1137,17 @@ bool tr_opt_uimm12(IR1_INST *ir1)
 #endif
 }
 
+/* legacy SSE insns keep the high half of the ymm regs with -latx-avx */
+static inline bool tr_reserve_h128(void)
+{
+#ifdef CONFIG_LATX_AVX
+    if (option_avx && option_enable_lasx) {
+        return true;
+    }
+#endif
+    return option_lative && option_enable_lasx;
+}
+
 bool ir1_need_reserve_h128(IR1_INST *ir1)
 {
     if (ir1_get_opnd_num(ir1) == 0)
@@ -1316,6 +1820,251 @@ static bool (*translate_functions[])(IR1_INST *) = {
     TRANS_FUNC_GEN(CRC32, crc32),
     TRANS_FUNC_GEN(PCLMULQDQ, pclmulqdq),
 
+#ifdef CONFIG_LATX_AVX
+    TRANS_FUNC_GEN(VADDPS, vaddps),
+    TRANS_FUNC_GEN(VADDPD, vaddpd),
+    TRANS_FUNC_GEN(VSUBPS, vsubps),
+    TRANS_FUNC_GEN(VSUBPD, vsubpd),
+    TRANS_FUNC_GEN(VMULPS, vmulps),
+    TRANS_FUNC_GEN(VMULPD, vmulpd),
+    TRANS_FUNC_GEN(VDIVPS, vdivps),
+    TRANS_FUNC_GEN(VDIVPD, vdivpd),
+    TRANS_FUNC_GEN(VANDPS, vandps),
+    TRANS_FUNC_GEN(VANDPD, vandpd),
+    TRANS_FUNC_GEN(VANDNPS, vandnps),
+    TRANS_FUNC_GEN(VANDNPD, vandnpd),
+    TRANS_FUNC_GEN(VORPS, vorps),
+    TRANS_FUNC_GEN(VORPD, vorpd),
+    TRANS_FUNC_GEN(VXORPS, vxorps),
+    TRANS_FUNC_GEN(VXORPD, vxorpd),
+    TRANS_FUNC_GEN(VUNPCKLPS, vunpcklps),
+    TRANS_FUNC_GEN(VUNPCKLPD, vunpcklpd),
+    TRANS_FUNC_GEN(VUNPCKHPS, vunpckhps),
+    TRANS_FUNC_GEN(VUNPCKHPD, vunpckhpd),
+    TRANS_FUNC_GEN(VPADDB, vpaddb),
+    TRANS_FUNC_GEN(VPADDW, vpaddw),
+    TRANS_FUNC_GEN(VPADDD, vpaddd),
+    TRANS_FUNC_GEN(VPADDQ, vpaddq),
+    TRANS_FUNC_GEN(VPSUBB, vpsubb),
+    TRANS_FUNC_GEN(VPSUBW, vpsubw),
+    TRANS_FUNC_GEN(VPSUBD, vpsubd),
+    TRANS_FUNC_GEN(VPSUBQ, vpsubq),
+    TRANS_FUNC_GEN(VPADDSB, vpaddsb),
+    TRANS_FUNC_GEN(VPADDSW, vpaddsw),
+    TRANS_FUNC_GEN(VPADDUSB, vpaddusb),
+    TRANS_FUNC_GEN(VPADDUSW, vpaddusw),
+    TRANS_FUNC_GEN(VPSUBSB, vpsubsb),
+    TRANS_FUNC_GEN(VPSUBSW, vpsubsw),
+    TRANS_FUNC_GEN(VPSUBUSB, vpsubusb),
+    TRANS_FUNC_GEN(VPSUBUSW, vpsubusw),
+    TRANS_FUNC_GEN(VPAND, vpand),
+    TRANS_FUNC_GEN(VPANDN, vpandn),
+    TRANS_FUNC_GEN(VPOR, vpor),
+    TRANS_FUNC_GEN(VPXOR, vpxor),
+    TRANS_FUNC_GEN(VPCMPEQB, vpcmpeqb),
+    TRANS_FUNC_GEN(VPCMPEQW, vpcmpeqw),
+    TRANS_FUNC_GEN(VPCMPEQD, vpcmpeqd),
+    TRANS_FUNC_GEN(VPCMPEQQ, vpcmpeqq),
+    TRANS_FUNC_GEN(VPCMPGTB, vpcmpgtb),
+    TRANS_FUNC_GEN(VPCMPGTW, vpcmpgtw),
+    TRANS_FUNC_GEN(VPCMPGTD, vpcmpgtd),
+    TRANS_FUNC_GEN(VPCMPGTQ, vpcmpgtq),
+    TRANS_FUNC_GEN(VPMAXSB, vpmaxsb),
+    TRANS_FUNC_GEN(VPMAXSW, vpmaxsw),
+    TRANS_FUNC_GEN(VPMAXSD, vpmaxsd),
+    TRANS_FUNC_GEN(VPMAXUB, vpmaxub),
+    TRANS_FUNC_GEN(VPMAXUW, vpmaxuw),
+    TRANS_FUNC_GEN(VPMAXUD, vpmaxud),
+    TRANS_FUNC_GEN(VPMINSB, vpminsb),
+    TRANS_FUNC_GEN(VPMINSW, vpminsw),
+    TRANS_FUNC_GEN(VPMINSD, vpminsd),
+    TRANS_FUNC_GEN(VPMINUB, vpminub),
+    TRANS_FUNC_GEN(VPMINUW, vpminuw),
+    TRANS_FUNC_GEN(VPMINUD, vpminud),
+    TRANS_FUNC_GEN(VPAVGB, vpavgb),
+    TRANS_FUNC_GEN(VPAVGW, vpavgw),
+    TRANS_FUNC_GEN(VPMULLW, vpmullw),
+    TRANS_FUNC_GEN(VPMULLD, vpmulld),
+    TRANS_FUNC_GEN(VPMULHW, vpmulhw),
+    TRANS_FUNC_GEN(VPMULHUW, vpmulhuw),
+    TRANS_FUNC_GEN(VPMULDQ, vpmuldq),
+    TRANS_FUNC_GEN(VPMULUDQ, vpmuludq),
+    TRANS_FUNC_GEN(VPUNPCKLBW, vpunpcklbw),
+    TRANS_FUNC_GEN(VPUNPCKLWD, vpunpcklwd),
+    TRANS_FUNC_GEN(VPUNPCKLDQ, vpunpckldq),
+    TRANS_FUNC_GEN(VPUNPCKLQDQ, vpunpcklqdq),
+    TRANS_FUNC_GEN(VPUNPCKHBW, vpunpckhbw),
+    TRANS_FUNC_GEN(VPUNPCKHWD, vpunpckhwd),
+    TRANS_FUNC_GEN(VPUNPCKHDQ, vpunpckhdq),
+    TRANS_FUNC_GEN(VPUNPCKHQDQ, vpunpckhqdq),
+    TRANS_FUNC_GEN(VMAXPS, vmaxps),
+    TRANS_FUNC_GEN(VMAXPD, vmaxpd),
+    TRANS_FUNC_GEN(VMINPS, vminps),
+    TRANS_FUNC_GEN(VMINPD, vminpd),
+    TRANS_FUNC_GEN(VSQRTPS, vsqrtps),
+    TRANS_FUNC_GEN(VSQRTPD, vsqrtpd),
+    TRANS_FUNC_GEN(VCVTDQ2PS, vcvtdq2ps),
+    TRANS_FUNC_GEN(VADDSS, vaddss),
+    TRANS_FUNC_GEN(VADDSD, vaddsd),
+    TRANS_FUNC_GEN(VSUBSS, vsubss),
+    TRANS_FUNC_GEN(VSUBSD, vsubsd),
+    TRANS_FUNC_GEN(VMULSS, vmulss),
+    TRANS_FUNC_GEN(VMULSD, vmulsd),
+    TRANS_FUNC_GEN(VDIVSS, vdivss),
+    TRANS_FUNC_GEN(VDIVSD, vdivsd),
+    TRANS_FUNC_GEN(VSQRTSS, vsqrtss),
+    TRANS_FUNC_GEN(VSQRTSD, vsqrtsd),
+    TRANS_FUNC_GEN(VPSLLW, vpsllw),
+    TRANS_FUNC_GEN(VPSLLD, vpslld),
+    TRANS_FUNC_GEN(VPSLLQ, vpsllq),
+    TRANS_FUNC_GEN(VPSRLW, vpsrlw),
+    TRANS_FUNC_GEN(VPSRLD, vpsrld),
+    TRANS_FUNC_GEN(VPSRLQ, vpsrlq),
+    TRANS_FUNC_GEN(VPSRAW, vpsraw),
+    TRANS_FUNC_GEN(VPSRAD, vpsrad),
+    TRANS_FUNC_GEN(VPSLLVD, vpsllvd),
+    TRANS_FUNC_GEN(VPSLLVQ, vpsllvq),
+    TRANS_FUNC_GEN(VPSRLVD, vpsrlvd),
+    TRANS_FUNC_GEN(VPSRLVQ, vpsrlvq),
+    TRANS_FUNC_GEN(VPSRAVD, vpsravd),
+    TRANS_FUNC_GEN(VPSLLDQ, vpslldq),
+    TRANS_FUNC_GEN(VPSRLDQ, vpsrldq),
+    TRANS_FUNC_GEN(VMOVAPS, vmovaps),
+    TRANS_FUNC_GEN(VMOVAPD, vmovapd),
+    TRANS_FUNC_GEN(VMOVUPS, vmovups),
+    TRANS_FUNC_GEN(VMOVUPD, vmovupd),
+    TRANS_FUNC_GEN(VMOVDQA, vmovdqa),
+    TRANS_FUNC_GEN(VMOVDQU, vmovdqu),
+    TRANS_FUNC_GEN(VLDDQU, vlddqu),
+    TRANS_FUNC_GEN(VMOVNTDQA, vmovntdqa),
+    TRANS_FUNC_GEN(VMOVNTDQ, vmovntdq),
+    TRANS_FUNC_GEN(VMOVNTPS, vmovntps),
+    TRANS_FUNC_GEN(VMOVNTPD, vmovntpd),
+    TRANS_FUNC_GEN(VMOVD, vmovd),
+    TRANS_FUNC_GEN(VMOVQ, vmovq),
+    TRANS_FUNC_GEN(VMOVSS, vmovss),
+    TRANS_FUNC_GEN(VMOVSD, vmovsd),
+    TRANS_FUNC_GEN(VPBROADCASTB, vpbroadcastb),
+    TRANS_FUNC_GEN(VPBROADCASTW, vpbroadcastw),
+    TRANS_FUNC_GEN(VPBROADCASTD, vpbroadcastd),
+    TRANS_FUNC_GEN(VPBROADCASTQ, vpbroadcastq),
+    TRANS_FUNC_GEN(VBROADCASTSS, vbroadcastss),
+    TRANS_FUNC_GEN(VBROADCASTSD, vbroadcastsd),
+    TRANS_FUNC_GEN(VBROADCASTF128, vbroadcastf128),
+    TRANS_FUNC_GEN(VBROADCASTI128, vbroadcasti128),
+    TRANS_FUNC_GEN(VINSERTF128, vinsertf128),
+    TRANS_FUNC_GEN(VINSERTI128, vinserti128),
+    TRANS_FUNC_GEN(VEXTRACTF128, vextractf128),
+    TRANS_FUNC_GEN(VEXTRACTI128, vextracti128),
+    TRANS_FUNC_GEN(VPERM2F128, vperm2f128),
+    TRANS_FUNC_GEN(VPERM2I128, vperm2i128),
+    TRANS_FUNC_GEN(VPERMQ, vpermq),
+    TRANS_FUNC_GEN(VPERMPD, vpermpd),
+    TRANS_FUNC_GEN(VPERMD, vpermd),
+    TRANS_FUNC_GEN(VPERMPS, vpermps),
+    TRANS_FUNC_GEN(VPSHUFD, vpshufd),
+    TRANS_FUNC_GEN(VPSHUFLW, vpshuflw),
+    TRANS_FUNC_GEN(VPSHUFHW, vpshufhw),
+    TRANS_FUNC_GEN(VSHUFPS, vshufps),
+    TRANS_FUNC_GEN(VPSHUFB, vpshufb),
+    TRANS_FUNC_GEN(VPABSB, vpabsb),
+    TRANS_FUNC_GEN(VPABSW, vpabsw),
+    TRANS_FUNC_GEN(VPABSD, vpabsd),
+    TRANS_FUNC_GEN(VPBLENDVB, vpblendvb),
+    TRANS_FUNC_GEN(VBLENDVPS, vblendvps),
+    TRANS_FUNC_GEN(VBLENDVPD, vblendvpd),
+    TRANS_FUNC_GEN(VPMOVMSKB, vpmovmskb),
+    TRANS_FUNC_GEN(VMOVMSKPS, vmovmskps),
+    TRANS_FUNC_GEN(VMOVMSKPD, vmovmskpd),
+    TRANS_FUNC_GEN(VPTEST, vptest),
+    TRANS_FUNC_GEN(VZEROUPPER, vzeroupper),
+    TRANS_FUNC_GEN(VZEROALL, vzeroall),
+    TRANS_FUNC_GEN(VUCOMISS, vucomiss),
+    TRANS_FUNC_GEN(VUCOMISD, vucomisd),
+    TRANS_FUNC_GEN(VCOMISS, vcomiss),
+    TRANS_FUNC_GEN(VCOMISD, vcomisd),
+    TRANS_FUNC_GEN(VPEXTRB, vpextrb),
+    TRANS_FUNC_GEN(VPEXTRW, vpextrw),
+    TRANS_FUNC_GEN(VPEXTRD, vpextrd),
+    TRANS_FUNC_GEN(VPEXTRQ, vpextrq),
+    TRANS_FUNC_GEN(VCVTPS2DQ, vcvtps2dq),
+    TRANS_FUNC_GEN(VMOVSHDUP, vmovshdup),
+    TRANS_FUNC_GEN(VMOVSLDUP, vmovsldup),
+    TRANS_FUNC_GEN(VMOVDDUP, vmovddup),
+    TRANS_FUNC_GEN(VPMOVZXBW, vpmovzxbw),
+    TRANS_FUNC_GEN(VPMOVZXBD, vpmovzxbd),
+    TRANS_FUNC_GEN(VPMOVZXBQ, vpmovzxbq),
+    TRANS_FUNC_GEN(VPMOVZXWD, vpmovzxwd),
+    TRANS_FUNC_GEN(VPMOVZXWQ, vpmovzxwq),
+    TRANS_FUNC_GEN(VPMOVZXDQ, vpmovzxdq),
+    TRANS_FUNC_GEN(VPMOVSXBW, vpmovsxbw),
+    TRANS_FUNC_GEN(VPMOVSXBD, vpmovsxbd),
+    TRANS_FUNC_GEN(VPMOVSXBQ, vpmovsxbq),
+    TRANS_FUNC_GEN(VPMOVSXWD, vpmovsxwd),
+    TRANS_FUNC_GEN(VPMOVSXWQ, vpmovsxwq),
+    TRANS_FUNC_GEN(VPMOVSXDQ, vpmovsxdq),
+    TRANS_FUNC_GEN(VFMADD132PS, vfmadd132ps),
+    TRANS_FUNC_GEN(VFMADD132PD, vfmadd132pd),
+    TRANS_FUNC_GEN(VFMADD132SS, vfmadd132ss),
+    TRANS_FUNC_GEN(VFMADD132SD, vfmadd132sd),
+    TRANS_FUNC_GEN(VFMADD213PS, vfmadd213ps),
+    TRANS_FUNC_GEN(VFMADD213PD, vfmadd213pd),
+    TRANS_FUNC_GEN(VFMADD213SS, vfmadd213ss),
+    TRANS_FUNC_GEN(VFMADD213SD, vfmadd213sd),
+    TRANS_FUNC_GEN(VFMADD231PS, vfmadd231ps),
+    TRANS_FUNC_GEN(VFMADD231PD, vfmadd231pd),
+    TRANS_FUNC_GEN(VFMADD231SS, vfmadd231ss),
+    TRANS_FUNC_GEN(VFMADD231SD, vfmadd231sd),
+    TRANS_FUNC_GEN(VFMSUB132PS, vfmsub132ps),
+    TRANS_FUNC_GEN(VFMSUB132PD, vfmsub132pd),
+    TRANS_FUNC_GEN(VFMSUB132SS, vfmsub132ss),
+    TRANS_FUNC_GEN(VFMSUB132SD, vfmsub132sd),
+    TRANS_FUNC_GEN(VFMSUB213PS, vfmsub213ps),
+    TRANS_FUNC_GEN(VFMSUB213PD, vfmsub213pd),
+    TRANS_FUNC_GEN(VFMSUB213SS, vfmsub213ss),
+    TRANS_FUNC_GEN(VFMSUB213SD, vfmsub213sd),
+    TRANS_FUNC_GEN(VFMSUB231PS, vfmsub231ps),
+    TRANS_FUNC_GEN(VFMSUB231PD, vfmsub231pd),
+    TRANS_FUNC_GEN(VFMSUB231SS, vfmsub231ss),
+    TRANS_FUNC_GEN(VFMSUB231SD, vfmsub231sd),
+    TRANS_FUNC_GEN(VFNMADD132PS, vfnmadd132ps),
+    TRANS_FUNC_GEN(VFNMADD132PD, vfnmadd132pd),
+    TRANS_FUNC_GEN(VFNMADD132SS, vfnmadd132ss),
+    TRANS_FUNC_GEN(VFNMADD132SD, vfnmadd132sd),
+    TRANS_FUNC_GEN(VFNMADD213PS, vfnmadd213ps),
+    TRANS_FUNC_GEN(VFNMADD213PD, vfnmadd213pd),
+    TRANS_FUNC_GEN(VFNMADD213SS, vfnmadd213ss),
+    TRANS_FUNC_GEN(VFNMADD213SD, vfnmadd213sd),
+    TRANS_FUNC_GEN(VFNMADD231PS, vfnmadd231ps),
+    TRANS_FUNC_GEN(VFNMADD231PD, vfnmadd231pd),
+    TRANS_FUNC_GEN(VFNMADD231SS, vfnmadd231ss),
+    TRANS_FUNC_GEN(VFNMADD231SD, vfnmadd231sd),
+    TRANS_FUNC_GEN(VFNMSUB132PS, vfnmsub132ps),
+    TRANS_FUNC_GEN(VFNMSUB132PD, vfnmsub132pd),
+    TRANS_FUNC_GEN(VFNMSUB132SS, vfnmsub132ss),
+    TRANS_FUNC_GEN(VFNMSUB132SD, vfnmsub132sd),
+    TRANS_FUNC_GEN(VFNMSUB213PS, vfnmsub213ps),
+    TRANS_FUNC_GEN(VFNMSUB213PD, vfnmsub213pd),
+    TRANS_FUNC_GEN(VFNMSUB213SS, vfnmsub213ss),
+    TRANS_FUNC_GEN(VFNMSUB213SD, vfnmsub213sd),
+    TRANS_FUNC_GEN(VFNMSUB231PS, vfnmsub231ps),
+    TRANS_FUNC_GEN(VFNMSUB231PD, vfnmsub231pd),
+    TRANS_FUNC_GEN(VFNMSUB231SS, vfnmsub231ss),
+    TRANS_FUNC_GEN(VFNMSUB231SD, vfnmsub231sd),
+    TRANS_FUNC_GEN(VFMADDSUB132PS, vfmaddsub132ps),
+    TRANS_FUNC_GEN(VFMADDSUB132PD, vfmaddsub132pd),
+    TRANS_FUNC_GEN(VFMADDSUB213PS, vfmaddsub213ps),
+    TRANS_FUNC_GEN(VFMADDSUB213PD, vfmaddsub213pd),
+    TRANS_FUNC_GEN(VFMADDSUB231PS, vfmaddsub231ps),
+    TRANS_FUNC_GEN(VFMADDSUB231PD, vfmaddsub231pd),
+    TRANS_FUNC_GEN(VFMSUBADD132PS, vfmsubadd132ps),
+    TRANS_FUNC_GEN(VFMSUBADD132PD, vfmsubadd132pd),
+    TRANS_FUNC_GEN(VFMSUBADD213PS, vfmsubadd213ps),
+    TRANS_FUNC_GEN(VFMSUBADD213PD, vfmsubadd213pd),
+    TRANS_FUNC_GEN(VFMSUBADD231PS, vfmsubadd231ps),
+    TRANS_FUNC_GEN(VFMSUBADD231PD, vfmsubadd231pd),
+#endif
+
 #define TRANSLATE_TABLE
     #include "insts_pattern_table.h"
 #undef TRANSLATE_TABLE
@@ -1367,7 +2116,7 @@ bool ir1_translate(IR1_INST *ir1)
     /*sse instructions need to reserve h128 bit of ymm\
         if support avx instructions*/
     IR2_OPND temp = ir2_opnd_new_none();
-    if (option_lative && option_enable_lasx && ir1_need_reserve_h128(ir1)) {
+    if (tr_reserve_h128() && ir1_need_reserve_h128(ir1)) {
         temp = save_h128_of_ymm(ir1);
     }
 
@@ -1407,7 +2156,7 @@ bool ir1_translate(IR1_INST *ir1)
     }
 
     /*restore h128 bit of ymm after translating sse instructions*/
-    if (option_lative && option_enable_lasx && temp._type != IR2_OPND_NONE) {
+    if (tr_reserve_h128() && temp._type != IR2_OPND_NONE) {
         restore_h128_of_ymm(ir1, temp);
     }
 
@@ -1478,48 +2227,72 @@ static inline void tr_init_for_each_ir1_in_tb(IR1_INST *pir1, int nr, int index)
 }
 
 bool need_trace;
-static unsigned long tb_checksum(const uint8_t * start, size_t len)
+/*
+ * Guest code of a TB on a shared page is checked on entry against the
+ * bytes it was translated from. Blocks up to CHECKSUM_CMP_MAX_LEN bytes
+ * compare their 8-byte words with immediates, larger ones fold the words
+ * with a multiply-rotate hash. A tail shorter than 8 bytes is loaded as the
+ * overlapping last word, or masked when the whole block is that short.
+ */
+#define CHECKSUM_CMP_MAX_LEN  32
+#define CHECKSUM_SEED         0xcbf29ce484222325ULL
+#define CHECKSUM_MUL          0x9e3779b97f4a7c15ULL
+#define CHECKSUM_ROT          31
+
+static inline uint64_t checksum_word(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return le64_to_cpu(w);
+}
+
+static inline uint64_t checksum_mix(uint64_t h, uint64_t w)
+{
+    return ror64((h ^ w) * CHECKSUM_MUL, CHECKSUM_ROT);
+}
+
+/* the word at off of a block shorter than 8 bytes, masked to its bytes */
+static uint64_t checksum_short_word(const uint8_t *start, size_t len,
+                                    int *off, int *shift)
 {
-    unsigned long checksum = 0;
-    for (int i = 0; i < len; i ++) {
-        checksum += start[i];
+    uint64_t w = 0;
+
+    if (((uintptr_t)start & ~TARGET_PAGE_MASK) + 8 <= TARGET_PAGE_SIZE) {
+        /* the 8 bytes from start stay in its page, keep the low bytes */
+        *off = 0;
+        *shift = 0;
+        memcpy(&w, start, len);
+    } else {
+        /* ends near the page end, load the word ending there, keep high */
+        *off = len - 8;
+        *shift = (8 - len) * 8;
+        memcpy((uint8_t *)&w + (8 - len), start, len);
     }
-    return checksum;
+    return le64_to_cpu(w);
 }
-static void tr_check_x86ins_change(struct TranslationBlock *tb)
+
+static unsigned long tb_checksum(const uint8_t * start, size_t len)
 {
-    size_t checksum_len = ir1_addr_next(tb_ir1_inst_last(tb)) - tb->pc;
-    IR2_OPND checksum_tmp_d = ra_alloc_itemp();
-    IR2_OPND checksum_tmp_sum = ra_alloc_itemp();
-    IR2_OPND checksum_start = ra_alloc_itemp();
-    IR2_OPND tb_opnd = ra_alloc_itemp();
-    IR2_OPND checksum_tmp_len = ra_alloc_itemp();
-    IR2_OPND sum_loop = ra_alloc_label();
+    uint64_t h = CHECKSUM_SEED;
+    size_t i;
 
-    aot_load_host_addr(tb_opnd, (ADDR)tb, LOAD_TB_ADDR, 0);
-    /* tb_checksum*/
-    la_ld_d(checksum_start, tb_opnd, offsetof(struct TranslationBlock, pc));
-    li_d(checksum_tmp_sum , 0);
-    li_d(checksum_tmp_len, checksum_len - 1);
-    la_label(sum_loop);
-    la_ld_bu(checksum_tmp_d, checksum_start, 0);
-    la_add(checksum_tmp_sum, checksum_tmp_sum, checksum_tmp_d);
-    la_addi_d(checksum_tmp_len, checksum_tmp_len, -1);
-    la_addi_d(checksum_start, checksum_start, 1);
-    la_bge(checksum_tmp_len, zero_ir2_opnd,sum_loop);
-    ra_free_temp(checksum_tmp_len);
+    for (i = 0; i + 8 <= len; i += 8) {
+        h = checksum_mix(h, checksum_word(start + i));
+    }
+    if (i < len) {
+        h = checksum_mix(h, checksum_word(start + len - 8));
+    }
+    return h;
+}
 
-    ra_free_temp(checksum_start);
-    ra_free_temp(checksum_tmp_d);
-    IR2_OPND checksum = ra_alloc_itemp();
-    IR2_OPND check_suc = ra_alloc_label();
-    li_d(checksum, tb_checksum((const uint8_t *)(uintptr_t)tb->pc, checksum_len));
-    la_beq(checksum ,checksum_tmp_sum, check_suc);
-    ra_free_temp(checksum_tmp_sum);
-    ra_free_temp(checksum);
-    //env->checksum_fail_tb = tb;
-    la_st_d(tb_opnd, env_ir2_opnd,
-          offsetof(CPUX86State, checksum_fail_tb));
+/*
+ * Leave tb before its first insn with eip = tb->pc, storing tb to the
+ * env field at env_off for cpu_tb_exec() to handle.
+ */
+static void tr_exit_tb_at_entry(struct TranslationBlock *tb,
+                                IR2_OPND tb_opnd, int env_off)
+{
+    la_st_d(tb_opnd, env_ir2_opnd, env_off);
     IR2_OPND base = ra_alloc_data();
     IR2_OPND target = ra_alloc_data();
     IR2_OPND eip_opnd = ra_alloc_dbt_arg2();
@@ -1531,10 +2304,180 @@ static void tr_check_x86ins_change(struct TranslationBlock *tb)
     la_data_li(base, (ADDR)tb->tc.ptr);
     la_data_li(target, context_switch_native_to_bt);
     aot_la_append_ir2_jmp_far(target, base, B_EPILOGUE, 0);
+}
+
+static void tr_check_x86ins_change(struct TranslationBlock *tb)
+{
+    const uint8_t *guest = (const uint8_t *)(uintptr_t)tb->pc;
+    size_t checksum_len = ir1_addr_next(tb_ir1_inst_last(tb)) - tb->pc;
+    IR2_OPND tb_opnd = ra_alloc_itemp();
+    IR2_OPND checksum_start = ra_alloc_itemp();
+    IR2_OPND checksum_tmp_d = ra_alloc_itemp();
+    IR2_OPND checksum = ra_alloc_itemp();
+    IR2_OPND check_fail = ra_alloc_label();
+    IR2_OPND check_suc = ra_alloc_label();
+
+    aot_load_host_addr(tb_opnd, (ADDR)tb, LOAD_TB_ADDR, 0);
+    la_ld_d(checksum_start, tb_opnd, offsetof(struct TranslationBlock, pc));
+
+    if (checksum_len < 8) {
+        int off, shift;
+        uint64_t w = checksum_short_word(guest, checksum_len, &off, &shift);
+        la_ld_d(checksum_tmp_d, checksum_start, off);
+        if (shift) {
+            la_srli_d(checksum_tmp_d, checksum_tmp_d, shift);
+        } else {
+            la_bstrpick_d(checksum_tmp_d, checksum_tmp_d,
+                          checksum_len * 8 - 1, 0);
+        }
+        li_d(checksum_start, w >> shift);
+        la_bne(checksum_tmp_d, checksum_start, check_fail);
+    } else if (checksum_len <= CHECKSUM_CMP_MAX_LEN) {
+        for (size_t i = 0; i < checksum_len; i += 8) {
+            size_t off = MIN(i, checksum_len - 8);
+            la_ld_d(checksum_tmp_d, checksum_start, off);
+            li_d(checksum, checksum_word(guest + off));
+            la_bne(checksum_tmp_d, checksum, check_fail);
+        }
+    } else {
+        IR2_OPND checksum_len_opnd = ra_alloc_itemp();
+        IR2_OPND checksum_mul = ra_alloc_itemp();
+        IR2_OPND sum_loop = ra_alloc_label();
+
+        li_d(checksum, CHECKSUM_SEED);
+        li_d(checksum_mul, CHECKSUM_MUL);
+        li_d(checksum_len_opnd, checksum_len / 8);
+        la_label(sum_loop);
+        la_ld_d(checksum_tmp_d, checksum_start, 0);
+        la_xor(checksum, checksum, checksum_tmp_d);
+        la_mul_d(checksum, checksum, checksum_mul);
+        la_rotri_d(checksum, checksum, CHECKSUM_ROT);
+        la_addi_d(checksum_len_opnd, checksum_len_opnd, -1);
+        la_addi_d(checksum_start, checksum_start, 8);
+        la_bne(checksum_len_opnd, zero_ir2_opnd, sum_loop);
+        if (checksum_len % 8) {
+            /* the overlapping last word */
+            la_ld_d(checksum_tmp_d, checksum_start,
+                    (int)(checksum_len % 8) - 8);
+            la_xor(checksum, checksum, checksum_tmp_d);
+            la_mul_d(checksum, checksum, checksum_mul);
+            la_rotri_d(checksum, checksum, CHECKSUM_ROT);
+        }
+        ra_free_temp(checksum_len_opnd);
+        li_d(checksum_mul, tb_checksum(guest, checksum_len));
+        la_bne(checksum, checksum_mul, check_fail);
+        ra_free_temp(checksum_mul);
+    }
+    la_b(check_suc);
+    ra_free_temp(checksum_start);
+    ra_free_temp(checksum_tmp_d);
+    ra_free_temp(checksum);
+
+    la_label(check_fail);
+    //env->checksum_fail_tb = tb;
+    tr_exit_tb_at_entry(tb, tb_opnd, offsetof(CPUX86State, checksum_fail_tb));
     la_label(check_suc);
     ra_free_temp(tb_opnd);
 }
 
+#ifdef CONFIG_LATX_HOT_TRACE
+/*
+ * Count down tb->hot_count at the entry of tb, when it runs out the
+ * dispatcher invalidates tb and its pc is retranslated as a hot trace.
+ */
+static void tr_hot_trace_count(struct TranslationBlock *tb)
+{
+    IR2_OPND tb_opnd = ra_alloc_itemp();
+    IR2_OPND count = ra_alloc_itemp();
+    IR2_OPND not_hot = ra_alloc_label();
+
+    aot_load_host_addr(tb_opnd, (ADDR)tb, LOAD_TB_ADDR, 0);
+    la_ld_w(count, tb_opnd, offsetof(struct TranslationBlock, hot_count));
+    la_addi_w(count, count, -1);
+    la_st_w(count, tb_opnd, offsetof(struct TranslationBlock, hot_count));
+    la_bne(count, zero_ir2_opnd, not_hot);
+    ra_free_temp(count);
+    //env->hot_tb = tb;
+    tr_exit_tb_at_entry(tb, tb_opnd, offsetof(CPUX86State, hot_tb));
+    la_label(not_hot);
+    ra_free_temp(tb_opnd);
+}
+#endif
+
+/*
+ * Guest memory accesses of ir1 for the TSO fence mode. Implicit accesses
+ * and operands without access info count as both read and write.
+ */
+static int ir1_mem_access(IR1_INST *ir1)
+{
+    int access = 0;
+
+    switch (ir1_opcode(ir1)) {
+    case dt_X86_INS_LEA:
+    case dt_X86_INS_NOP:
+    case dt_X86_INS_PREFETCH:
+    case dt_X86_INS_PREFETCHNTA:
+    case dt_X86_INS_PREFETCHT0:
+    case dt_X86_INS_PREFETCHT1:
+    case dt_X86_INS_PREFETCHT2:
+    case dt_X86_INS_PREFETCHW:
+        return 0;
+    case dt_X86_INS_PUSH:
+    case dt_X86_INS_PUSHAL:
+    case dt_X86_INS_PUSHAW:
+    case dt_X86_INS_PUSHF:
+    case dt_X86_INS_PUSHFD:
+    case dt_X86_INS_PUSHFQ:
+    case dt_X86_INS_POP:
+    case dt_X86_INS_POPAL:
+    case dt_X86_INS_POPAW:
+    case dt_X86_INS_POPF:
+    case dt_X86_INS_POPFD:
+    case dt_X86_INS_POPFQ:
+    case dt_X86_INS_CALL:
+    case dt_X86_INS_RET:
+    case dt_X86_INS_RETF:
+    case dt_X86_INS_IRET:
+    case dt_X86_INS_IRETD:
+    case dt_X86_INS_IRETQ:
+    case dt_X86_INS_LEAVE:
+    case dt_X86_INS_ENTER:
+    case dt_X86_INS_MOVSB:
+    case dt_X86_INS_MOVSW:
+    case dt_X86_INS_MOVSD:
+    case dt_X86_INS_MOVSQ:
+    case dt_X86_INS_STOSB:
+    case dt_X86_INS_STOSW:
+    case dt_X86_INS_STOSD:
+    case dt_X86_INS_STOSQ:
+    case dt_X86_INS_LODSB:
+    case dt_X86_INS_LODSW:
+    case dt_X86_INS_LODSD:
+    case dt_X86_INS_LODSQ:
+    case dt_X86_INS_CMPSB:
+    case dt_X86_INS_CMPSW:
+    case dt_X86_INS_CMPSD:
+    case dt_X86_INS_CMPSQ:
+    case dt_X86_INS_SCASB:
+    case dt_X86_INS_SCASW:
+    case dt_X86_INS_SCASD:
+    case dt_X86_INS_SCASQ:
+    case dt_X86_INS_XLATB:
+        return dt_CS_AC_READ | dt_CS_AC_WRITE;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < ir1_get_opnd_num(ir1); ++i) {
+        IR1_OPND *opnd = ir1_get_opnd(ir1, i);
+        if (ir1_opnd_is_mem(opnd)) {
+            access |= opnd->access ? opnd->access
+                                   : dt_CS_AC_READ | dt_CS_AC_WRITE;
+        }
+    }
+    return access;
+}
+
 int tr_ir2_generate(struct TranslationBlock *tb)
 {
     int i;
@@ -1560,6 +2503,12 @@ int tr_ir2_generate(struct TranslationBlock *tb)
     if (option_monitor_shared_mem && tb->checksum) {
         tr_check_x86ins_change(tb);
     }
+#ifdef CONFIG_LATX_HOT_TRACE
+    if (option_hot_trace && !option_aot && hot_trace_can_extend(tb) &&
+        !(tb->bool_flags & IS_HOT_TRACE)) {
+        tr_hot_trace_count(tb);
+    }
+#endif
 #ifdef CONFIG_LATX_IMM_REG
     /**
      * 1.precache ir1 list before translate ir2
@@ -1635,6 +2584,13 @@ int tr_ir2_generate(struct TranslationBlock *tb)
         }
     }
 #endif
+    /*
+     * TSO fence mode: a store waits for all earlier accesses and a load
+     * holds back all later ones. TBs start with an acquire for the loads
+     * of the TB before, ir2_opt_fence merges neighbouring fences.
+     */
+    bool tso = option_fence == FENCE_TSO &&
+               (tr_cflags(env_cpu(lsenv->cpu_state)) & CF_PARALLEL);
     for (i = 0; i < ir1_nr; ++i) {
         /*
          * handle segv scenario, store host pc to gen_insn_data and encode to a BYTE
@@ -1668,8 +2624,23 @@ int tr_ir2_generate(struct TranslationBlock *tb)
             }
         }
 
+        int mem_access = 0;
+        if (tso && !(pir1->cflag & IR1_INVALID_MASK)) {
+            mem_access = ir1_mem_access(pir1);
+            if (i == 0) {
+                tr_fence(DBAR_ACQUIRE);
+            }
+            if (mem_access & dt_CS_AC_WRITE) {
+                tr_fence(DBAR_RELEASE);
+            }
+        }
+
         bool translation_success =
             (pir1->cflag & IR1_INVALID_MASK) || ir1_translate(pir1);
+        /* the next TB starts with an acquire */
+        if ((mem_access & dt_CS_AC_READ) && i < ir1_nr - 1) {
+            tr_fence(DBAR_ACQUIRE);
+        }
         if (!translation_success) {
 #ifdef CONFIG_LATX_TU
             tb->s_data->tu_tb_mode = BAD_TB;
@@ -1784,6 +2755,9 @@ int tr_translate_tb(struct TranslationBlock *tb)
         qemu_log("tr_init OK. ready to translation.\n");
 
     /* generate ir2 from ir1 */
+#ifdef CONFIG_LATX_PERF
+    latx_timer_start(TIMER_IR2_GEN);
+#endif
 #if defined(CONFIG_LATX_KZT)
     int translation_done = 0;
     if (unlikely(!tb->icount && tb->pc > reserved_va)) {
@@ -1794,6 +2768,9 @@ int tr_translate_tb(struct TranslationBlock *tb)
 #else
     int translation_done = tr_ir2_generate(tb);
 #endif
+#ifdef CONFIG_LATX_PERF
+    latx_timer_stop(TIMER_IR2_GEN);
+#endif
 #ifdef CONFIG_LATX_PROFILER
     qatomic_set(&prof->tr_trans_time,
                 prof->tr_trans_time + profile_getclock() - ti);
@@ -1849,8 +2826,14 @@ int tr_translate_tb(struct TranslationBlock *tb)
         }
 #endif
         /* assemble ir2 to native code */
+#ifdef CONFIG_LATX_PERF
+        latx_timer_start(TIMER_ASSEMBLE);
+#endif
         asm_code_nr =
             tr_ir2_assemble(qm_tb_get_code_cache(tb), lat_ctx->first_ir2);
+#ifdef CONFIG_LATX_PERF
+        latx_timer_stop(TIMER_ASSEMBLE);
+#endif
         lsassert(code_nr == asm_code_nr);
     }
 #ifdef CONFIG_LATX_PROFILER
@@ -1887,7 +2870,33 @@ int tr_translate_tb(struct TranslationBlock *tb)
  * ra_alloc_dbt_arg2: next x86 ip
  */
 
-static void generate_indirect_goto(void *code_buf, bool parallel)
+static void generate_indirect_ic_update(IR2_OPND ic_opnd, IR2_OPND ic_gen,
+                                       IR2_OPND next_x86_addr,
+                                       IR2_OPND jmp_entry)
+{
+    IR2_OPND temp = ra_alloc_itemp();
+
+    /* way0 -> way1, the new target goes to way0 */
+    la_ld_d(temp, ic_opnd, offsetof(IndirectIC, pc[0]));
+    la_st_d(temp, ic_opnd, offsetof(IndirectIC, pc[1]));
+    la_ld_d(temp, ic_opnd, offsetof(IndirectIC, ptr[0]));
+    la_st_d(temp, ic_opnd, offsetof(IndirectIC, ptr[1]));
+    la_ld_d(temp, ic_opnd, offsetof(IndirectIC, gen[0]));
+    la_st_d(temp, ic_opnd, offsetof(IndirectIC, gen[1]));
+    la_st_d(next_x86_addr, ic_opnd, offsetof(IndirectIC, pc[0]));
+    la_st_d(jmp_entry, ic_opnd, offsetof(IndirectIC, ptr[0]));
+    la_st_d(ic_gen, ic_opnd, offsetof(IndirectIC, gen[0]));
+
+    ra_free_temp(temp);
+}
+
+/*
+ * ic: per-site prediction, only for the inlined goto of a serial TB.
+ * jirl_label_id: the label of the hit jirl, unlink_indirect_jmp writes
+ * nop on it.
+ */
+static void generate_indirect_goto(void *code_buf, bool parallel,
+                                   IndirectIC *ic, int *jirl_label_id)
 {
     /*
      * WARNING!!!
@@ -1904,6 +2913,54 @@ static void generate_indirect_goto(void *code_buf, bool parallel)
     IR2_OPND next_tb = V0_RENAME_OPND;
     IR2_OPND target = ra_alloc_data();
     IR2_OPND label_miss = ra_alloc_label();
+    IR2_OPND label_hit = ra_alloc_label();
+    IR2_OPND label_jirl = ra_alloc_label();
+    IR2_OPND ic_opnd = zero_ir2_opnd;
+    IR2_OPND ic_gen = zero_ir2_opnd;
+    IR2_OPND label_ic_update = label_hit;
+
+    if (ic) {
+        /*
+         * Step 0: compare with the last two targets of this site. A way
+         * is valid only if no TB of a pc in the bucket of the target was
+         * invalidated since it was filled, see latx_indirect_ic_invalidate.
+         */
+        IR2_OPND label_ic_miss = ra_alloc_label();
+        IR2_OPND label_ic_way1 = ra_alloc_label();
+        ic_opnd = ra_alloc_itemp();
+        ic_gen = ra_alloc_itemp();
+        label_ic_update = ra_alloc_label();
+
+        /* ic_gen = latx_indirect_ic_gen[tb_jmp_cache_hash_func(target)] */
+        la_srli_d(ic_gen, next_x86_addr, TB_JMP_CACHE_BITS);
+        la_xor(ic_gen, next_x86_addr, ic_gen);
+        la_bstrpick_d(ic_gen, ic_gen, TB_JMP_CACHE_BITS - 1, 0);
+        li_d(ic_opnd, (ADDR)latx_indirect_ic_gen);
+        la_alsl_d(ic_gen, ic_gen, ic_opnd, 3);
+        la_ld_d(ic_gen, ic_gen, 0);
+        li_d(ic_opnd, (ADDR)ic);
+
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, pc[0]));
+        la_bne(jmp_entry, next_x86_addr, label_ic_way1);
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, gen[0]));
+        la_bne(jmp_entry, ic_gen, label_ic_miss);
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, ptr[0]));
+        la_b(label_hit);
+
+        la_label(label_ic_way1);
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, pc[1]));
+        la_bne(jmp_entry, next_x86_addr, label_ic_miss);
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, gen[1]));
+        la_bne(jmp_entry, ic_gen, label_ic_miss);
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, ptr[1]));
+        la_b(label_hit);
+
+        la_label(label_ic_miss);
+        la_ld_d(jmp_entry, ic_opnd, offsetof(IndirectIC, miss));
+        la_addi_d(jmp_entry, jmp_entry, 1);
+        la_st_d(jmp_entry, ic_opnd, offsetof(IndirectIC, miss));
+    }
+
     /*
      * lookup HASH_JMP_CACHE
      * Step 1: calculate HASH = (x86_addr >> 12) ^ (x86_addr & 0xfff)
@@ -1915,14 +2972,35 @@ static void generate_indirect_goto(void *code_buf, bool parallel)
      */
     la_srli_d(next_tb, next_x86_addr, TB_JMP_CACHE_BITS);
     la_xor(next_tb, next_x86_addr, next_tb);
-    la_bstrpick_d(next_tb, next_tb, TB_JMP_CACHE_BITS - 1, 0);
 
     if (!close_latx_parallel && !parallel) {
-        la_alsl_d(next_tb, next_tb, jmp_cache_addr, 3);
-        la_ld_d(jmp_entry, next_tb, 0);
+        /*
+         * per-vCPU FastTB {pc, ptr}, option_fast_jmp_ways entries per set,
+         * see latx_fast_jmp_cache_add.
+         */
+        int ways_bits = ctz32(option_fast_jmp_ways);
+        la_bstrpick_d(next_tb, next_tb, TB_JMP_CACHE_BITS - 1 - ways_bits, 0);
+        if (ways_bits) {
+            la_slli_d(next_tb, next_tb, 4 + ways_bits);
+            la_add_d(next_tb, next_tb, jmp_cache_addr);
+        } else {
+            la_alsl_d(next_tb, next_tb, jmp_cache_addr, 3);
+        }
+        for (int way = 0; way < option_fast_jmp_ways - 1; way++) {
+            IR2_OPND label_next_way = ra_alloc_label();
+            la_ld_d(jmp_entry, next_tb, way * sizeof(FastTB));
+            la_bne(jmp_entry, next_x86_addr, label_next_way);
+            la_ld_d(jmp_entry, next_tb, way * sizeof(FastTB) + 8);
+            la_b(label_ic_update);
+            la_label(label_next_way);
+        }
+        la_ld_d(jmp_entry, next_tb,
+                (option_fast_jmp_ways - 1) * sizeof(FastTB));
         la_bne(jmp_entry, next_x86_addr, label_miss);
-        la_ld_d(jmp_entry, next_tb, 8);
+        la_ld_d(jmp_entry, next_tb,
+                (option_fast_jmp_ways - 1) * sizeof(FastTB) + 8);
     } else {
+        la_bstrpick_d(next_tb, next_tb, TB_JMP_CACHE_BITS - 1, 0);
         la_slli_d(next_tb, next_tb, 3);
         la_ldx_d(next_tb, next_tb, jmp_cache_addr);
         la_beq(next_tb, zero_ir2_opnd, label_miss);
@@ -1944,12 +3022,37 @@ static void generate_indirect_goto(void *code_buf, bool parallel)
                 offsetof(struct tb_tc, ptr));
     }
 
+    if (ic) {
+        la_label(label_ic_update);
+        generate_indirect_ic_update(ic_opnd, ic_gen, next_x86_addr, jmp_entry);
+        ra_free_temp(ic_opnd);
+        ra_free_temp(ic_gen);
+    }
+
 /* hit: */
+    la_label(label_hit);
+#ifdef CONFIG_LATX_PROFILER
+    IR2_OPND counter = ra_alloc_itemp();
+    lsassert(lsenv_offset_of_fast_jmp_miss(lsenv) <= 2047);
+    la_ld_d(counter, env_ir2_opnd, lsenv_offset_of_fast_jmp_hit(lsenv));
+    la_addi_d(counter, counter, 1);
+    la_st_d(counter, env_ir2_opnd, lsenv_offset_of_fast_jmp_hit(lsenv));
+#endif
+    la_label(label_jirl);
+    if (jirl_label_id) {
+        *jirl_label_id = ir2_opnd_label_id(&label_jirl);
+    }
     la_jirl(zero_ir2_opnd, jmp_entry, 0);
 
     ra_free_temp(jmp_entry);
 /* miss: */
     la_label(label_miss);
+#ifdef CONFIG_LATX_PROFILER
+    la_ld_d(counter, env_ir2_opnd, lsenv_offset_of_fast_jmp_miss(lsenv));
+    la_addi_d(counter, counter, 1);
+    la_st_d(counter, env_ir2_opnd, lsenv_offset_of_fast_jmp_miss(lsenv));
+    ra_free_temp(counter);
+#endif
     /*
      * jump to epilogue with 0 return
      * two args are pass-through:
@@ -2127,16 +3230,28 @@ indirect_jmp:
         if (!qemu_loglevel_mask(CPU_LOG_TB_NOCHAIN)) {
             CPUArchState* env = (CPUArchState*)(lsenv->cpu_state);
             CPUState *cpu = env_cpu(env);
-            uint32_t parallel = cpu->tcg_cflags & CF_PARALLEL;
+            uint32_t parallel = tr_cflags(cpu) & CF_PARALLEL;
             if (!close_latx_parallel && !parallel) {
                 IR2_OPND old_jmp_label = ra_alloc_label();
+                IndirectIC *ic = NULL;
+                int jirl_label_id;
+                if (option_indirect_ic) {
+                    ic = latx_indirect_ic_alloc(tb, ir1_addr(branch));
+                }
                 la_label(old_jmp_label);
                 tb->jmp_indirect = ir2_opnd_label_id(&old_jmp_label);
-                generate_indirect_goto((void *)tb->tc.ptr, false);
+                generate_indirect_goto((void *)tb->tc.ptr, false, ic,
+                                       &jirl_label_id);
+                tb->jmp_indirect_jirl = jirl_label_id;
                 la_data_li(target, context_switch_native_to_bt_ret_0);
                 aot_la_append_ir2_jmp_far(target, base, B_EPILOGUE_RET_0, 0);
             } else {
-                la_data_li(target, parallel_indirect_jmp_glue);
+                /* parallel TBs share the glue, AOT relocates it on load */
+                if (latx_fast_jmp_cache_enabled(tr_cflags(cpu))) {
+                    la_data_li(target, indirect_jmp_glue);
+                } else {
+                    la_data_li(target, parallel_indirect_jmp_glue);
+                }
                 IR2_OPND old_jmp_label = ra_alloc_label();
                 la_label(old_jmp_label);
                 tb->jmp_indirect = ir2_opnd_label_id(&old_jmp_label);
@@ -2289,7 +3404,7 @@ static int generate_indirect_jmp_glue(void *code_buf, bool parallel)
     int ins_num;
     tr_init(NULL);
 
-    generate_indirect_goto(code_buf, parallel);
+    generate_indirect_goto(code_buf, parallel, NULL, NULL);
 
     TRANSLATION_DATA *lat_ctx = lsenv->tr_data;
     label_dispose(NULL, lat_ctx);
@@ -2597,17 +3712,13 @@ static void eflags_eliminate_debugger(TranslationBlock *tb, int n,
     if (next_tb->eflag_use && qemu_loglevel_mask(LAT_LOG_EFLAGS)) {
         IR1_INST pir1;
         uint8_t inst_cache[64];
-        uint8_t *pins;
         char info[IR1_INST_SIZE] = {0};
         ADDRX pc = next_tb->pc;
+        ADDRX readable_page = -1;
         int ir1_nr = next_tb->icount;
         for (int i = 0; i < ir1_nr; ++i) {
-            pins = inst_cache;
-            int max_insn_len = get_insn_len_readable(pc);
-            for (int j = 0; j < max_insn_len; ++j) {
-                *pins = cpu_read_code_via_qemu(lsenv->cpu_state, pc + j);
-                pins++;
-            }
+            cpu_read_insn_via_qemu(lsenv->cpu_state, pc, inst_cache,
+                                   &readable_page);
             pc = ir1_disasm(&pir1, inst_cache, pc, 0, &info);
             qemu_log("[EFLAGS] ");
             ir1_dump(&pir1);
@@ -3440,123 +4551,6 @@ void tr_gen_call_to_helper_cvttpd2pi(ADDR func, int dest_xmm_num, int src_xmm_nu
 
 }
 
-void tr_gen_call_to_helper_pcmpxstrx(ADDR func, int dest_xmm_num, int src_xmm_num, int ctrl)
-{
-    /* prologue */
-    tr_save_registers_to_env(0xff, FPR_USEDEF_TO_SAVE, 0xff, options_to_save());
-#ifdef TARGET_X86_64
-    tr_save_x64_8_registers_to_env(0xff, 0xff);
-#endif
-
-    /* set arguments */
-    la_mov64(a0_ir2_opnd, env_ir2_opnd);
-#ifndef TARGET_X86_64
-    la_addi_d(a1_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, dest_xmm_num));
-    la_addi_d(a2_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, src_xmm_num));
-#else
-    IR2_OPND tmp_env_opnd = ra_alloc_itemp();
-    la_addi_d(tmp_env_opnd, env_ir2_opnd, 0x7f0);
-    la_addi_d(a1_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, dest_xmm_num) - 0x7f0);
-    la_addi_d(a2_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, src_xmm_num) - 0x7f0);
-    ra_free_temp(tmp_env_opnd);
-#endif
-    li_d(a3_ir2_opnd, ctrl);
-
-    /* load func_addr and jmp */
-    IR2_OPND func_addr_opnd = ra_alloc_dbt_arg2();
-    li_d(func_addr_opnd, (ADDR)func);
-    la_jirl(ra_ir2_opnd, func_addr_opnd, 0);
-
-    /* prologue, jmp and epilogue */
-    tr_load_registers_from_env(0xff, FPR_USEDEF_TO_SAVE, 0xff, options_to_save());
-#ifdef TARGET_X86_64
-    tr_load_x64_8_registers_from_env(0xff, 0xff);
-#endif
-}
-
-void tr_gen_call_to_helper_pclmulqdq(ADDR func, int  d, int s1, int s2, int ctrl,int use_fp)
-{
-    /* aot relocation requires the tb struct */
-    TranslationBlock *tb __attribute__((unused)) = NULL;
-    if (option_aot) {
-        tb = (TranslationBlock *)lsenv->tr_data->curr_tb;
-    }
-
-    /* prologue */
-    tr_gen_call_to_helper_prologue(use_fp);
-
-    /* set arguments */
-    la_mov64(a0_ir2_opnd, env_ir2_opnd);
-#ifndef TARGET_X86_64
-    la_addi_d(a1_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, d));
-    la_addi_d(a2_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, s1));
-    la_addi_d(a3_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, s2));
-#else
-    IR2_OPND tmp_env_opnd = ra_alloc_itemp();
-    la_addi_d(tmp_env_opnd, env_ir2_opnd, 0x7f0);
-    la_addi_d(a1_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, d) - 0x7f0);
-    la_addi_d(a2_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, s1) - 0x7f0);
-    la_addi_d(a3_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, s2) - 0x7f0);
-    ra_free_temp(tmp_env_opnd);
-#endif
-    li_d(a4_ir2_opnd, ctrl);
-
-    /* load func_addr and jmp */
-    IR2_OPND func_addr_opnd = ra_alloc_dbt_arg2();
-    li_d(func_addr_opnd, (ADDR)func);
-    la_jirl(ra_ir2_opnd, func_addr_opnd, 0);
-
-    tr_gen_call_to_helper_epilogue(use_fp);
-}
-
-void tr_gen_call_to_helper_aes(ADDR func, int dest_xmm_num, int src1_xmm_num, int src2_xmm_num)
-{
-    /* prologue */
-    tr_save_registers_to_env(0xff, FPR_USEDEF_TO_SAVE, 0xff, options_to_save());
-#ifdef TARGET_X86_64
-    tr_save_x64_8_registers_to_env(0xff, 0xff);
-#endif
-    /* set arguments */
-    la_mov64(a0_ir2_opnd, env_ir2_opnd);
-#ifndef TARGET_X86_64
-    la_addi_d(a1_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, dest_xmm_num));
-    la_addi_d(a2_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, src1_xmm_num));
-    la_addi_d(a3_ir2_opnd, env_ir2_opnd,
-                    lsenv_offset_of_xmm(lsenv, src2_xmm_num));
-#else
-    IR2_OPND tmp_env_opnd = ra_alloc_itemp();
-    la_addi_d(tmp_env_opnd, env_ir2_opnd, 0x7f0);
-    la_addi_d(a1_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, dest_xmm_num) - 0x7f0);
-    la_addi_d(a2_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, src1_xmm_num) - 0x7f0);
-    la_addi_d(a3_ir2_opnd, tmp_env_opnd,
-                    lsenv_offset_of_xmm(lsenv, src2_xmm_num) - 0x7f0);
-    ra_free_temp(tmp_env_opnd);
-#endif
-    /* load func_addr and jmp */
-    IR2_OPND func_addr_opnd = ra_alloc_dbt_arg2();
-    li_d(func_addr_opnd, (ADDR)func);
-    la_jirl(ra_ir2_opnd, func_addr_opnd, 0);
-    /* prologue, jmp and epilogue */
-    tr_load_registers_from_env(0xff, FPR_USEDEF_TO_SAVE, 0xff, options_to_save());
-#ifdef TARGET_X86_64
-    tr_load_x64_8_registers_from_env(0xff, 0xff);
-#endif
-}
-
 IR2_OPND tr_lat_spin_lock(IR2_OPND mem_addr, int imm)
 {
     IR2_OPND label_lat_lock = ra_alloc_label();
@@ -3564,10 +4558,26 @@ IR2_OPND tr_lat_spin_lock(IR2_OPND mem_addr, int imm)
     IR2_OPND lat_lock_addr = ra_alloc_itemp();
     IR2_OPND lat_lock_val= ra_alloc_itemp();
     IR2_OPND cpu_index = ra_alloc_itemp();
-    /*compute lat_lock offset by add (mem_addr+imm)[9:6]*/
-    la_addi_w(lat_lock_addr, mem_addr, imm);
-    la_bstrpick_d(lat_lock_val, lat_lock_addr, 9, 6);
-    la_slli_w(lat_lock_val, lat_lock_val, 6);
+    int stripe_bits = ctz32(option_lock_stripes);
+#ifdef CONFIG_LATX_PROFILER
+    IR2_OPND label_contended = ra_alloc_label();
+    IR2_OPND label_acquired = ra_alloc_label();
+#endif
+    /*
+     * compute lat_lock offset by a fibonacci hash of the cache line of
+     * (mem_addr+imm), so that hot lines do not share a stripe by their
+     * low address bits only.
+     */
+    la_addi_d(lat_lock_addr, mem_addr, imm);
+    la_srli_d(lat_lock_val, lat_lock_addr, 6);
+    if (stripe_bits) {
+        li_d(cpu_index, 0x9e3779b97f4a7c15ULL);
+        la_mul_d(lat_lock_val, lat_lock_val, cpu_index);
+        la_srli_d(lat_lock_val, lat_lock_val, 64 - stripe_bits);
+        la_slli_d(lat_lock_val, lat_lock_val, 6);
+    } else {
+        la_mov64(lat_lock_val, zero_ir2_opnd);
+    }
 
     TranslationBlock *tb __attribute__((unused)) = NULL;
     if (option_aot) {
@@ -3586,9 +4596,25 @@ IR2_OPND tr_lat_spin_lock(IR2_OPND mem_addr, int imm)
     la_bne(lat_lock_val, zero_ir2_opnd, label_locked);
     la_or(lat_lock_val, lat_lock_val, cpu_index);
     la_label(label_locked);
+#ifdef CONFIG_LATX_PROFILER
+    la_bne(lat_lock_val, cpu_index, label_contended);
+#else
     la_bne(lat_lock_val, cpu_index, label_lat_lock);
+#endif
     la_sc_w(lat_lock_val, lat_lock_addr, 0);
     la_beq(lat_lock_val, zero_ir2_opnd, label_lat_lock);
+#ifdef CONFIG_LATX_PROFILER
+    la_b(label_acquired);
+    /* held by another vCPU, count it atomically and spin again */
+    la_label(label_contended);
+    IR2_OPND contended_one = ra_alloc_itemp();
+    la_addi_d(lat_lock_val, lat_lock_addr, offsetof(struct lat_lock, contended));
+    la_addi_w(contended_one, zero_ir2_opnd, 1);
+    la_amadd_w(zero_ir2_opnd, contended_one, lat_lock_val);
+    ra_free_temp(contended_one);
+    la_b(label_lat_lock);
+    la_label(label_acquired);
+#endif
 
     ra_free_temp(cpu_index);
     ra_free_temp(lat_lock_val);
@@ -3596,9 +4622,18 @@ IR2_OPND tr_lat_spin_lock(IR2_OPND mem_addr, int imm)
 	return lat_lock_addr;
 }
 
+/*
+ * Emit the weakest dbar that gives the ordering in hint, or dbar 0 when
+ * -latx-fence is 0. Cores without hint support treat any hint as dbar 0.
+ */
+void tr_fence(int hint)
+{
+    la_dbar(option_fence == FENCE_FULL ? DBAR_FULL : hint);
+}
+
 void tr_lat_spin_unlock(IR2_OPND lat_lock_addr)
 {
-    la_dbar(0);
+    tr_fence(DBAR_RELEASE);
     la_st_w(zero_ir2_opnd, lat_lock_addr, 0);
     ra_free_temp(lat_lock_addr);
 }
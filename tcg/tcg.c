@@ -196,6 +196,20 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+
+#ifdef CONFIG_USER_ONLY
+    /* split TBs get the same share of tb_gen_buffer as their code */
+    void *tb_start;
+    size_t tb_stride;
+    /* region eviction: lookups since the last eviction and fill order */
+    uint32_t *heat;
+    uint64_t *stamp;
+    uint64_t clock;
+    /* heat inherited through direct jumps, see tcg_region_heat_link */
+    uint32_t *link_heat;
+    /* JRRA sites patched to return into the region, never evicted */
+    uint32_t *pins;
+#endif
 };
 
 static struct tcg_region_state region;
@@ -742,7 +756,19 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
     s->code_gen_ptr = start;
     s->code_gen_buffer_size = end - start;
     s->code_gen_highwater = end - TCG_HIGHWATER;
+#ifdef CONFIG_USER_ONLY
+    if (region.tb_stride) {
+        s->tb_gen_ptr = region.tb_start + curr_region * region.tb_stride;
+        s->tb_gen_highwater = s->tb_gen_ptr + region.tb_stride - 1024;
+    } else {
+        s->tb_gen_ptr = s->tb_gen_buffer;
+    }
+    region.stamp[curr_region] = ++region.clock;
+    region.heat[curr_region] = 0;
+    region.pins[curr_region] = 0;
+#else
     s->tb_gen_ptr = s->tb_gen_buffer;
+#endif
 #if defined(CONFIG_LATX_TBMINI_ENABLE)
     /* leave space for TBMini for the 1st TB */
     if (option_split_tb) {
@@ -813,9 +839,145 @@ void tcg_region_reset_all(void)
 }
 
 #ifdef CONFIG_USER_ONLY
+/*
+ * A single region unless -latx-code-regions asks for more, in which case a
+ * full code cache evicts its coldest region instead of flushing everything.
+ */
 static size_t tcg_n_regions(void)
 {
-    return 1;
+    return MAX(option_code_regions, 1);
+}
+
+size_t tcg_region_count(void)
+{
+    return region.n;
+}
+
+static size_t tcg_region_index(const void *p)
+{
+    ptrdiff_t offset = p - region.start_aligned;
+
+    if (p < region.start_aligned) {
+        return 0;
+    }
+    return MIN(offset / region.stride, region.n - 1);
+}
+
+/* Region of the rx pointer @p */
+static size_t tcg_region_of(const void *p)
+{
+    return tcg_region_index(p - tcg_splitwx_diff);
+}
+
+/* Count a lookup of the TB whose code is at rx pointer @p */
+void tcg_region_heat(const void *p)
+{
+    size_t idx = tcg_region_of(p);
+
+    qatomic_set(&region.heat[idx], qatomic_read(&region.heat[idx]) + 1);
+}
+
+/*
+ * Code reached through a direct jump from rx pointer @from to @to never
+ * goes through tb_find, so the region of @to is taken to be at least as
+ * hot as the one of @from. Call from a safe-work context.
+ */
+void tcg_region_heat_link(const void *from, const void *to)
+{
+    size_t src = tcg_region_of(from);
+    size_t dst = tcg_region_of(to);
+
+    if (src != dst) {
+        region.link_heat[dst] = MAX(region.link_heat[dst], region.heat[src]);
+    }
+}
+
+/*
+ * JRRA patches the host address of the TB at rx pointer @p into the code
+ * of its caller, so its region must not be refilled while the caller is
+ * valid. Each patched caller holds one pin, which tcg_region_unpin()
+ * drops when the caller is invalidated. Call with mmap_lock held.
+ */
+void tcg_region_pin(const void *p)
+{
+    qatomic_inc(&region.pins[tcg_region_of(p)]);
+}
+
+void tcg_region_unpin(const void *p)
+{
+    size_t idx = tcg_region_of(p);
+
+    tcg_debug_assert(region.pins[idx]);
+    qatomic_dec(&region.pins[idx]);
+}
+
+/* rx bounds of region @idx */
+void tcg_region_bounds_rx(size_t idx, const void **pstart, const void **pend)
+{
+    void *start, *end;
+
+    tcg_region_bounds(idx, &start, &end);
+    *pstart = tcg_splitwx_to_rx(start);
+    *pend = tcg_splitwx_to_rx(end);
+}
+
+/* Whether a region is left unused since the last reset */
+bool tcg_region_has_fresh(void)
+{
+    bool ret;
+
+    qemu_mutex_lock(&region.lock);
+    ret = region.current < region.n;
+    qemu_mutex_unlock(&region.lock);
+    return ret;
+}
+
+/*
+ * The region to evict once all are full: the coldest one, counting both
+ * lookups since the last eviction and heat inherited through direct jumps,
+ * the oldest on a tie. Never the one @s fills nor a pinned one.
+ * The lookup counts are halved so that old heat fades out.
+ * Returns false if every candidate is pinned.
+ */
+bool tcg_region_victim(TCGContext *s, size_t *pvictim)
+{
+    size_t cur = tcg_region_index(s->code_gen_buffer);
+    size_t victim = cur;
+    uint32_t victim_heat = 0;
+    size_t i;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < region.n; i++) {
+        uint32_t heat = MAX(region.heat[i], region.link_heat[i]);
+
+        if (i == cur || qatomic_read(&region.pins[i])) {
+            continue;
+        }
+        if (victim == cur || heat < victim_heat ||
+            (heat == victim_heat && region.stamp[i] < region.stamp[victim])) {
+            victim = i;
+            victim_heat = heat;
+        }
+    }
+    for (i = 0; i < region.n; i++) {
+        region.heat[i] >>= 1;
+        region.link_heat[i] = 0;
+    }
+    qemu_mutex_unlock(&region.lock);
+    *pvictim = victim;
+    return victim != cur;
+}
+
+/*
+ * Refill the already evicted region @idx. Call from a safe-work context.
+ * agg_size_full is left alone: the region @s leaves is full and was never
+ * counted, the one it takes over stops being full.
+ */
+void tcg_region_reuse(TCGContext *s, size_t idx)
+{
+    qemu_mutex_lock(&region.lock);
+    tcg_region_assign(s, idx);
+    qemu_mutex_unlock(&region.lock);
 }
 #else
 /*
@@ -920,6 +1082,21 @@ void tcg_region_init(void)
     /* account for that last guard page */
     region.end -= page_size;
 
+#ifdef CONFIG_USER_ONLY
+    if (option_split_tb) {
+        size_t tb_size = tcg_init_ctx.tb_gen_highwater + 1024 -
+                         tcg_init_ctx.tb_gen_buffer;
+
+        region.tb_start = tcg_init_ctx.tb_gen_buffer;
+        region.tb_stride = QEMU_ALIGN_DOWN(tb_size / n_regions,
+                                           qemu_icache_linesize);
+    }
+    region.heat = g_new0(uint32_t, n_regions);
+    region.stamp = g_new0(uint64_t, n_regions);
+    region.link_heat = g_new0(uint32_t, n_regions);
+    region.pins = g_new0(uint32_t, n_regions);
+#endif
+
     /*
      * Set guard pages in the rw buffer, as that's the one into which
      * buffer overruns could occur.  Do not set guard pages in the rx